@@ -11,6 +11,7 @@
 #include <string>
 #include <stdexcept>
 #include "sim86_shared.h"
+#include "../../Part2/Lecture1Cpp/Profiler.h"
 
 #pragma comment(lib, "sim86_shared_debug.lib")
 
@@ -177,9 +178,11 @@ static std::vector<char> ReadFile(const std::string &filePath);
 
 int main(int argc, char *argv[])
 {
+    BeginProfile();
     try
     {
         Application(argc, argv);
+        EndAndPrintProfile();
     }
     catch (const std::exception &e)
     {
@@ -190,6 +193,7 @@ int main(int argc, char *argv[])
 
 void Application(int argc, char *argv[])
 {
+    TimeFunction;
     if (argc < 2)
     {
         throw std::runtime_error("Usage: " + std::string(argv[0]) + " <filename>");
@@ -215,9 +219,12 @@ void Application(int argc, char *argv[])
     while (ip.value < fileContent.size())
     {
         instruction decodedInstruction;
-        Sim86_Decode8086Instruction(fileContent.size() - ip.value,
-                                    (unsigned char *)&fileContent[ip.value],
-                                    &decodedInstruction);
+        {
+            TimeBlock("Decode");
+            Sim86_Decode8086Instruction(fileContent.size() - ip.value,
+                                        (unsigned char *)&fileContent[ip.value],
+                                        &decodedInstruction);
+        }
         if (!decodedInstruction.Op)
         {
             throw std::runtime_error("Failed to decode instruction");
@@ -439,6 +446,7 @@ void Application(int argc, char *argv[])
         outputFile << '\n';
     }
 
+    TimeBlock("PrintFinalState");
     outputFile << "\nFinal Registers\n";
     for (int i = 0; i < registerAccess.registers.size(); i++)
     {
@@ -462,6 +470,7 @@ void Application(int argc, char *argv[])
 
 static std::vector<char> ReadFile(const std::string &filePath)
 {
+    TimeFunction;
     std::ifstream file(filePath, std::ios::binary | std::ios::ate);
     if (!file)
     {
@@ -479,3 +488,5 @@ static std::vector<char> ReadFile(const std::string &filePath)
 
     return buffer;
 }
+
+ProfilerEndOfCompilationUnit;
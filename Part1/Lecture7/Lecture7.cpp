@@ -6,6 +6,7 @@
 #include <string>
 #include <stdexcept>
 #include "sim86_shared.h"
+#include "../../Part2/Lecture1Cpp/Profiler.h"
 
 #pragma comment(lib, "sim86_shared_debug.lib")
 
@@ -90,9 +91,11 @@ static void InsertRegisterValue(std::vector<RegisterValue> *registerValues, cons
 
 int main(int argc, char *argv[])
 {
+    BeginProfile();
     try
     {
         Application(argc, argv);
+        EndAndPrintProfile();
     }
     catch (const std::exception &e)
     {
@@ -103,6 +106,7 @@ int main(int argc, char *argv[])
 
 void Application(int argc, char *argv[])
 {
+    TimeFunction;
     if (argc < 2)
     {
         throw std::runtime_error("Usage: " + std::string(argv[0]) + " <filename>");
@@ -124,9 +128,12 @@ void Application(int argc, char *argv[])
     while (offset < fileContent.size())
     {
         instruction decodedInstruction;
-        Sim86_Decode8086Instruction(fileContent.size() - offset,
-                                    (unsigned char *)&fileContent[offset],
-                                    &decodedInstruction);
+        {
+            TimeBlock("Decode");
+            Sim86_Decode8086Instruction(fileContent.size() - offset,
+                                        (unsigned char *)&fileContent[offset],
+                                        &decodedInstruction);
+        }
         if (!decodedInstruction.Op)
         {
             throw std::runtime_error("Failed to decode instruction");
@@ -192,6 +199,7 @@ void Application(int argc, char *argv[])
         offset += decodedInstruction.Size;
     }
 
+    TimeBlock("PrintFinalState");
     outputFile << "\nFinal Registers\n";
     for (const auto &registerValue : registerValues)
     {
@@ -206,6 +214,7 @@ void Application(int argc, char *argv[])
 
 static std::vector<char> ReadFile(const std::string &filePath)
 {
+    TimeFunction;
     std::ifstream file(filePath, std::ios::binary | std::ios::ate);
     if (!file)
     {
@@ -250,3 +259,5 @@ static void InsertRegisterValue(std::vector<RegisterValue> *registerValues, cons
 
     registerValues->push_back(regValue);
 }
+
+ProfilerEndOfCompilationUnit;
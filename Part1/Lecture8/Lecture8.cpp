@@ -9,6 +9,7 @@
 #include <string>
 #include <stdexcept>
 #include "sim86_shared.h"
+#include "../../Part2/Lecture1Cpp/Profiler.h"
 
 #pragma comment(lib, "sim86_shared_debug.lib")
 
@@ -118,9 +119,11 @@ static void InsertRegisterValue(std::vector<RegisterValue> *registerValues, cons
 
 int main(int argc, char *argv[])
 {
+    BeginProfile();
     try
     {
         Application(argc, argv);
+        EndAndPrintProfile();
     }
     catch (const std::exception &e)
     {
@@ -131,6 +134,7 @@ int main(int argc, char *argv[])
 
 void Application(int argc, char *argv[])
 {
+    TimeFunction;
     if (argc < 2)
     {
         throw std::runtime_error("Usage: " + std::string(argv[0]) + " <filename>");
@@ -154,9 +158,12 @@ void Application(int argc, char *argv[])
     while (ip.value < fileContent.size())
     {
         instruction decodedInstruction;
-        Sim86_Decode8086Instruction(fileContent.size() - ip.value,
-                                    (unsigned char *)&fileContent[ip.value],
-                                    &decodedInstruction);
+        {
+            TimeBlock("Decode");
+            Sim86_Decode8086Instruction(fileContent.size() - ip.value,
+                                        (unsigned char *)&fileContent[ip.value],
+                                        &decodedInstruction);
+        }
         if (!decodedInstruction.Op)
         {
             throw std::runtime_error("Failed to decode instruction");
@@ -252,6 +259,7 @@ void Application(int argc, char *argv[])
         outputFile << '\n';
     }
 
+    TimeBlock("PrintFinalState");
     outputFile << "\nFinal Registers\n";
     for (const auto &registerValue : registerValues)
     {
@@ -273,6 +281,7 @@ void Application(int argc, char *argv[])
 
 static std::vector<char> ReadFile(const std::string &filePath)
 {
+    TimeFunction;
     std::ifstream file(filePath, std::ios::binary | std::ios::ate);
     if (!file)
     {
@@ -317,3 +326,5 @@ static void InsertRegisterValue(std::vector<RegisterValue> *registerValues, cons
 
     registerValues->push_back(regValue);
 }
+
+ProfilerEndOfCompilationUnit;
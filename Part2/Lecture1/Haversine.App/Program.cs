@@ -76,7 +76,7 @@ static class Program
         if (args.Length < 2)
         {
             Console.WriteLine("Usage: haversine benchmark <operation>");
-            Console.WriteLine("  Operations: parse, generate");
+            Console.WriteLine("  Operations: parse, generate, zones");
             return 1;
         }
 
@@ -105,12 +105,110 @@ static class Program
                 return 0;
             }
 
+            case "zones":
+            {
+                BenchmarkZones();
+                return 0;
+            }
+
             default:
                 Console.WriteLine($"Unknown operation: {operation}");
                 return 1;
         }
     }
 
+    // Cycles for one empty zone, loop included, best of several runs: the previous managed zone (looked up by name in
+    // a dictionary, boxed as IDisposable, timestamps read through ordinary P/Invoke) against the native zone table
+    // opened by name and by pre-registered id.
+    private static void BenchmarkZones()
+    {
+        const int iterations = 1_000_000;
+        const int runs = 20;
+
+        var profiler = new HaversineProfiler();
+        var zoneId = profiler.RegisterZone("Benchmark");
+        var managedZones = new Dictionary<string, ManagedZone>();
+
+        IDisposable BeginManagedZone(string name)
+        {
+            if (!managedZones.TryGetValue(name, out var zone))
+            {
+                zone = new ManagedZone();
+                managedZones[name] = zone;
+            }
+            zone.Begin();
+            return zone;
+        }
+
+        double BestCyclesPerZone(Action body)
+        {
+            var best = ulong.MaxValue;
+            for (var run = 0; run < runs; run++)
+            {
+                var start = CpuTimer.CpuTimer.ReadBegin();
+                body();
+                best = Math.Min(best, CpuTimer.CpuTimer.ReadEnd() - start);
+            }
+            return best / (double)iterations;
+        }
+
+        var before = BestCyclesPerZone(() =>
+        {
+            for (var i = 0; i < iterations; i++)
+            {
+                using var zone = BeginManagedZone("Benchmark");
+            }
+        });
+        var byName = BestCyclesPerZone(() =>
+        {
+            for (var i = 0; i < iterations; i++)
+            {
+                using var zone = profiler.BeginZone("Benchmark");
+            }
+        });
+        var byId = BestCyclesPerZone(() =>
+        {
+            for (var i = 0; i < iterations; i++)
+            {
+                using var zone = profiler.BeginZone(zoneId);
+            }
+        });
+        var timerOnly = BestCyclesPerZone(() =>
+        {
+            for (var i = 0; i < iterations; i++)
+            {
+                CpuTimer.CpuTimer.ReadEnd();
+                CpuTimer.CpuTimer.ReadBegin();
+            }
+        });
+
+        Console.WriteLine($"{"Zone recording",-40} {"Cycles/zone",12}");
+        Console.WriteLine($"{"Managed zone (before)",-40} {before,12:F1}");
+        Console.WriteLine($"{"Native zone table, by name",-40} {byName,12:F1}");
+        Console.WriteLine($"{"Native zone table, by id",-40} {byId,12:F1}");
+        Console.WriteLine($"{"Fenced timestamp pair alone",-40} {timerOnly,12:F1}");
+    }
+
+    // The profiler's zone before it moved into librdtsc.
+    private struct ManagedZone : IDisposable
+    {
+        public ulong ElapsedTicks;
+        public long HitCount;
+
+        private ulong _startTicks;
+
+        public void Begin()
+        {
+            _startTicks = CpuTimer.CpuTimer.ReadBegin();
+        }
+
+        public void Dispose()
+        {
+            ElapsedTicks += CpuTimer.CpuTimer.ReadEnd() - _startTicks;
+            HitCount++;
+        }
+    }
+
     private static void PrintUsage()
     {
         Console.WriteLine("Haversine calculator - generates or parses coordinate data");
@@ -123,7 +221,7 @@ static class Program
         Console.WriteLine("Commands:");
         Console.WriteLine("  generate  - Generate coordinate pairs");
         Console.WriteLine("  parse     - Parse and calculate distances from generated file");
-        Console.WriteLine("  benchmark - Run performance benchmarks (parse: IEnumerable vs List)");
+        Console.WriteLine("  benchmark - Run performance benchmarks (parse: IEnumerable vs List, zones: profiler overhead)");
         Console.WriteLine();
         Console.WriteLine("Examples:");
         Console.WriteLine("  dotnet run -- generate --pairs 1000000 --seed 1337");
@@ -13,8 +13,129 @@ public static class CpuTimer
         return _ReadTimestampCounter();
     }
 
-    // Estimates the CPU timer frequency (ticks/second) by spinning for ~100ms.
-    // Call once at startup and cache the result — do not call in a hot path.
+    // Fenced reads for timing a region: ReadBegin before it, ReadEnd after it. Neither can be reordered into or out of
+    // the region, and ReadEnd - ReadBegin includes the timer cost that EstimateOverhead/EstimateManagedOverhead report.
+    [DllImport("rdtsc", CallingConvention = CallingConvention.Cdecl, EntryPoint = "ReadTimestampCounterBegin")]
+    public static extern ulong ReadBegin();
+
+    [DllImport("rdtsc", CallingConvention = CallingConvention.Cdecl, EntryPoint = "ReadTimestampCounterEnd")]
+    public static extern ulong ReadEnd();
+
+    // Minimum ticks of an empty ReadBegin/ReadEnd pair called from native code.
+    [DllImport("rdtsc", CallingConvention = CallingConvention.Cdecl, EntryPoint = "EstimateCpuTimerOverhead")]
+    public static extern ulong EstimateOverhead();
+
+    private static ulong _managedOverhead;
+
+    // The same minimum measured through P/Invoke, which is what a managed caller actually pays for a pair. Measured
+    // once per process.
+    public static ulong EstimateManagedOverhead()
+    {
+        if (_managedOverhead == 0)
+        {
+            var overhead = ulong.MaxValue;
+            for (var i = 0; i < 10_000; i++)
+            {
+                var start = ReadBegin();
+                var elapsed = ReadEnd() - start;
+                overhead = Math.Min(overhead, elapsed);
+            }
+            _managedOverhead = overhead;
+        }
+        return _managedOverhead;
+    }
+
+    // Returns the CPU timer frequency (ticks/second). Tries CPUID leaf 0x15, the kernel's tsc_khz, an on-disk cache and
+    // the nominal CPUID leaf 0x16 before falling back to a short calibration spin; the native side remembers the
+    // result, so later calls are free.
     [DllImport("rdtsc", CallingConvention = CallingConvention.Cdecl, EntryPoint = "EstimateCpuTimerFreq")]
     public static extern ulong EstimateFrequency();
+
+    [DllImport("rdtsc", CallingConvention = CallingConvention.Cdecl, EntryPoint = "GetCpuTimerFreqSource")]
+    private static extern int _GetCpuTimerFreqSource();
+
+    [DllImport("rdtsc", CallingConvention = CallingConvention.Cdecl, EntryPoint = "CpuTimerFreqSourceName")]
+    private static extern IntPtr _CpuTimerFreqSourceName(int source);
+
+    // Where EstimateFrequency got its answer, calibrating first if needed.
+    public static FrequencySource GetFrequencySource()
+    {
+        return (FrequencySource)_GetCpuTimerFreqSource();
+    }
+
+    public static string FrequencySourceName(FrequencySource source)
+    {
+        return Marshal.PtrToStringAnsi(_CpuTimerFreqSourceName((int)source)) ?? "none";
+    }
+}
+
+// Mirrors the CpuTimerFreqSource_* values in rdtsc.h.
+public enum FrequencySource
+{
+    None = 0,
+    Cpuid15 = 1,
+    Cpuid16 = 2,
+    Kernel = 3,
+    Cache = 4,
+    Spin = 5,
+}
+
+// The native zone table in librdtsc. Begin and End are marked SuppressGCTransition: they only read the timestamp and
+// update a few counters, never block or call back, so the runtime can skip the managed/native state switch that
+// dominates an ordinary P/Invoke. The table is global and single-threaded, like the native side.
+public static class NativeZones
+{
+    public const int Count = 4096;
+
+    [DllImport("rdtsc", CallingConvention = CallingConvention.Cdecl, EntryPoint = "CpuTimerZoneBegin")]
+    [SuppressGCTransition]
+    public static extern void Begin(uint id);
+
+    [DllImport("rdtsc", CallingConvention = CallingConvention.Cdecl, EntryPoint = "CpuTimerZoneEnd")]
+    [SuppressGCTransition]
+    public static extern void End(uint id);
+
+    [DllImport("rdtsc", CallingConvention = CallingConvention.Cdecl, EntryPoint = "CpuTimerZoneRead")]
+    private static extern uint _Read([Out] ZoneTotals[] result, uint count);
+
+    [DllImport("rdtsc", CallingConvention = CallingConvention.Cdecl, EntryPoint = "CpuTimerZoneReset")]
+    public static extern void Reset();
+
+    // Totals for zones 0 .. count - 1 in one call; index 0 is the root.
+    public static ZoneTotals[] Read(int count)
+    {
+        var result = new ZoneTotals[Math.Min(count, Count)];
+        _Read(result, (uint)result.Length);
+        return result;
+    }
+
+    public const int HistogramCount = 256;
+
+    [DllImport("rdtsc", CallingConvention = CallingConvention.Cdecl, EntryPoint = "CpuTimerZoneEnableHistogram")]
+    private static extern int _EnableHistogram(uint id);
+
+    [DllImport("rdtsc", CallingConvention = CallingConvention.Cdecl, EntryPoint = "CpuTimerZonePercentile")]
+    private static extern ulong _Percentile(uint id, double percentile);
+
+    // Records each later hit of the zone in a fixed-size log-linear histogram on the native side (within about 3%).
+    // False when all HistogramCount histograms are taken. Reset releases them.
+    public static bool EnableHistogram(int id)
+    {
+        return _EnableHistogram((uint)id) != 0;
+    }
+
+    // Ticks per hit at the given percentile (0-100); 100 is the exact maximum. 0 without a histogram or hits.
+    public static ulong Percentile(int id, double percentile)
+    {
+        return _Percentile((uint)id, percentile);
+    }
+}
+
+// Mirrors CpuTimerZone in rdtsc.h.
+[StructLayout(LayoutKind.Sequential)]
+public struct ZoneTotals
+{
+    public ulong ExclusiveTicks;
+    public ulong InclusiveTicks;
+    public ulong HitCount;
 }
@@ -1,9 +1,20 @@
 // rdtsc.c — CPU timer utilities compiled into a shared library (librdtsc.so).
-// Exposes ReadTimestampCounter and EstimateCpuTimerFreq for use via P/Invoke from C#.
+// Exposes ReadTimestampCounter, its fenced begin/end variants (optionally with the CPU number), the timer-read
+// overhead, EstimateCpuTimerFreq, the calibration source and a native zone table with optional latency histograms for
+// use via P/Invoke from C#.
 
+#include <cpuid.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdint.h>
-#include <x86intrin.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
+#include <x86intrin.h>
+#include "rdtsc.h"
 
 typedef uint64_t u64;
 
@@ -14,6 +25,11 @@ typedef uint64_t u64;
 // For Linux, we use clock_gettime with CLOCK_MONOTONIC_RAW, which has nanosecond resolution.
 static const u64 unixOsClockFreq = 1000000000; // nanosecond resolution
 
+static u64 cpuTimerFreq;
+static int cpuTimerFreqSource = CpuTimerFreqSource_None;
+static u64 cpuTimerOverhead;
+static int hasRdtscp = -1;
+
 static u64 ReadOsTimer(void)
 {
     struct timespec ts;
@@ -31,27 +47,641 @@ EXPORT u64 ReadTimestampCounter(void)
     return __rdtsc();
 }
 
-// Estimates the CPU timer frequency (RDTSC ticks/second) by spinning against the OS clock for ~100ms.
-EXPORT u64 EstimateCpuTimerFreq(void)
+// CPUID 0x80000001 EDX bit 27. Every x86-64 CPU since Nehalem/K8 has it, but some hypervisors hide it.
+static int HasRdtscp(void)
+{
+    if (hasRdtscp < 0)
+    {
+        unsigned int eax, ebx, ecx, edx;
+        hasRdtscp = __get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx) && (edx & (1u << 27));
+    }
+    return hasRdtscp;
+}
+
+// Timestamp for the start of a measured region. The first lfence waits for everything before it to finish; the
+// second keeps the measured code from starting before the timestamp is taken.
+EXPORT u64 ReadTimestampCounterBegin(void)
+{
+    _mm_lfence();
+    u64 ticks = __rdtsc();
+    _mm_lfence();
+    return ticks;
+}
+
+// Timestamp for the end of a measured region. rdtscp waits for every earlier instruction to execute before reading
+// the counter; the lfence keeps later code from starting before it. Without rdtscp, an lfence on either side does the
+// same.
+EXPORT u64 ReadTimestampCounterEnd(void)
+{
+    u64 ticks;
+    if (HasRdtscp())
+    {
+        unsigned int aux;
+        ticks = __rdtscp(&aux);
+    }
+    else
+    {
+        _mm_lfence();
+        ticks = __rdtsc();
+    }
+    _mm_lfence();
+    return ticks;
+}
+
+// Begin and End that also return the processor they ran on: RDTSCP loads IA32_TSC_AUX, which Linux sets to the CPU
+// number. RDTSCP already waits for earlier instructions, so one trailing lfence gives the same ordering as the reads
+// above. Without RDTSCP the processor is cpuTimerUnknownCpu.
+EXPORT u64 ReadTimestampCounterBeginCpu(uint32_t *cpu)
+{
+    if (!HasRdtscp())
+    {
+        *cpu = cpuTimerUnknownCpu;
+        return ReadTimestampCounterBegin();
+    }
+    unsigned int aux;
+    u64 ticks = __rdtscp(&aux);
+    _mm_lfence();
+    *cpu = aux & 0xFFF;
+    return ticks;
+}
+
+EXPORT u64 ReadTimestampCounterEndCpu(uint32_t *cpu)
+{
+    if (!HasRdtscp())
+    {
+        *cpu = cpuTimerUnknownCpu;
+        return ReadTimestampCounterEnd();
+    }
+    unsigned int aux;
+    u64 ticks = __rdtscp(&aux);
+    _mm_lfence();
+    *cpu = aux & 0xFFF;
+    return ticks;
+}
+
+// Whether timestamps taken on different cores can be subtracted. That takes an invariant TSC (CPUID 0x80000007 EDX
+// bit 8: constant rate, keeps counting in deep sleep) whose counters are also in step with each other. Linux checks the
+// second at boot and keeps the TSC as its clocksource only if they are, so when the clocksource can be read it decides.
+EXPORT int IsCpuTimerInvariant(void)
+{
+    static int invariant = -1;
+    if (invariant < 0)
+    {
+        unsigned int eax, ebx, ecx, edx;
+        int result = __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1u << 8));
+
+        char clocksource[32] = {0};
+        FILE *file = fopen("/sys/devices/system/clocksource/clocksource0/current_clocksource", "r");
+        if (file)
+        {
+            if (fgets(clocksource, sizeof(clocksource), file))
+            {
+                result = result && strncmp(clocksource, "tsc", 3) == 0;
+            }
+            fclose(file);
+        }
+        invariant = result;
+    }
+    return invariant;
+}
+
+// Smallest number of ticks an empty begin/end pair measures. The calls go through volatile pointers so they cost what
+// they cost an outside caller, rather than being inlined here. The minimum, not the average: subtracting it can never
+// take a zone below zero on its own, and interrupts only ever add time.
+EXPORT u64 EstimateCpuTimerOverhead(void)
+{
+    if (cpuTimerOverhead)
+    {
+        return cpuTimerOverhead;
+    }
+
+    u64 (*volatile begin)(void) = ReadTimestampCounterBegin;
+    u64 (*volatile end)(void) = ReadTimestampCounterEnd;
+    u64 overhead = ~0ull;
+    for (int i = 0; i < 10000; i++)
+    {
+        u64 start = begin();
+        u64 elapsed = end() - start;
+        overhead = elapsed < overhead ? elapsed : overhead;
+    }
+
+    cpuTimerOverhead = overhead;
+    return overhead;
+}
+
+// Leaf 0x15 gives the TSC as an exact ratio of the core crystal clock, when the CPU enumerates the crystal frequency.
+static u64 FreqFromCpuid15(void)
+{
+    if (__get_cpuid_max(0, 0) < 0x15)
+    {
+        return 0;
+    }
+
+    unsigned int denominator, numerator, crystalHz, unused;
+    __cpuid_count(0x15, 0, denominator, numerator, crystalHz, unused);
+    if (!denominator || !numerator || !crystalHz)
+    {
+        return 0;
+    }
+    return (u64)crystalHz * numerator / denominator;
+}
+
+// Leaf 0x16 gives the nominal base frequency in MHz. The TSC runs close to it, but not exactly at it: Skylake clients,
+// for one, derive the TSC from a 24 MHz crystal and land a fraction of a percent off. Only a fallback for that reason.
+static u64 FreqFromCpuid16(void)
+{
+    if (__get_cpuid_max(0, 0) < 0x16)
+    {
+        return 0;
+    }
+
+    unsigned int baseMhz, unused1, unused2, unused3;
+    __cpuid_count(0x16, 0, baseMhz, unused1, unused2, unused3);
+    return (u64)(baseMhz & 0xFFFF) * 1000000;
+}
+
+// The kernel's own tsc_khz: from sysfs where the kernel exposes it, otherwise from its boot log in /dev/kmsg. The
+// refined calibration replaces the early estimate when both are logged.
+static u64 FreqFromKernel(void)
+{
+    FILE *file = fopen("/sys/devices/system/cpu/cpu0/tsc_freq_khz", "r");
+    if (file)
+    {
+        unsigned long long khz = 0;
+        int matched = fscanf(file, "%llu", &khz);
+        fclose(file);
+        if (matched == 1 && khz)
+        {
+            return (u64)khz * 1000;
+        }
+    }
+
+    int fd = open("/dev/kmsg", O_RDONLY | O_NONBLOCK);
+    if (fd < 0)
+    {
+        return 0;
+    }
+
+    double detectedMhz = 0.0;
+    double refinedMhz = 0.0;
+    char record[8192];
+    for (;;)
+    {
+        // One record per read; EAGAIN once the buffer is drained, EPIPE when a record was overwritten meanwhile
+        ssize_t size = read(fd, record, sizeof(record) - 1);
+        if (size < 0 && errno == EPIPE)
+        {
+            continue;
+        }
+        if (size <= 0)
+        {
+            break;
+        }
+        record[size] = '\0';
+
+        const char *message = strchr(record, ';');
+        if (!message)
+        {
+            continue;
+        }
+        message++;
+
+        double mhz;
+        if (sscanf(message, "tsc: Refined TSC clocksource calibration: %lf MHz", &mhz) == 1)
+        {
+            refinedMhz = mhz;
+        }
+        else if (sscanf(message, "tsc: Detected %lf MHz processor", &mhz) == 1)
+        {
+            detectedMhz = mhz;
+        }
+    }
+    close(fd);
+
+    double mhz = refinedMhz ? refinedMhz : detectedMhz;
+    return (u64)(mhz * 1000.0 + 0.5) * 1000;
+}
+
+// CPU brand string, family/model/stepping and boot id. A reboot or a different CPU invalidates the cached frequency.
+static void CacheKey(char *key, size_t size)
+{
+    unsigned int brand[12] = {0};
+    if (__get_cpuid_max(0x80000000, 0) >= 0x80000004)
+    {
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            __cpuid(0x80000002 + i, brand[4 * i], brand[4 * i + 1], brand[4 * i + 2], brand[4 * i + 3]);
+        }
+    }
+    char brandString[sizeof(brand) + 1];
+    memcpy(brandString, brand, sizeof(brand));
+    brandString[sizeof(brand)] = '\0';
+
+    unsigned int signature, unused1, unused2, unused3;
+    __cpuid(1, signature, unused1, unused2, unused3);
+
+    char bootId[64] = "";
+    FILE *file = fopen("/proc/sys/kernel/random/boot_id", "r");
+    if (file)
+    {
+        if (!fgets(bootId, sizeof(bootId), file))
+        {
+            bootId[0] = '\0';
+        }
+        fclose(file);
+        bootId[strcspn(bootId, "\n")] = '\0';
+    }
+
+    snprintf(key, size, "%s|%08x|%s", brandString, signature, bootId);
+}
+
+// $XDG_CACHE_HOME/librdtsc/tsc_freq, or ~/.cache/librdtsc/tsc_freq. Returns 0 when neither is set.
+static int CachePath(char *path, size_t size, int createDirectory)
+{
+    const char *cacheHome = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    char directory[4096];
+    if (cacheHome && *cacheHome)
+    {
+        snprintf(directory, sizeof(directory), "%s", cacheHome);
+    }
+    else if (home && *home)
+    {
+        snprintf(directory, sizeof(directory), "%s/.cache", home);
+    }
+    else
+    {
+        return 0;
+    }
+
+    // Failures show up when the cache file is opened
+    if (createDirectory)
+    {
+        mkdir(directory, 0755);
+    }
+    strncat(directory, "/librdtsc", sizeof(directory) - strlen(directory) - 1);
+    if (createDirectory)
+    {
+        mkdir(directory, 0755);
+    }
+    snprintf(path, size, "%s/tsc_freq", directory);
+    return 1;
+}
+
+static u64 FreqFromCache(void)
+{
+    char path[4200];
+    if (!CachePath(path, sizeof(path), 0))
+    {
+        return 0;
+    }
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        return 0;
+    }
+
+    char expectedKey[256];
+    char key[256] = "";
+    unsigned long long freq = 0;
+    CacheKey(expectedKey, sizeof(expectedKey));
+    int valid = fgets(key, sizeof(key), file) && fscanf(file, "%llu", &freq) == 1;
+    fclose(file);
+
+    key[strcspn(key, "\n")] = '\0';
+    return valid && strcmp(key, expectedKey) == 0 ? (u64)freq : 0;
+}
+
+// Written to a temporary file and renamed, so a concurrent reader never sees half a cache entry.
+static void WriteCache(u64 freq)
+{
+    char path[4200];
+    char temporaryPath[4300];
+    if (!CachePath(path, sizeof(path), 1))
+    {
+        return;
+    }
+    snprintf(temporaryPath, sizeof(temporaryPath), "%s.%d", path, (int)getpid());
+
+    FILE *file = fopen(temporaryPath, "w");
+    if (!file)
+    {
+        return;
+    }
+    char key[256];
+    CacheKey(key, sizeof(key));
+    int written = fprintf(file, "%s\n%llu\n", key, (unsigned long long)freq) > 0;
+    written = fclose(file) == 0 && written;
+
+    if (!written || rename(temporaryPath, path) != 0)
+    {
+        unlink(temporaryPath);
+    }
+}
+
+// Spins against the OS clock over doubling windows from 1 ms, stopping once two successive estimates agree to 10 ppm
+// (usually well under 20 ms) or after 100 ms.
+static u64 FreqFromSpin(void)
 {
-    u64 cpuStart = ReadTimestampCounter();
-    u64 osStart = ReadOsTimer();
     u64 osFreq = ReadOsTimerFreq();
-    u64 osWaitTicks = osFreq * 100 / 1000; // 100ms
-    u64 osElapsed = 0;
-    u64 osEnd = 0;
+    u64 osWaitTicks = osFreq / 1000;          // 1ms
+    u64 osMaxWaitTicks = osFreq * 100 / 1000; // 100ms
+    u64 previous = 0;
+
+    u64 cpuStart = ReadTimestampCounterBegin();
+    u64 osStart = ReadOsTimer();
+    for (;;)
+    {
+        u64 osElapsed = 0;
+        while (osElapsed < osWaitTicks)
+        {
+            osElapsed = ReadOsTimer() - osStart;
+        }
+        u64 cpuElapsed = ReadTimestampCounterEnd() - cpuStart;
+        u64 estimate = osFreq * cpuElapsed / osElapsed;
+
+        if (previous)
+        {
+            u64 difference = estimate > previous ? estimate - previous : previous - estimate;
+            if (difference * 100000 <= estimate)
+            {
+                return estimate;
+            }
+        }
+        if (osWaitTicks >= osMaxWaitTicks)
+        {
+            return estimate;
+        }
+
+        previous = estimate;
+        osWaitTicks = osWaitTicks * 2 < osMaxWaitTicks ? osWaitTicks * 2 : osMaxWaitTicks;
+    }
+}
+
+// Returns the CPU timer frequency (RDTSC ticks/second) from the first source that has it: CPUID leaf 0x15 with an
+// enumerated crystal, the kernel's tsc_khz (measured against other clocks at boot), the on-disk cache, the nominal
+// CPUID leaf 0x16, and finally a short spin whose result is cached for later processes. The result is remembered, so
+// only the first call in a process does any work.
+EXPORT u64 EstimateCpuTimerFreq(void)
+{
+    if (cpuTimerFreq)
+    {
+        return cpuTimerFreq;
+    }
+
+    u64 freq;
+    int source;
+    if ((freq = FreqFromCpuid15()))
+    {
+        source = CpuTimerFreqSource_Cpuid15;
+    }
+    else if ((freq = FreqFromKernel()))
+    {
+        source = CpuTimerFreqSource_Kernel;
+    }
+    else if ((freq = FreqFromCache()))
+    {
+        source = CpuTimerFreqSource_Cache;
+    }
+    else if ((freq = FreqFromCpuid16()))
+    {
+        source = CpuTimerFreqSource_Cpuid16;
+    }
+    else
+    {
+        freq = FreqFromSpin();
+        source = CpuTimerFreqSource_Spin;
+        if (freq)
+        {
+            WriteCache(freq);
+        }
+    }
+
+    cpuTimerFreqSource = source;
+    cpuTimerFreq = freq;
+    return freq;
+}
+
+// Which source EstimateCpuTimerFreq used, calibrating first if it has not run yet.
+EXPORT int GetCpuTimerFreqSource(void)
+{
+    EstimateCpuTimerFreq();
+    return cpuTimerFreqSource;
+}
+
+EXPORT const char *CpuTimerFreqSourceName(int source)
+{
+    switch (source)
+    {
+        case CpuTimerFreqSource_Cpuid15:
+            return "cpuid 0x15";
+        case CpuTimerFreqSource_Cpuid16:
+            return "cpuid 0x16";
+        case CpuTimerFreqSource_Kernel:
+            return "kernel tsc_khz";
+        case CpuTimerFreqSource_Cache:
+            return "disk cache";
+        case CpuTimerFreqSource_Spin:
+            return "spin";
+    }
+    return "none";
+}
+
+// Native zone table. A managed profiler that read the timestamp itself would pay two P/Invoke transitions per zone;
+// here each zone is one call in and one call out, and the accounting happens on this side. Zone 0 is the root that
+// time outside every zone is charged to. Exclusive and inclusive times follow the same rules as the C++ Profiler.h:
+// a zone recursing into itself is counted once by its outermost entry, and its parent is charged the raw elapsed time
+// while the zone itself gets that time minus EstimateCpuTimerOverhead().
+// Single-threaded: begin and end zones on one thread only.
+typedef struct
+{
+    u64 startTicks;
+    u64 oldInclusiveTicks;
+    uint32_t parentId;
+} ZoneFrame;
+
+static CpuTimerZone zones[cpuTimerZoneCount];
+static ZoneFrame zoneStack[cpuTimerZoneStackDepth];
+static uint32_t zoneDepth;
+static uint32_t zoneParent;
+
+// Log-linear (HDR-style) histogram of per-hit ticks. Values below 32 get a bucket each; above that every power of two
+// is split into 32 linear buckets, so a bucket is never wider than 1/32 of its values (about 3%). Values from 2^48
+// ticks up, more than a day, share the last bucket. The size is fixed, and recording a hit is a bit scan and an
+// increment: no allocation and no locks, which the single-threaded table does not need anyway.
+enum
+{
+    histogramSubBucketBits = 5,
+    histogramSubBuckets = 1 << histogramSubBucketBits,
+    histogramMaxBit = 47,
+    histogramBucketCount = (histogramMaxBit - histogramSubBucketBits + 2) * histogramSubBuckets,
+};
+
+typedef struct
+{
+    u64 counts[histogramBucketCount];
+    u64 total;
+    u64 max;
+} ZoneHistogram;
+
+// Slot + 1 of each zone's histogram, 0 for none. Only the slots handed out are ever touched, so the unused part of the
+// pool costs no memory.
+static ZoneHistogram zoneHistograms[cpuTimerHistogramCount];
+static uint16_t zoneHistogramSlots[cpuTimerZoneCount];
+static uint32_t zoneHistogramsUsed;
+
+static uint32_t HistogramBucket(u64 ticks)
+{
+    if (ticks < histogramSubBuckets)
+    {
+        return (uint32_t)ticks;
+    }
+    if (ticks >> (histogramMaxBit + 1))
+    {
+        return histogramBucketCount - 1;
+    }
+    uint32_t topBit = 63 - (uint32_t)__builtin_clzll(ticks);
+    uint32_t shift = topBit - histogramSubBucketBits;
+    return (topBit - histogramSubBucketBits + 1) * histogramSubBuckets +
+           (uint32_t)((ticks >> shift) & (histogramSubBuckets - 1));
+}
+
+// The largest value that falls into a bucket
+static u64 HistogramBucketLimit(uint32_t bucket)
+{
+    if (bucket < histogramSubBuckets)
+    {
+        return bucket;
+    }
+    uint32_t shift = bucket / histogramSubBuckets - 1;
+    u64 lower = (u64)(histogramSubBuckets + bucket % histogramSubBuckets) << shift;
+    return lower + ((u64)1 << shift) - 1;
+}
+
+EXPORT void CpuTimerZoneBegin(uint32_t id)
+{
+    // Past either limit the zone is not recorded; only the depth is tracked, so the matching end stays balanced
+    if (id >= cpuTimerZoneCount || zoneDepth >= cpuTimerZoneStackDepth)
+    {
+        zoneDepth++;
+        return;
+    }
+
+    ZoneFrame *frame = zoneStack + zoneDepth++;
+    frame->oldInclusiveTicks = zones[id].inclusiveTicks;
+    frame->parentId = zoneParent;
+    zoneParent = id;
+    frame->startTicks = ReadTimestampCounterBegin();
+}
+
+EXPORT void CpuTimerZoneEnd(uint32_t id)
+{
+    u64 endTicks = ReadTimestampCounterEnd();
+    if (zoneDepth == 0)
+    {
+        return;
+    }
+    if (id >= cpuTimerZoneCount || zoneDepth > cpuTimerZoneStackDepth)
+    {
+        zoneDepth--;
+        return;
+    }
+
+    ZoneFrame *frame = zoneStack + --zoneDepth;
+    u64 rawElapsed = endTicks - frame->startTicks;
+    u64 overhead = rawElapsed < cpuTimerOverhead ? rawElapsed : cpuTimerOverhead;
+    u64 elapsed = rawElapsed - overhead;
 
-    while (osElapsed < osWaitTicks)
+    zones[frame->parentId].exclusiveTicks -= rawElapsed;
+    zones[id].exclusiveTicks += elapsed;
+    zones[id].inclusiveTicks = frame->oldInclusiveTicks + elapsed;
+    zones[id].hitCount++;
+    zoneParent = frame->parentId;
+
+    uint32_t slot = zoneHistogramSlots[id];
+    if (slot)
     {
-        osEnd = ReadOsTimer();
-        osElapsed = osEnd - osStart;
+        ZoneHistogram *histogram = zoneHistograms + slot - 1;
+        histogram->counts[HistogramBucket(elapsed)]++;
+        histogram->total++;
+        histogram->max = elapsed > histogram->max ? elapsed : histogram->max;
     }
+}
+
+// Copies the first count zones (at most cpuTimerZoneCount) and returns how many were copied.
+EXPORT uint32_t CpuTimerZoneRead(CpuTimerZone *result, uint32_t count)
+{
+    if (count > cpuTimerZoneCount)
+    {
+        count = cpuTimerZoneCount;
+    }
+    memcpy(result, zones, count * sizeof(CpuTimerZone));
+    return count;
+}
 
-    u64 cpuElapsed = ReadTimestampCounter() - cpuStart;
+// Clears the table and measures the timer overhead if that has not happened yet, so the first zone is not charged
+// for it. Call once before the first zone. Histograms are released and have to be enabled again.
+EXPORT void CpuTimerZoneReset(void)
+{
+    EstimateCpuTimerOverhead();
+    memset(zones, 0, sizeof(zones));
+    zoneDepth = 0;
+    zoneParent = 0;
+
+    memset(zoneHistograms, 0, zoneHistogramsUsed * sizeof(ZoneHistogram));
+    memset(zoneHistogramSlots, 0, sizeof(zoneHistogramSlots));
+    zoneHistogramsUsed = 0;
+}
 
-    if (osElapsed == 0)
+// Records every later hit of the zone into a histogram of its own. Returns 1 if the zone has one (also when it already
+// had), 0 if the id is out of range or all cpuTimerHistogramCount histograms are taken.
+EXPORT int CpuTimerZoneEnableHistogram(uint32_t id)
+{
+    if (id >= cpuTimerZoneCount)
     {
         return 0;
     }
-    return osFreq * cpuElapsed / osElapsed;
+    if (!zoneHistogramSlots[id])
+    {
+        if (zoneHistogramsUsed >= cpuTimerHistogramCount)
+        {
+            return 0;
+        }
+        zoneHistogramSlots[id] = (uint16_t)++zoneHistogramsUsed;
+    }
+    return 1;
+}
+
+// Ticks within which the given percentage (0-100) of the zone's hits completed, overhead already subtracted: the upper
+// edge of the bucket the percentile falls in, and exact for 100. 0 for a zone without a histogram or hits.
+EXPORT u64 CpuTimerZonePercentile(uint32_t id, double percentile)
+{
+    if (id >= cpuTimerZoneCount || !zoneHistogramSlots[id])
+    {
+        return 0;
+    }
+    const ZoneHistogram *histogram = zoneHistograms + zoneHistogramSlots[id] - 1;
+    if (histogram->total == 0)
+    {
+        return 0;
+    }
+    if (percentile >= 100.0)
+    {
+        return histogram->max;
+    }
+
+    double rank = percentile * (double)histogram->total / 100.0;
+    u64 target = (u64)rank < rank ? (u64)rank + 1 : (u64)rank;
+    target = target ? target : 1;
+    u64 seen = 0;
+    for (uint32_t bucket = 0; bucket < histogramBucketCount; bucket++)
+    {
+        seen += histogram->counts[bucket];
+        if (seen >= target)
+        {
+            u64 limit = HistogramBucketLimit(bucket);
+            return limit < histogram->max ? limit : histogram->max;
+        }
+    }
+    return histogram->max;
 }
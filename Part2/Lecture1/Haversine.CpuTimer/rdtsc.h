@@ -0,0 +1,73 @@
+// rdtsc.h — declarations for the CPU timer utilities in rdtsc.c, for C and C++ callers that link against librdtsc
+// (or compile rdtsc.c in directly) instead of going through P/Invoke.
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Where EstimateCpuTimerFreq got its answer. The values are part of the C ABI used from C#.
+enum
+{
+    CpuTimerFreqSource_None = 0,
+    CpuTimerFreqSource_Cpuid15 = 1,
+    CpuTimerFreqSource_Cpuid16 = 2,
+    CpuTimerFreqSource_Kernel = 3,
+    CpuTimerFreqSource_Cache = 4,
+    CpuTimerFreqSource_Spin = 5,
+};
+
+uint64_t ReadTimestampCounter(void);
+
+// Serialized reads for timing a region: Begin before it, End after it. End - Begin includes EstimateCpuTimerOverhead()
+// ticks of timer cost on top of the region itself.
+uint64_t ReadTimestampCounterBegin(void);
+uint64_t ReadTimestampCounterEnd(void);
+uint64_t EstimateCpuTimerOverhead(void);
+
+// The same reads, also reporting the processor (Linux CPU number) they ran on, and whether reads from different
+// processors can be compared at all.
+static const uint32_t cpuTimerUnknownCpu = 0xFFFFFFFF;
+
+uint64_t ReadTimestampCounterBeginCpu(uint32_t *cpu);
+uint64_t ReadTimestampCounterEndCpu(uint32_t *cpu);
+int IsCpuTimerInvariant(void);
+
+uint64_t EstimateCpuTimerFreq(void);
+int GetCpuTimerFreqSource(void);
+const char *CpuTimerFreqSourceName(int source);
+
+// Native zone table, see rdtsc.c. The layout of CpuTimerZone is part of the C ABI used from C#.
+enum
+{
+    cpuTimerZoneCount = 4096,
+    cpuTimerZoneStackDepth = 1024,
+};
+
+typedef struct
+{
+    uint64_t exclusiveTicks;
+    uint64_t inclusiveTicks;
+    uint64_t hitCount;
+} CpuTimerZone;
+
+void CpuTimerZoneBegin(uint32_t id);
+void CpuTimerZoneEnd(uint32_t id);
+uint32_t CpuTimerZoneRead(CpuTimerZone *result, uint32_t count);
+void CpuTimerZoneReset(void);
+
+// Optional per-hit latency histograms for up to cpuTimerHistogramCount zones, see rdtsc.c.
+enum
+{
+    cpuTimerHistogramCount = 256,
+};
+
+int CpuTimerZoneEnableHistogram(uint32_t id);
+uint64_t CpuTimerZonePercentile(uint32_t id, double percentile);
+
+#ifdef __cplusplus
+}
+#endif
@@ -9,11 +9,31 @@ public class JsonParser
     private JsonToken _currentToken;
     private readonly IProfiler _profiler;
 
+    // Opened once per token or value, so the names are looked up once here
+    private readonly int _parseValueZone;
+    private readonly int _parseObjectZone;
+    private readonly int _parseArrayZone;
+    private readonly int _parseStringZone;
+    private readonly int _parseNumberZone;
+    private readonly int _parseTrueZone;
+    private readonly int _parseFalseZone;
+    private readonly int _parseNullZone;
+    private readonly int _advanceZone;
+
     public JsonParser(IProfiler profiler, StreamReader reader)
     {
+        _profiler = profiler;
+        _parseValueZone = profiler.RegisterZone("ParseValue");
+        _parseObjectZone = profiler.RegisterZone("ParseObject");
+        _parseArrayZone = profiler.RegisterZone("ParseArray");
+        _parseStringZone = profiler.RegisterZone("ParseString", recordHistogram: true);
+        _parseNumberZone = profiler.RegisterZone("ParseNumber", recordHistogram: true);
+        _parseTrueZone = profiler.RegisterZone("ParseTrue");
+        _parseFalseZone = profiler.RegisterZone("ParseFalse");
+        _parseNullZone = profiler.RegisterZone("ParseNull");
+        _advanceZone = profiler.RegisterZone("Advance");
         _tokenizer = new JsonTokenizer(reader, profiler);
         _currentToken = _tokenizer.NextToken();
-        _profiler = profiler;
     }
 
     public JsonValue Parse()
@@ -30,7 +50,7 @@ public class JsonParser
 
     private JsonValue ParseValue()
     {
-        using var parseObjectZone = _profiler.BeginZone("ParseValue");
+        using var parseObjectZone = _profiler.BeginZone(_parseValueZone);
         return _currentToken.Type switch
         {
             JsonTokenType.LeftBrace => ParseObject(),
@@ -46,7 +66,7 @@ public class JsonParser
 
     private JsonValue ParseObject()
     {
-        using var zone = _profiler.BeginZone("ParseObject");
+        using var zone = _profiler.BeginZone(_parseObjectZone);
         Expect(JsonTokenType.LeftBrace);
         var dict = new Dictionary<string, JsonValue>();
 
@@ -85,7 +105,7 @@ public class JsonParser
 
     private JsonValue ParseArray()
     {
-        using var zone = _profiler.BeginZone("ParseArray");
+        using var zone = _profiler.BeginZone(_parseArrayZone);
         Expect(JsonTokenType.LeftBracket);
         var list = new List<JsonValue>();
 
@@ -114,7 +134,7 @@ public class JsonParser
 
     private JsonValue ParseString()
     {
-        using var zone = _profiler.BeginZone("ParseString");
+        using var zone = _profiler.BeginZone(_parseStringZone);
         var value = JsonValue.String(_currentToken.StringValue!);
         Advance();
         return value;
@@ -122,7 +142,7 @@ public class JsonParser
 
     private JsonValue ParseNumber()
     {
-        using var zone = _profiler.BeginZone("ParseNumber");
+        using var zone = _profiler.BeginZone(_parseNumberZone);
         var value = JsonValue.Number(_currentToken.NumberValue);
         Advance();
         return value;
@@ -130,21 +150,21 @@ public class JsonParser
 
     private JsonValue ParseTrue()
     {
-        using var zone = _profiler.BeginZone("ParseTrue");
+        using var zone = _profiler.BeginZone(_parseTrueZone);
         Advance();
         return JsonValue.Boolean(true);
     }
 
     private JsonValue ParseFalse()
     {
-        using var zone = _profiler.BeginZone("ParseFalse");
+        using var zone = _profiler.BeginZone(_parseFalseZone);
         Advance();
         return JsonValue.Boolean(false);
     }
 
     private JsonValue ParseNull()
     {
-        using var zone = _profiler.BeginZone("ParseNull");
+        using var zone = _profiler.BeginZone(_parseNullZone);
         Advance();
         return JsonValue.Null();
     }
@@ -160,7 +180,7 @@ public class JsonParser
 
     private void Advance()
     {
-        using var zone = _profiler.BeginZone("Advance");
+        using var zone = _profiler.BeginZone(_advanceZone);
         _currentToken = _tokenizer.NextToken();
     }
 }
@@ -30,12 +30,15 @@ public class JsonTokenizer(StreamReader reader, IProfiler profiler)
 {
     private readonly StreamReader _reader = reader;
     private readonly IProfiler _profiler = profiler;
+    private readonly int _nextTokenZone = profiler.RegisterZone("Tokenizer.NextToken", recordHistogram: true);
+    private readonly int _readStringZone = profiler.RegisterZone("Tokenizer.ReadString", recordHistogram: true);
+    private readonly int _readNumberZone = profiler.RegisterZone("Tokenizer.ReadNumber", recordHistogram: true);
     private const int MaxStringLength = 4096;
     private const int MaxNumberLength = 64;
 
     public JsonToken NextToken()
     {
-        using var zone = _profiler.BeginZone("Tokenizer.NextToken");
+        using var zone = _profiler.BeginZone(_nextTokenZone);
         SkipWhiteSpace();
 
         var peek = _reader.Peek();
@@ -83,7 +86,7 @@ public class JsonTokenizer(StreamReader reader, IProfiler profiler)
 
     private JsonToken ReadString()
     {
-        using var zone = _profiler.BeginZone("Tokenizer.ReadString");
+        using var zone = _profiler.BeginZone(_readStringZone);
         _reader.Read(); // consume opening "
         Span<char> buffer = stackalloc char[MaxStringLength];
         var length = 0;
@@ -140,7 +143,7 @@ public class JsonTokenizer(StreamReader reader, IProfiler profiler)
 
     private JsonToken ReadNumber()
     {
-        using var zone = _profiler.BeginZone("Tokenizer.ReadNumber");
+        using var zone = _profiler.BeginZone(_readNumberZone);
         Span<char> buffer = stackalloc char[MaxNumberLength];
         var length = 0;
 
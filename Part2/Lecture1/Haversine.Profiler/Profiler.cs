@@ -1,37 +1,80 @@
 using System.Diagnostics;
+using Haversine.CpuTimer;
 
 namespace Haversine.Profiler;
 
 public interface IProfiler
 {
-    IDisposable BeginZone(string name);
+    // Looks a zone name up once, so hot code can open it by id without hashing the name on every hit. With
+    // recordHistogram every hit's time is also kept, so PrintResults can show percentiles as well as the average.
+    int RegisterZone(string name, bool recordHistogram = false);
+    ZoneScope BeginZone(int zoneId);
+    ZoneScope BeginZone(string name);
     void PrintResults(long totalBytes);
 }
 
+// Zones are recorded in the native table in librdtsc: opening and closing one is a call into native code each, with no
+// allocation and no managed bookkeeping. There is one native table per process, so only one Profiler should exist
+// (it is registered as a singleton) and zones must stay on one thread.
 public class Profiler : IProfiler
 {
-    private readonly Dictionary<string, ProfileZone> _zones = [];
+    private readonly Dictionary<string, int> _zoneIds = [];
+    private readonly List<string> _zoneNames = ["<root>"];
+    private readonly List<int> _histogramZones = [];
     private readonly Stopwatch _globalTimer = Stopwatch.StartNew();
     private readonly ulong _timerFrequency = CpuTimer.CpuTimer.EstimateFrequency();
+    private readonly ulong _startTicks;
 
-    public IDisposable BeginZone(string name)
+    public Profiler()
     {
-        if (!_zones.TryGetValue(name, out var zone))
+        NativeZones.Reset();
+        _startTicks = CpuTimer.CpuTimer.ReadBegin();
+    }
+
+    public int RegisterZone(string name, bool recordHistogram = false)
+    {
+        if (!_zoneIds.TryGetValue(name, out var zoneId))
+        {
+            if (_zoneNames.Count >= NativeZones.Count)
+            {
+                throw new InvalidOperationException($"More than {NativeZones.Count - 1} profiler zones");
+            }
+            zoneId = _zoneNames.Count;
+            _zoneNames.Add(name);
+            _zoneIds[name] = zoneId;
+        }
+
+        if (recordHistogram && !_histogramZones.Contains(zoneId))
         {
-            zone = new ProfileZone(name);
-            _zones[name] = zone;
+            if (!NativeZones.EnableHistogram(zoneId))
+            {
+                throw new InvalidOperationException($"More than {NativeZones.HistogramCount} zones with histograms");
+            }
+            _histogramZones.Add(zoneId);
         }
-        zone.Begin();
-        return zone;
+        return zoneId;
+    }
+
+    public ZoneScope BeginZone(int zoneId)
+    {
+        return new ZoneScope(zoneId);
+    }
+
+    public ZoneScope BeginZone(string name)
+    {
+        return new ZoneScope(RegisterZone(name));
     }
 
     public void PrintResults(long totalBytes)
     {
+        var totalTicks = CpuTimer.CpuTimer.ReadEnd() - _startTicks;
         var totalElapsed = _globalTimer.Elapsed.TotalSeconds;
 
         Console.WriteLine("\n=== PERFORMANCE ANALYSIS ===\n");
         Console.WriteLine($"Total Time: {totalElapsed * 1000:F3} ms");
-        Console.WriteLine($"CPU Frequency: ~{_timerFrequency / 1_000_000:F0} MHz");
+        var frequencySource = CpuTimer.CpuTimer.FrequencySourceName(CpuTimer.CpuTimer.GetFrequencySource());
+        Console.WriteLine($"CPU Frequency: ~{_timerFrequency / 1_000_000:F0} MHz (from {frequencySource})");
+        Console.WriteLine($"Timer overhead: {CpuTimer.CpuTimer.EstimateOverhead()} cycles per zone (subtracted)");
         if (totalBytes > 0)
         {
             var megabytes = totalBytes / (1024.0 * 1024.0);
@@ -40,42 +83,70 @@ public class Profiler : IProfiler
         }
         Console.WriteLine();
 
-        var sortedZones = _zones.Values.OrderByDescending(z => z.ElapsedTicks).ToList();
-        var totalTicks = sortedZones.Sum(z => (long)z.ElapsedTicks);
+        var totals = NativeZones.Read(_zoneNames.Count);
+        var sortedZones = Enumerable.Range(1, totals.Length - 1)
+            .Where(id => totals[id].HitCount > 0)
+            .OrderByDescending(id => totals[id].ExclusiveTicks)
+            .ToList();
 
-        Console.WriteLine($"{"Zone",-30} {"Time (ms)",12} {"Percent",8} {"Hit Count",12} {"Avg (us)",12}");
-        Console.WriteLine(new string('-', 85));
+        Console.WriteLine(
+            $"{"Zone",-30} {"Excl (ms)",12} {"Percent",8} {"Incl (ms)",12} {"Percent",8} {"Hit Count",12} {"Avg (us)",12}");
+        Console.WriteLine(new string('-', 100));
 
-        foreach (var zone in sortedZones)
+        foreach (var id in sortedZones)
         {
-            var ms = zone.ElapsedTicks / (double)_timerFrequency * 1000.0;
-            var percent = totalTicks > 0 ? (zone.ElapsedTicks / (double)totalTicks * 100.0) : 0;
-            var avgUs = zone.HitCount > 0 ? (ms * 1000.0 / zone.HitCount) : 0;
+            var zone = totals[id];
+            var exclusiveMs = zone.ExclusiveTicks / (double)_timerFrequency * 1000.0;
+            var inclusiveMs = zone.InclusiveTicks / (double)_timerFrequency * 1000.0;
+            var exclusivePercent = totalTicks > 0 ? zone.ExclusiveTicks / (double)totalTicks * 100.0 : 0;
+            var inclusivePercent = totalTicks > 0 ? zone.InclusiveTicks / (double)totalTicks * 100.0 : 0;
+            var avgUs = inclusiveMs * 1000.0 / zone.HitCount;
 
-            Console.WriteLine($"{zone.Name,-30} {ms,12:F3} {percent,7:F2}% {zone.HitCount,12:N0} {avgUs,12:F3}");
+            Console.WriteLine(
+                $"{_zoneNames[id],-30} {exclusiveMs,12:F3} {exclusivePercent,7:F2}% {inclusiveMs,12:F3} {inclusivePercent,7:F2}% {zone.HitCount,12:N0} {avgUs,12:F3}");
+        }
+
+        Console.WriteLine();
+        PrintPercentiles(totals);
+    }
+
+    // Inclusive cycles per hit for the zones registered with a histogram
+    private void PrintPercentiles(ZoneTotals[] totals)
+    {
+        var zones = _histogramZones.Where(id => totals[id].HitCount > 0).ToList();
+        if (zones.Count == 0)
+        {
+            return;
+        }
+
+        Console.WriteLine("=== LATENCY PER HIT (cycles) ===\n");
+        Console.WriteLine(
+            $"{"Zone",-30} {"Hit Count",12} {"p50",10} {"p90",10} {"p99",10} {"p99.9",10} {"Max",12}");
+        Console.WriteLine(new string('-', 100));
+
+        foreach (var id in zones)
+        {
+            Console.WriteLine(
+                $"{_zoneNames[id],-30} {totals[id].HitCount,12:N0} {NativeZones.Percentile(id, 50),10:N0} {NativeZones.Percentile(id, 90),10:N0} {NativeZones.Percentile(id, 99),10:N0} {NativeZones.Percentile(id, 99.9),10:N0} {NativeZones.Percentile(id, 100),12:N0}");
         }
 
         Console.WriteLine();
     }
 }
 
-public struct ProfileZone(string name) : IDisposable
+// Returned by value and disposed by `using`, which calls Dispose on the struct directly, so nothing is boxed.
+public readonly struct ZoneScope : IDisposable
 {
-    public readonly string Name = name;
-    public ulong ElapsedTicks;
-    public long HitCount;
-
-    private ulong _startTicks;
+    private readonly uint _zoneId;
 
-    public void Begin()
+    public ZoneScope(int zoneId)
     {
-        _startTicks = CpuTimer.CpuTimer.ReadTimestampCounter();
+        _zoneId = (uint)zoneId;
+        NativeZones.Begin(_zoneId);
     }
 
     public void Dispose()
     {
-        var endTicks = CpuTimer.CpuTimer.ReadTimestampCounter();
-        ElapsedTicks += endTicks - _startTicks;
-        HitCount++;
+        NativeZones.End(_zoneId);
     }
 }
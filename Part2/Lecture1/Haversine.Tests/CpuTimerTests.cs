@@ -7,4 +7,69 @@ public sealed class CpuTimerTests
     {
         Console.WriteLine($"Estimated CPU timer frequency: {CpuTimer.CpuTimer.EstimateFrequency()} Hz");
     }
+
+    [Fact]
+    public void FrequencySourceIsReportedAfterCalibration()
+    {
+        var frequency = CpuTimer.CpuTimer.EstimateFrequency();
+        var source = CpuTimer.CpuTimer.GetFrequencySource();
+
+        Assert.True(frequency > 0);
+        Assert.NotEqual(CpuTimer.FrequencySource.None, source);
+        Console.WriteLine($"Frequency source: {CpuTimer.CpuTimer.FrequencySourceName(source)}");
+    }
+
+    [Fact]
+    public void FencedReadsAreOrderedAndOverheadIsMeasured()
+    {
+        var begin = CpuTimer.CpuTimer.ReadBegin();
+        var end = CpuTimer.CpuTimer.ReadEnd();
+
+        Assert.True(end >= begin);
+        Assert.True(CpuTimer.CpuTimer.EstimateOverhead() > 0);
+        Assert.True(CpuTimer.CpuTimer.EstimateManagedOverhead() >= CpuTimer.CpuTimer.EstimateOverhead());
+    }
+
+    [Fact]
+    public void NativeZonesAccumulateNestedAndRecursiveHits()
+    {
+        CpuTimer.NativeZones.Reset();
+        CpuTimer.NativeZones.Begin(1);
+        CpuTimer.NativeZones.Begin(2);
+        CpuTimer.NativeZones.Begin(2);
+        CpuTimer.NativeZones.End(2);
+        CpuTimer.NativeZones.End(2);
+        CpuTimer.NativeZones.End(1);
+
+        var zones = CpuTimer.NativeZones.Read(3);
+
+        Assert.Equal(1ul, zones[1].HitCount);
+        Assert.Equal(2ul, zones[2].HitCount);
+        Assert.True(zones[1].InclusiveTicks >= zones[2].InclusiveTicks);
+    }
+
+    [Fact]
+    public void NativeZoneHistogramReportsPercentiles()
+    {
+        CpuTimer.NativeZones.Reset();
+        Assert.True(CpuTimer.NativeZones.EnableHistogram(1));
+        for (var i = 0; i < 1000; i++)
+        {
+            CpuTimer.NativeZones.Begin(1);
+            if (i == 500)
+            {
+                Thread.Sleep(1);
+            }
+            CpuTimer.NativeZones.End(1);
+        }
+
+        var p50 = CpuTimer.NativeZones.Percentile(1, 50);
+        var p99 = CpuTimer.NativeZones.Percentile(1, 99);
+        var max = CpuTimer.NativeZones.Percentile(1, 100);
+
+        Assert.True(p50 <= p99);
+        Assert.True(p99 < max);
+        Assert.True(max >= CpuTimer.CpuTimer.EstimateFrequency() / 1000);
+        Assert.Equal(0ul, CpuTimer.NativeZones.Percentile(2, 50));
+    }
 }
@@ -0,0 +1,721 @@
+#pragma once
+
+// Heap allocation tracker, compiled in with -DALLOCATION_TRACKING=1.
+//
+// Replaces the global operator new/delete, so every allocation made with new, including those inside the standard
+// library (std::make_shared, std::string, vector growth), is counted on its way to the C runtime's allocator. With
+// glibc, malloc, calloc, realloc, free and the aligned variants are interposed as well. With MSVC (the Part1
+// simulators) only operator new/delete are replaced, since the CRT's malloc cannot be interposed from the program: C
+// code calling malloc directly is not counted, everything allocated through new is.
+//
+// Each thread counts its own allocations, requested bytes and live bytes, which Profiler.h reads on zone entry and
+// exit to give every zone its inclusive allocation count, bytes and peak live bytes (the most the live total rose above
+// its value on entry). Live bytes are the allocator's usable size, so a block is counted the same when it is freed; a
+// block freed on another thread than the one that allocated it moves live bytes between the threads, which only shows
+// up in the per-zone peaks.
+//
+// Compile with -DALLOCATION_SITES=1 as well to record the return address of every allocation and report the call sites
+// that allocate most. Sites in the executable are resolved with addr2line, so a build with -g names file and line too;
+// on Windows they are resolved through dbghelp from the program's PDB.
+//
+// A summary of the whole run (totals, a histogram of allocation sizes and, with sites, the top call sites) is printed
+// when the program exits. The hooks define malloc and operator new, so include this header in exactly one translation
+// unit; Profiler.h includes it when ALLOCATION_TRACKING is set. valloc and pvalloc are not tracked. Needs glibc or the
+// MSVC runtime.
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <malloc.h>
+#include <new>
+#include <string>
+#if defined(_WIN32)
+#    include <intrin.h>
+#    include <windows.h>
+#    include <dbghelp.h>
+#    pragma comment(lib, "dbghelp.lib")
+#else
+#    include <cxxabi.h>
+#    include <dlfcn.h>
+#    include <unistd.h>
+#endif
+
+#ifndef ALLOCATION_SITES
+#    define ALLOCATION_SITES 0
+#endif
+
+#if !defined(_WIN32) && !defined(__GLIBC__)
+#    error "AllocationTracker.h interposes glibc's allocator, or replaces operator new with the MSVC runtime"
+#endif
+
+#if defined(_MSC_VER)
+#    define AllocationNoInline __declspec(noinline)
+#    define AllocationCallSite _ReturnAddress()
+#else
+#    define AllocationNoInline __attribute__((noinline))
+#    define AllocationCallSite __builtin_return_address(0)
+#endif
+
+#if !defined(_WIN32)
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *pointer, size_t size);
+    void *__libc_memalign(size_t alignment, size_t size);
+    void __libc_free(void *pointer);
+}
+#endif
+
+static const uint32_t allocationSiteCount = 4096; // a power of two
+static const uint32_t allocationSitesReported = 25;
+static const int allocationSizeClassCount = 65; // bit widths 0 to 64
+
+struct AllocationThreadCounts
+{
+    uint64_t allocations = 0;
+    uint64_t allocatedBytes = 0;
+    int64_t liveBytes = 0;
+    int64_t peakLiveBytes = 0; // since the innermost open profiler zone began, or since the thread started
+};
+
+struct AllocationSite
+{
+    uintptr_t address;
+    uint64_t count;
+    uint64_t bytes;
+};
+
+struct AllocationTracker
+{
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> frees;
+    std::atomic<uint64_t> allocatedBytes;
+    std::atomic<int64_t> liveBytes;
+    std::atomic<int64_t> peakLiveBytes;
+    std::atomic<uint64_t> sizeClasses[allocationSizeClassCount]; // by bit width of the requested size
+#if ALLOCATION_SITES
+    std::atomic_flag sitesLock;
+    AllocationSite sites[allocationSiteCount];
+    uint64_t droppedSites; // allocations whose site did not fit in the table
+#endif
+};
+
+static AllocationTracker globalAllocations;
+static thread_local AllocationThreadCounts allocationThreadCounts;
+
+// The allocator underneath the hooks. alignment is 0 for plain new and malloc; blocks from the MSVC runtime have to be
+// freed and measured the way they were allocated, so it is passed back for those too.
+static inline void *RawAllocate(size_t size, size_t alignment)
+{
+#if defined(_WIN32)
+    return alignment ? _aligned_malloc(size, alignment) : malloc(size);
+#else
+    return alignment ? __libc_memalign(alignment, size) : __libc_malloc(size);
+#endif
+}
+
+static inline void RawFree(void *pointer, size_t alignment)
+{
+#if defined(_WIN32)
+    alignment ? _aligned_free(pointer) : free(pointer);
+#else
+    (void)alignment;
+    __libc_free(pointer);
+#endif
+}
+
+static inline size_t UsableSize(void *pointer, size_t alignment)
+{
+#if defined(_WIN32)
+    return alignment ? _aligned_msize(pointer, alignment, 0) : _msize(pointer);
+#else
+    (void)alignment;
+    return malloc_usable_size(pointer);
+#endif
+}
+
+// Zeroed memory the tracker does not see, for the profiler's own tables
+static inline void *AllocateUntracked(size_t size)
+{
+#if defined(_WIN32)
+    return calloc(1, size);
+#else
+    return __libc_calloc(1, size);
+#endif
+}
+
+static inline void FreeUntracked(void *pointer)
+{
+#if defined(_WIN32)
+    free(pointer);
+#else
+    __libc_free(pointer);
+#endif
+}
+
+// Bit width of size: 0 for 0, 64 for sizes of 2^63 and up
+static inline int AllocationSizeClass(size_t size)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    return _BitScanReverse64(&index, size) ? (int)index + 1 : 0;
+#else
+    return size ? 64 - __builtin_clzll(size) : 0;
+#endif
+}
+
+#if ALLOCATION_SITES
+static void RecordAllocationSite(uintptr_t address, size_t size)
+{
+    while (globalAllocations.sitesLock.test_and_set(std::memory_order_acquire))
+    {
+    }
+
+    uint32_t slot = (uint32_t)(((uint64_t)address * 0x9E3779B97F4A7C15ull) >> 52) & (allocationSiteCount - 1);
+    for (uint32_t probe = 0; probe < allocationSiteCount; probe++)
+    {
+        AllocationSite *site = globalAllocations.sites + ((slot + probe) & (allocationSiteCount - 1));
+        if (site->address == address || !site->address)
+        {
+            site->address = address;
+            site->count++;
+            site->bytes += size;
+            globalAllocations.sitesLock.clear(std::memory_order_release);
+            return;
+        }
+    }
+    globalAllocations.droppedSites++;
+    globalAllocations.sitesLock.clear(std::memory_order_release);
+}
+#endif
+
+static void TrackAllocation(void *pointer, size_t size, size_t alignment, void *site)
+{
+    if (!pointer)
+    {
+        return;
+    }
+
+    int64_t usable = (int64_t)UsableSize(pointer, alignment);
+    AllocationThreadCounts &counts = allocationThreadCounts;
+    counts.allocations++;
+    counts.allocatedBytes += size;
+    counts.liveBytes += usable;
+    counts.peakLiveBytes = counts.liveBytes > counts.peakLiveBytes ? counts.liveBytes : counts.peakLiveBytes;
+
+    globalAllocations.allocations.fetch_add(1, std::memory_order_relaxed);
+    globalAllocations.allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    globalAllocations.sizeClasses[AllocationSizeClass(size)].fetch_add(1, std::memory_order_relaxed);
+    int64_t live = globalAllocations.liveBytes.fetch_add(usable, std::memory_order_relaxed) + usable;
+    int64_t peak = globalAllocations.peakLiveBytes.load(std::memory_order_relaxed);
+    while (live > peak && !globalAllocations.peakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+    {
+    }
+
+#if ALLOCATION_SITES
+    RecordAllocationSite((uintptr_t)site, size);
+#else
+    (void)site;
+#endif
+}
+
+static void TrackFree(void *pointer, size_t alignment)
+{
+    if (!pointer)
+    {
+        return;
+    }
+    int64_t usable = (int64_t)UsableSize(pointer, alignment);
+    allocationThreadCounts.liveBytes -= usable;
+    globalAllocations.frees.fetch_add(1, std::memory_order_relaxed);
+    globalAllocations.liveBytes.fetch_sub(usable, std::memory_order_relaxed);
+}
+
+// operator new's contract: retry through the new handler until it gives up, then throw unless nothrow
+static void *TrackedNew(size_t size, size_t alignment, bool nothrow, void *site)
+{
+    size = size ? size : 1;
+    for (;;)
+    {
+        void *pointer = RawAllocate(size, alignment);
+        if (pointer)
+        {
+            TrackAllocation(pointer, size, alignment, site);
+            return pointer;
+        }
+
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+        {
+            if (nothrow)
+            {
+                return nullptr;
+            }
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+static void TrackedDelete(void *pointer, size_t alignment)
+{
+    TrackFree(pointer, alignment);
+    RawFree(pointer, alignment);
+}
+
+#if !defined(_WIN32)
+extern "C"
+{
+    AllocationNoInline void *malloc(size_t size) noexcept
+    {
+        void *pointer = __libc_malloc(size);
+        TrackAllocation(pointer, size, 0, AllocationCallSite);
+        return pointer;
+    }
+
+    AllocationNoInline void *calloc(size_t count, size_t size) noexcept
+    {
+        void *pointer = __libc_calloc(count, size);
+        TrackAllocation(pointer, count * size, 0, AllocationCallSite);
+        return pointer;
+    }
+
+    // Counted as a free of the old block and an allocation of the new one, even when glibc grows it in place
+    AllocationNoInline void *realloc(void *pointer, size_t size) noexcept
+    {
+        if (pointer && !size)
+        {
+            TrackedDelete(pointer, 0);
+            return nullptr;
+        }
+        size_t oldUsable = pointer ? malloc_usable_size(pointer) : 0;
+        void *resized = __libc_realloc(pointer, size);
+        if (resized && pointer)
+        {
+            allocationThreadCounts.liveBytes -= (int64_t)oldUsable;
+            globalAllocations.frees.fetch_add(1, std::memory_order_relaxed);
+            globalAllocations.liveBytes.fetch_sub((int64_t)oldUsable, std::memory_order_relaxed);
+        }
+        TrackAllocation(resized, size, 0, AllocationCallSite);
+        return resized;
+    }
+
+    AllocationNoInline void free(void *pointer) noexcept
+    {
+        TrackedDelete(pointer, 0);
+    }
+
+    AllocationNoInline void *memalign(size_t alignment, size_t size) noexcept
+    {
+        void *pointer = __libc_memalign(alignment, size);
+        TrackAllocation(pointer, size, 0, AllocationCallSite);
+        return pointer;
+    }
+
+    AllocationNoInline void *aligned_alloc(size_t alignment, size_t size) noexcept
+    {
+        void *pointer = __libc_memalign(alignment, size);
+        TrackAllocation(pointer, size, 0, AllocationCallSite);
+        return pointer;
+    }
+
+    AllocationNoInline int posix_memalign(void **result, size_t alignment, size_t size) noexcept
+    {
+        if (alignment % sizeof(void *) || (alignment & (alignment - 1)))
+        {
+            return EINVAL;
+        }
+        void *pointer = __libc_memalign(alignment, size);
+        if (!pointer)
+        {
+            return ENOMEM;
+        }
+        TrackAllocation(pointer, size, 0, AllocationCallSite);
+        *result = pointer;
+        return 0;
+    }
+}
+#endif
+
+AllocationNoInline void *operator new(size_t size)
+{
+    return TrackedNew(size, 0, false, AllocationCallSite);
+}
+
+AllocationNoInline void *operator new[](size_t size)
+{
+    return TrackedNew(size, 0, false, AllocationCallSite);
+}
+
+AllocationNoInline void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return TrackedNew(size, 0, true, AllocationCallSite);
+}
+
+AllocationNoInline void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return TrackedNew(size, 0, true, AllocationCallSite);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    TrackedDelete(pointer, 0);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    TrackedDelete(pointer, 0);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    TrackedDelete(pointer, 0);
+}
+
+void operator delete[](void *pointer, size_t) noexcept
+{
+    TrackedDelete(pointer, 0);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept
+{
+    TrackedDelete(pointer, 0);
+}
+
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept
+{
+    TrackedDelete(pointer, 0);
+}
+
+// Over-aligned new is C++17 (MSVC needs /std:c++17)
+#if __cpp_aligned_new
+AllocationNoInline void *operator new(size_t size, std::align_val_t alignment)
+{
+    return TrackedNew(size, (size_t)alignment, false, AllocationCallSite);
+}
+
+AllocationNoInline void *operator new[](size_t size, std::align_val_t alignment)
+{
+    return TrackedNew(size, (size_t)alignment, false, AllocationCallSite);
+}
+
+AllocationNoInline void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return TrackedNew(size, (size_t)alignment, true, AllocationCallSite);
+}
+
+AllocationNoInline void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return TrackedNew(size, (size_t)alignment, true, AllocationCallSite);
+}
+
+void operator delete(void *pointer, std::align_val_t alignment) noexcept
+{
+    TrackedDelete(pointer, (size_t)alignment);
+}
+
+void operator delete[](void *pointer, std::align_val_t alignment) noexcept
+{
+    TrackedDelete(pointer, (size_t)alignment);
+}
+
+void operator delete(void *pointer, size_t, std::align_val_t alignment) noexcept
+{
+    TrackedDelete(pointer, (size_t)alignment);
+}
+
+void operator delete[](void *pointer, size_t, std::align_val_t alignment) noexcept
+{
+    TrackedDelete(pointer, (size_t)alignment);
+}
+
+void operator delete(void *pointer, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    TrackedDelete(pointer, (size_t)alignment);
+}
+
+void operator delete[](void *pointer, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    TrackedDelete(pointer, (size_t)alignment);
+}
+#endif
+
+static std::string FormatAllocationBytes(double bytes)
+{
+    char text[32];
+    if (bytes >= 1024.0 * 1024.0 * 1024.0)
+    {
+        snprintf(text, sizeof(text), "%.2f GB", bytes / (1024.0 * 1024.0 * 1024.0));
+    }
+    else if (bytes >= 1024.0 * 1024.0)
+    {
+        snprintf(text, sizeof(text), "%.2f MB", bytes / (1024.0 * 1024.0));
+    }
+    else if (bytes >= 1024.0)
+    {
+        snprintf(text, sizeof(text), "%.2f KB", bytes / 1024.0);
+    }
+    else
+    {
+        snprintf(text, sizeof(text), "%.0f B", bytes);
+    }
+    return text;
+}
+
+#if ALLOCATION_SITES && defined(_WIN32)
+// "function at file:line" from the PDB, "module+offset" for code without symbols, the raw address when neither
+// resolves
+static void ResolveAllocationSites(const AllocationSite *sites, uint32_t count, std::string *names)
+{
+    HANDLE process = GetCurrentProcess();
+    SymSetOptions(SymGetOptions() | SYMOPT_UNDNAME | SYMOPT_LOAD_LINES | SYMOPT_DEFERRED_LOADS);
+    bool symbols = SymInitialize(process, nullptr, TRUE) != FALSE;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        // The return address is past the call; one byte back is inside it
+        DWORD64 address = (DWORD64)(sites[i].address - 1);
+        char text[512];
+
+        char symbolStorage[sizeof(SYMBOL_INFO) + 256] = {};
+        SYMBOL_INFO *symbol = (SYMBOL_INFO *)symbolStorage;
+        symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+        symbol->MaxNameLen = 256;
+        DWORD64 displacement = 0;
+        IMAGEHLP_LINE64 line = {};
+        line.SizeOfStruct = sizeof(line);
+        DWORD lineDisplacement = 0;
+        HMODULE module = nullptr;
+        if (symbols && SymFromAddr(process, address, &displacement, symbol))
+        {
+            if (SymGetLineFromAddr64(process, address, &lineDisplacement, &line))
+            {
+                snprintf(text, sizeof(text), "%s at %s:%lu", symbol->Name, line.FileName, line.LineNumber);
+            }
+            else
+            {
+                snprintf(text, sizeof(text), "%s+0x%llx", symbol->Name, (unsigned long long)displacement);
+            }
+        }
+        else if (GetModuleHandleExA(
+                     GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                     (LPCSTR)address,
+                     &module))
+        {
+            char path[MAX_PATH];
+            DWORD length = GetModuleFileNameA(module, path, sizeof(path));
+            path[length < sizeof(path) ? length : 0] = '\0';
+            const char *file = strrchr(path, '\\');
+            snprintf(text,
+                     sizeof(text),
+                     "%s+0x%llx",
+                     file ? file + 1 : path,
+                     (unsigned long long)(address - (DWORD64)module));
+        }
+        else
+        {
+            snprintf(text, sizeof(text), "0x%llx", (unsigned long long)address);
+        }
+        names[i] = text;
+    }
+
+    if (symbols)
+    {
+        SymCleanup(process);
+    }
+}
+#elif ALLOCATION_SITES
+// "function at file:line" for sites in the executable (one addr2line run for all of them), "library+offset (symbol)"
+// for sites in shared libraries, the raw offset when neither resolves. With debug info a site is usually inside an
+// inlined std::allocator, so the innermost inlined frame outside the system headers is shown.
+static void ResolveAllocationSites(const AllocationSite *sites, uint32_t count, std::string *names)
+{
+    char executable[4096];
+    ssize_t length = readlink("/proc/self/exe", executable, sizeof(executable) - 1);
+    executable[length > 0 ? length : 0] = '\0';
+
+    // dli_fname of the executable is however it was started; its load address identifies it
+    Dl_info self;
+    void *executableBase = dladdr((void *)&ResolveAllocationSites, &self) ? self.dli_fbase : nullptr;
+
+    std::string command = std::string("addr2line -f -i -C -p -e '") + executable + "'";
+    uint32_t inExecutable[allocationSitesReported];
+    uint32_t executableCount = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        // The return address is past the call; one byte back is inside it
+        uintptr_t address = sites[i].address - 1;
+        Dl_info info;
+        if (!dladdr((void *)address, &info) || !info.dli_fname)
+        {
+            char text[32];
+            snprintf(text, sizeof(text), "0x%zx", (size_t)address);
+            names[i] = text;
+            continue;
+        }
+
+        char text[512];
+        uintptr_t offset = address - (uintptr_t)info.dli_fbase;
+        if (info.dli_fbase != executableBase || length <= 0)
+        {
+            int status = -1;
+            char *demangled = info.dli_sname ? abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status) : nullptr;
+            const char *library = strrchr(info.dli_fname, '/');
+            snprintf(text,
+                     sizeof(text),
+                     "%s+0x%zx (%s)",
+                     library ? library + 1 : info.dli_fname,
+                     (size_t)offset,
+                     status == 0 ? demangled : info.dli_sname ? info.dli_sname : "?");
+            free(demangled);
+            names[i] = text;
+            continue;
+        }
+        snprintf(text, sizeof(text), " 0x%zx", (size_t)offset);
+        command += text;
+        names[i] = text + 1;
+        inExecutable[executableCount++] = i;
+    }
+
+    if (executableCount)
+    {
+        // One line per address, followed by a " (inlined by) " line per frame it was inlined into
+        static const char inlinedBy[] = " (inlined by) ";
+        FILE *pipe = popen((command + " 2>/dev/null").c_str(), "r");
+        char line[1024];
+        int32_t current = -1;
+        bool chosen = false;
+        while (pipe && fgets(line, sizeof(line), pipe))
+        {
+            line[strcspn(line, "\r\n")] = '\0';
+            bool inlined = strncmp(line, inlinedBy, sizeof(inlinedBy) - 1) == 0;
+            const char *frame = inlined ? line + sizeof(inlinedBy) - 1 : line;
+            if (!inlined)
+            {
+                if (++current >= (int32_t)executableCount)
+                {
+                    break;
+                }
+                chosen = false;
+            }
+            if (chosen || current < 0 || strncmp(frame, "??", 2) == 0)
+            {
+                continue;
+            }
+            names[inExecutable[current]] = frame;
+            chosen = !strstr(frame, " at /usr/");
+        }
+        if (pipe)
+        {
+            pclose(pipe);
+        }
+    }
+}
+#endif
+
+#if ALLOCATION_SITES
+static void PrintAllocationSites(const AllocationSite *sites, uint32_t count)
+{
+    std::string names[allocationSitesReported];
+    ResolveAllocationSites(sites, count, names);
+
+    printf("\n%12s %12s  %s\n", "Allocations", "Bytes", "Call site");
+    for (uint32_t i = 0; i < count; i++)
+    {
+        printf("%12llu %12s  %s\n",
+               (unsigned long long)sites[i].count,
+               FormatAllocationBytes((double)sites[i].bytes).c_str(),
+               names[i].c_str());
+    }
+}
+#endif
+
+// Runs from the C library's exit handlers, after static objects are destroyed, so "live at exit" is what leaked. MSVC
+// has no destructor attribute; the handler is registered with atexit while this translation unit is initialized, which
+// runs it after the static objects constructed later are destroyed.
+#if defined(_MSC_VER)
+static void PrintAllocationSummary();
+static int allocationSummaryRegistered = atexit(PrintAllocationSummary);
+
+static void PrintAllocationSummary()
+#else
+__attribute__((destructor)) static void PrintAllocationSummary()
+#endif
+{
+    uint64_t allocations = globalAllocations.allocations.load();
+    uint64_t frees = globalAllocations.frees.load();
+    printf("\n=== ALLOCATIONS ===\n\n");
+    printf("Allocations: %llu (%s requested), frees: %llu\n",
+           (unsigned long long)allocations,
+           FormatAllocationBytes((double)globalAllocations.allocatedBytes.load()).c_str(),
+           (unsigned long long)frees);
+    printf("Peak live: %s, live at exit: %s in %lld blocks\n",
+           FormatAllocationBytes((double)globalAllocations.peakLiveBytes.load()).c_str(),
+           FormatAllocationBytes((double)globalAllocations.liveBytes.load()).c_str(),
+           (long long)(allocations - frees));
+
+    printf("\n%-24s %12s\n", "Requested size", "Allocations");
+    for (int sizeClass = 0; sizeClass < allocationSizeClassCount; sizeClass++)
+    {
+        uint64_t count = globalAllocations.sizeClasses[sizeClass].load();
+        if (!count)
+        {
+            continue;
+        }
+        char range[48];
+        if (sizeClass == 0)
+        {
+            snprintf(range, sizeof(range), "0 B");
+        }
+        else
+        {
+            snprintf(range,
+                     sizeof(range),
+                     "%s - %s",
+                     FormatAllocationBytes((double)(1ull << (sizeClass - 1))).c_str(),
+                     FormatAllocationBytes((double)((1ull << (sizeClass - 1)) * 2 - 1)).c_str());
+        }
+        printf("%-24s %12llu\n", range, (unsigned long long)count);
+    }
+
+#if ALLOCATION_SITES
+    // Selection of the most frequent sites; the table is not touched by allocations made while printing, they only
+    // change counts of sites already chosen
+    AllocationSite top[allocationSitesReported];
+    uint32_t topCount = 0;
+    for (uint32_t slot = 0; slot < allocationSiteCount; slot++)
+    {
+        AllocationSite site = globalAllocations.sites[slot];
+        if (!site.address)
+        {
+            continue;
+        }
+        uint32_t position = topCount < allocationSitesReported ? topCount++ : allocationSitesReported;
+        while (position > 0 && top[position - 1].count < site.count)
+        {
+            if (position < allocationSitesReported)
+            {
+                top[position] = top[position - 1];
+            }
+            position--;
+        }
+        if (position < allocationSitesReported)
+        {
+            top[position] = site;
+        }
+    }
+    PrintAllocationSites(top, topCount);
+    if (globalAllocations.droppedSites)
+    {
+        printf("%llu allocations from sites past the first %u not recorded\n",
+               (unsigned long long)globalAllocations.droppedSites,
+               allocationSiteCount);
+    }
+#endif
+    fflush(stdout);
+}
@@ -0,0 +1,247 @@
+#pragma once
+
+// Bump allocator over one anonymous mapping. The mapping reserves address space for the whole capacity up front, but
+// pages are only backed by memory once they are touched, so an arena sized for an upper bound costs nothing extra.
+// Everything is freed at once when the arena is destroyed.
+//
+// An AllocationMode picks the page size and whether the pages are faulted in up front:
+//   normal    4 KB pages, faulted in on first use
+//   thp       madvise(MADV_HUGEPAGE), transparent 2 MB pages where the kernel can find them
+//   hugetlb   MAP_HUGETLB from the reserved pool (vm.nr_hugepages), falling back to thp when the pool is empty
+// followed optionally by "+populate" (MAP_POPULATE or MADV_POPULATE_WRITE) or "+touch" (write one byte per page from
+// every core, so the pages land on the NUMA node of the thread that touched them).
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <thread>
+#include <vector>
+
+enum class PageMode
+{
+    Normal,
+    TransparentHuge,
+    HugeTlb
+};
+
+enum class PrefaultMode
+{
+    None,
+    Populate,
+    FirstTouch
+};
+
+struct AllocationMode
+{
+    PageMode pages = PageMode::Normal;
+    PrefaultMode prefault = PrefaultMode::None;
+};
+
+struct PageFaultCount
+{
+    long minor = 0;
+    long major = 0;
+};
+
+static const size_t hugePageBytes = 2 * 1024 * 1024;
+
+// Process-wide, so faults taken by other threads in the same interval are included
+static PageFaultCount ReadPageFaults()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    PageFaultCount count;
+    count.minor = usage.ru_minflt;
+    count.major = usage.ru_majflt;
+    return count;
+}
+
+static const char *PageModeName(PageMode mode)
+{
+    switch (mode)
+    {
+        case PageMode::Normal:
+            return "normal";
+        case PageMode::TransparentHuge:
+            return "thp";
+        case PageMode::HugeTlb:
+            return "hugetlb";
+    }
+    return "unknown";
+}
+
+static std::string AllocationModeName(AllocationMode mode)
+{
+    std::string name = PageModeName(mode.pages);
+    if (mode.prefault == PrefaultMode::Populate)
+    {
+        name += "+populate";
+    }
+    else if (mode.prefault == PrefaultMode::FirstTouch)
+    {
+        name += "+touch";
+    }
+    return name;
+}
+
+static inline AllocationMode ParseAllocationMode(const std::string &name)
+{
+    for (PageMode pages : {PageMode::Normal, PageMode::TransparentHuge, PageMode::HugeTlb})
+    {
+        for (PrefaultMode prefault : {PrefaultMode::None, PrefaultMode::Populate, PrefaultMode::FirstTouch})
+        {
+            AllocationMode mode = {pages, prefault};
+            if (AllocationModeName(mode) == name)
+            {
+                return mode;
+            }
+        }
+    }
+    throw std::runtime_error("Unknown allocation mode: " + name);
+}
+
+class Arena
+{
+private:
+    char *base = nullptr;
+    size_t capacity = 0;
+    size_t mappedBytes = 0;
+    size_t used = 0;
+
+    bool Map(size_t bytes, int extraFlags)
+    {
+        void *mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | extraFlags, -1, 0);
+        if (mapping == MAP_FAILED)
+        {
+            return false;
+        }
+        base = (char *)mapping;
+        mappedBytes = bytes;
+        return true;
+    }
+
+    void TouchPages(size_t pageBytes)
+    {
+        int threadCount = (int)std::thread::hardware_concurrency();
+        threadCount = threadCount > 0 ? threadCount : 1;
+        size_t pageCount = (mappedBytes + pageBytes - 1) / pageBytes;
+
+        auto touch = [&](size_t firstPage, size_t lastPage) {
+            for (size_t page = firstPage; page < lastPage; page++)
+            {
+                ((volatile char *)base)[page * pageBytes] = 0;
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (int thread = 1; thread < threadCount; thread++)
+        {
+            threads.emplace_back(touch, pageCount * thread / threadCount, pageCount * (thread + 1) / threadCount);
+        }
+        touch(0, pageCount / threadCount);
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+public:
+    // The mode actually in effect, after any fallback
+    AllocationMode mode;
+    double prefaultSeconds = 0.0;
+    PageFaultCount prefaultFaults;
+
+    Arena(size_t capacity, AllocationMode requested) : capacity(capacity), mode(requested)
+    {
+        if (capacity == 0)
+        {
+            return;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        PageFaultCount faultsBefore = ReadPageFaults();
+
+        bool populate = requested.prefault == PrefaultMode::Populate;
+        if (requested.pages == PageMode::HugeTlb)
+        {
+            // No MAP_NORESERVE here: without a reservation a fault on an empty pool is a SIGBUS, not a failed mmap
+            size_t bytes = (capacity + hugePageBytes - 1) & ~(hugePageBytes - 1);
+            if (!Map(bytes, MAP_HUGETLB | (populate ? MAP_POPULATE : 0)))
+            {
+                mode.pages = PageMode::TransparentHuge;
+            }
+        }
+
+        if (!base)
+        {
+            // MAP_POPULATE would fault in small pages before the huge page hint is set, so thp populates afterwards
+            bool populateNow = populate && mode.pages == PageMode::Normal;
+            if (!Map(capacity, MAP_NORESERVE | (populateNow ? MAP_POPULATE : 0)))
+            {
+                throw std::runtime_error("Unable to reserve " + std::to_string(capacity) + " bytes for the arena");
+            }
+            if (mode.pages == PageMode::TransparentHuge)
+            {
+                // Not fatal: without THP support the arena just uses normal pages
+                madvise(base, mappedBytes, MADV_HUGEPAGE);
+                if (populate && madvise(base, mappedBytes, MADV_POPULATE_WRITE) != 0)
+                {
+                    TouchPages(4096);
+                }
+            }
+        }
+
+        if (requested.prefault == PrefaultMode::FirstTouch)
+        {
+            TouchPages(mode.pages == PageMode::HugeTlb ? hugePageBytes : 4096);
+        }
+
+        PageFaultCount faultsAfter = ReadPageFaults();
+        prefaultFaults.minor = faultsAfter.minor - faultsBefore.minor;
+        prefaultFaults.major = faultsAfter.major - faultsBefore.major;
+        prefaultSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    ~Arena()
+    {
+        if (base)
+        {
+            munmap(base, mappedBytes);
+        }
+    }
+
+    Arena(Arena &&other)
+        : base(other.base), capacity(other.capacity), mappedBytes(other.mappedBytes), used(other.used),
+          mode(other.mode), prefaultSeconds(other.prefaultSeconds), prefaultFaults(other.prefaultFaults)
+    {
+        other.base = nullptr;
+        other.capacity = 0;
+        other.mappedBytes = 0;
+        other.used = 0;
+    }
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    Arena &operator=(Arena &&) = delete;
+
+    // alignment must be a power of two no larger than the page size
+    void *Allocate(size_t bytes, size_t alignment)
+    {
+        size_t start = (used + alignment - 1) & ~(alignment - 1);
+        if (start > capacity || bytes > capacity - start)
+        {
+            throw std::runtime_error("Arena is out of space");
+        }
+        used = start + bytes;
+        return base + start;
+    }
+
+    size_t Used() const
+    {
+        return used;
+    }
+};
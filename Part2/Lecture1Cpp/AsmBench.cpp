@@ -0,0 +1,283 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "AsmKernels.h"
+#include "PerfCounters.h"
+#include "RepetitionTester.h"
+
+// Runs every kernel in AsmKernels.S under the repetition tester and reports its best time per loop iteration. The TSC
+// ticks at a fixed rate, so ticks/iteration equals core cycles/iteration only while the core runs at the TSC frequency;
+// when perf_event can count core cycles, those are reported too, along with branch misses. Each column is the minimum
+// over all repetitions of that test.
+//
+//   loop       the bare loop: the cost every other kernel includes
+//   nop        the same sled of bytes encoded as many short or few long NOPs (decode and uop cache throughput)
+//   chain      four adds, moves or loads per iteration, all on one register or one on each of four (latency vs ports)
+//   align      one loop entered at a sweep of offsets past a 64-byte boundary (fetch and uop cache line splits)
+//   branch     one conditional jump per iteration, following a pattern of taken and not taken (the predictor)
+
+enum class BranchPattern
+{
+    None,
+    NeverTaken,
+    AlwaysTaken,
+    EveryN,
+    Random
+};
+
+struct AsmTest
+{
+    std::string group;
+    std::string name;
+    AsmKernel *kernel;
+    BranchPattern pattern;
+    int period; // EveryN: taken on one iteration in period
+};
+
+struct AsmResult
+{
+    const AsmTest *test;
+    uint64_t repetitions;
+    double ticksPerIteration;
+    double cyclesPerIteration;       // negative when core cycles could not be counted
+    double branchMissesPerIteration; // negative when branch misses could not be counted
+};
+
+// Function prototypes
+static std::vector<AsmTest> BuildTests();
+static void FillPattern(std::vector<uint8_t> &data, BranchPattern pattern, int period);
+static AsmResult RunTest(const AsmTest &test, std::vector<uint8_t> &data, uint64_t iterations, uint32_t secondsToTry,
+                         const PerfCounters &perf);
+static void PrintSummary(const std::vector<AsmResult> &results);
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && (std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help"))
+    {
+        std::cout << "Usage: program [iterations per repetition] [seconds without a new minimum] [output.csv] [group]\n";
+        std::cout << "Groups: loop, nop, chain, align, branch (default: all)\n";
+        return 0;
+    }
+
+    try
+    {
+        uint64_t iterations = argc > 1 ? (uint64_t)std::atoll(argv[1]) : 1024 * 1024;
+        uint32_t secondsToTry = argc > 2 ? (uint32_t)std::atoi(argv[2]) : 2;
+        std::string csvPath = argc > 3 ? argv[3] : "asm_bench.csv";
+        std::string group = argc > 4 ? argv[4] : "";
+        if (!iterations)
+        {
+            throw std::runtime_error("Iterations must be at least 1");
+        }
+
+        FILE *csv = fopen(csvPath.c_str(), "w");
+        if (!csv)
+        {
+            throw std::runtime_error("Unable to open file: " + csvPath);
+        }
+        fprintf(csv, "group,test,iterations,repetitions,ticks_per_iteration,cycles_per_iteration,"
+                     "branch_misses_per_iteration\n");
+
+        PerfCounters perf;
+        perf.Open();
+        printf("Core cycles: %s, branch misses: %s\n",
+               perf.Status(PerfEventCycles),
+               perf.Status(PerfEventBranchMisses));
+
+        // One byte per iteration for the branch kernel; the load kernels only need the leading zeros
+        std::vector<uint8_t> data(iterations < 64 ? 64 : iterations);
+        std::vector<AsmTest> tests = BuildTests();
+        std::vector<AsmResult> results;
+        for (const AsmTest &test : tests)
+        {
+            if (!group.empty() && test.group != group)
+            {
+                continue;
+            }
+
+            AsmResult result = RunTest(test, data, iterations, secondsToTry, perf);
+            if (!result.repetitions)
+            {
+                continue;
+            }
+            // Counters perf_event could not open are left empty
+            char cycles[32] = "", branchMisses[32] = "";
+            if (result.cyclesPerIteration >= 0)
+            {
+                snprintf(cycles, sizeof(cycles), "%.4f", result.cyclesPerIteration);
+            }
+            if (result.branchMissesPerIteration >= 0)
+            {
+                snprintf(branchMisses, sizeof(branchMisses), "%.4f", result.branchMissesPerIteration);
+            }
+            fprintf(csv,
+                    "%s,%s,%llu,%llu,%.4f,%s,%s\n",
+                    test.group.c_str(),
+                    test.name.c_str(),
+                    (unsigned long long)iterations,
+                    (unsigned long long)result.repetitions,
+                    result.ticksPerIteration,
+                    cycles,
+                    branchMisses);
+            fflush(csv);
+            results.push_back(result);
+        }
+        fclose(csv);
+
+        PrintSummary(results);
+        printf("\nWrote %s\n", csvPath.c_str());
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}
+
+static std::vector<AsmTest> BuildTests()
+{
+    std::vector<AsmTest> tests = {
+        {"loop", "empty loop", AsmEmptyLoop, BranchPattern::None, 0},
+
+        {"nop", "3 x 1-byte nop", AsmNop1x3, BranchPattern::None, 0},
+        {"nop", "1 x 3-byte nop", AsmNop3x1, BranchPattern::None, 0},
+        {"nop", "9 x 1-byte nop", AsmNop1x9, BranchPattern::None, 0},
+        {"nop", "1 x 9-byte nop", AsmNop9x1, BranchPattern::None, 0},
+        {"nop", "15 x 1-byte nop", AsmNop1x15, BranchPattern::None, 0},
+        {"nop", "1 x 15-byte nop", AsmNop15x1, BranchPattern::None, 0},
+
+        {"chain", "add dependent x4", AsmAddDependent4, BranchPattern::None, 0},
+        {"chain", "add independent x4", AsmAddIndependent4, BranchPattern::None, 0},
+        {"chain", "mov dependent x4", AsmMovDependent4, BranchPattern::None, 0},
+        {"chain", "mov independent x4", AsmMovIndependent4, BranchPattern::None, 0},
+        {"chain", "load dependent x4", AsmLoadDependent4, BranchPattern::None, 0},
+        {"chain", "load independent x4", AsmLoadIndependent4, BranchPattern::None, 0},
+    };
+
+    for (const AsmLoopOffset &loop : asmLoopOffsets)
+    {
+        tests.push_back({"align", "loop at +" + std::to_string(loop.offset), loop.kernel, BranchPattern::None, 0});
+    }
+
+    tests.push_back({"branch", "never taken", AsmConditionalNop, BranchPattern::NeverTaken, 0});
+    tests.push_back({"branch", "always taken", AsmConditionalNop, BranchPattern::AlwaysTaken, 0});
+    for (int period : {2, 3, 4, 8, 16, 32, 64, 128, 256})
+    {
+        tests.push_back({"branch",
+                         "taken every " + std::to_string(period),
+                         AsmConditionalNop,
+                         BranchPattern::EveryN,
+                         period});
+    }
+    tests.push_back({"branch", "random", AsmConditionalNop, BranchPattern::Random, 0});
+    return tests;
+}
+
+// Bit 0 of each byte decides the branch of one iteration. Patterns without a branch leave the buffer zeroed, which is
+// what the dependent load chain needs.
+static void FillPattern(std::vector<uint8_t> &data, BranchPattern pattern, int period)
+{
+    std::mt19937_64 random(1000);
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        switch (pattern)
+        {
+            case BranchPattern::None:
+            case BranchPattern::NeverTaken:
+                data[i] = 0;
+                break;
+            case BranchPattern::AlwaysTaken:
+                data[i] = 1;
+                break;
+            case BranchPattern::EveryN:
+                data[i] = i % period == 0;
+                break;
+            case BranchPattern::Random:
+                data[i] = (uint8_t)(random() & 1);
+                break;
+        }
+    }
+}
+
+static AsmResult RunTest(const AsmTest &test, std::vector<uint8_t> &data, uint64_t iterations, uint32_t secondsToTry,
+                         const PerfCounters &perf)
+{
+    FillPattern(data, test.pattern, test.period);
+
+    uint64_t minCycles = UINT64_MAX;
+    uint64_t minBranchMisses = UINT64_MAX;
+    RepetitionTester tester;
+    tester.NewTestWave(test.group + ": " + test.name, 0, secondsToTry);
+    while (tester.IsTesting())
+    {
+        PerfEventValues before, after;
+        tester.BeginNoise();
+        perf.Read(&before);
+        tester.BeginTimer();
+        test.kernel(iterations, data.data());
+        tester.EndTimer();
+        perf.Read(&after);
+        tester.EndNoise();
+
+        uint64_t cycles = after.values[PerfEventCycles] - before.values[PerfEventCycles];
+        uint64_t branchMisses = after.values[PerfEventBranchMisses] - before.values[PerfEventBranchMisses];
+        minCycles = cycles < minCycles ? cycles : minCycles;
+        minBranchMisses = branchMisses < minBranchMisses ? branchMisses : minBranchMisses;
+    }
+
+    const RepetitionResults &results = tester.Results();
+    AsmResult result = {&test, results.total.e[RepetitionValueTestCount], 0.0, -1.0, -1.0};
+    if (result.repetitions)
+    {
+        result.ticksPerIteration = (double)results.min.e[RepetitionValueCycles] / iterations;
+        if (perf.Available(PerfEventCycles))
+        {
+            result.cyclesPerIteration = (double)minCycles / iterations;
+        }
+        if (perf.Available(PerfEventBranchMisses))
+        {
+            result.branchMissesPerIteration = (double)minBranchMisses / iterations;
+        }
+    }
+    return result;
+}
+
+static void PrintSummary(const std::vector<AsmResult> &results)
+{
+    printf("\n=== CYCLES PER ITERATION (best repetition) ===\n\n");
+    printf("%-8s %-22s %12s %12s %14s\n", "Group", "Test", "TSC ticks", "Cycles", "Branch misses");
+
+    std::string previousGroup;
+    for (const AsmResult &result : results)
+    {
+        if (!previousGroup.empty() && result.test->group != previousGroup)
+        {
+            printf("\n");
+        }
+        previousGroup = result.test->group;
+
+        printf("%-8s %-22s %12.3f", result.test->group.c_str(), result.test->name.c_str(), result.ticksPerIteration);
+        if (result.cyclesPerIteration >= 0)
+        {
+            printf(" %12.3f", result.cyclesPerIteration);
+        }
+        else
+        {
+            printf(" %12s", "-");
+        }
+        if (result.branchMissesPerIteration >= 0)
+        {
+            printf(" %14.4f\n", result.branchMissesPerIteration);
+        }
+        else
+        {
+            printf(" %14s\n", "-");
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+// The loops in AsmKernels.S. Each runs its body count times; see the .S file for what every body measures. The
+// load kernels read the first 32 bytes of data and AsmConditionalNop reads count bytes of it, one per iteration.
+
+#include <cstdint>
+
+typedef void AsmKernel(uint64_t count, const uint8_t *data);
+
+extern "C"
+{
+    AsmKernel AsmEmptyLoop;
+
+    AsmKernel AsmNop1x3;
+    AsmKernel AsmNop3x1;
+    AsmKernel AsmNop1x9;
+    AsmKernel AsmNop9x1;
+    AsmKernel AsmNop1x15;
+    AsmKernel AsmNop15x1;
+
+    AsmKernel AsmAddDependent4;
+    AsmKernel AsmAddIndependent4;
+    AsmKernel AsmMovDependent4;
+    AsmKernel AsmMovIndependent4;
+    AsmKernel AsmLoadDependent4;
+    AsmKernel AsmLoadIndependent4;
+
+    AsmKernel AsmLoopOffset0;
+    AsmKernel AsmLoopOffset8;
+    AsmKernel AsmLoopOffset16;
+    AsmKernel AsmLoopOffset24;
+    AsmKernel AsmLoopOffset32;
+    AsmKernel AsmLoopOffset40;
+    AsmKernel AsmLoopOffset48;
+    AsmKernel AsmLoopOffset52;
+    AsmKernel AsmLoopOffset56;
+    AsmKernel AsmLoopOffset60;
+    AsmKernel AsmLoopOffset62;
+    AsmKernel AsmLoopOffset63;
+
+    AsmKernel AsmConditionalNop;
+}
+
+struct AsmLoopOffset
+{
+    int offset;
+    AsmKernel *kernel;
+};
+
+// Must list the same offsets as the .irp in AsmKernels.S
+static const AsmLoopOffset asmLoopOffsets[] = {
+    {0, AsmLoopOffset0},
+    {8, AsmLoopOffset8},
+    {16, AsmLoopOffset16},
+    {24, AsmLoopOffset24},
+    {32, AsmLoopOffset32},
+    {40, AsmLoopOffset40},
+    {48, AsmLoopOffset48},
+    {52, AsmLoopOffset52},
+    {56, AsmLoopOffset56},
+    {60, AsmLoopOffset60},
+    {62, AsmLoopOffset62},
+    {63, AsmLoopOffset63},
+};
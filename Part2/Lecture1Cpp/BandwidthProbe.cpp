@@ -0,0 +1,481 @@
+#include <barrier>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <immintrin.h>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "Arena.h"
+#include "HaversineKernel.h"
+#include "HaversineSum.h"
+#include "RepetitionTester.h"
+
+// Memory bandwidth over a sweep of working-set sizes. Each kernel streams through its working set with four
+// independent vector registers per iteration; while the set fits in a cache level the loop runs at that level's
+// bandwidth, and the size where the rate falls off is the capacity of the level. A repetition runs the kernel over the
+// set as many times as it takes to move at least minimumRepetitionBytes, so small sets are not lost in the timer
+// overhead.
+//
+//   read   loads only, XOR-folded so they cannot be dropped
+//   write  stores only
+//   copy   loads from one set, stores to another the same size; both count towards the bytes moved
+
+typedef void MemoryKernel(char *destination, const char *source, size_t bytes);
+
+enum class MemoryOperation
+{
+    Read,
+    Write,
+    Copy
+};
+
+struct ProbeKernel
+{
+    MemoryOperation operation;
+    int widthBits;
+    MemoryKernel *function;
+};
+
+struct ProbeResult
+{
+    MemoryOperation operation;
+    int widthBits;
+    int threadCount;
+    size_t workingSetBytes;
+    double bestGigabytesPerSecond;
+};
+
+static const size_t minimumRepetitionBytes = 64 * 1024 * 1024;
+static const size_t probePageBytes = 4096; // every thread's slice is a whole number of pages
+
+// Function prototypes
+static const char *OperationName(MemoryOperation operation);
+static std::vector<ProbeKernel> AvailableKernels();
+static std::vector<size_t> WorkingSetSizes(int threads, size_t largest);
+static void PrintCacheSummary(const std::vector<ProbeResult> &results, const ProbeKernel &kernel);
+
+__attribute__((noinline)) static void Read128(char *, const char *source, size_t bytes)
+{
+    __m128i a = _mm_setzero_si128(), b = a, c = a, d = a;
+    for (size_t offset = 0; offset < bytes; offset += 64)
+    {
+        a = _mm_xor_si128(a, _mm_load_si128((const __m128i *)(source + offset)));
+        b = _mm_xor_si128(b, _mm_load_si128((const __m128i *)(source + offset + 16)));
+        c = _mm_xor_si128(c, _mm_load_si128((const __m128i *)(source + offset + 32)));
+        d = _mm_xor_si128(d, _mm_load_si128((const __m128i *)(source + offset + 48)));
+    }
+    __m128i folded = _mm_xor_si128(_mm_xor_si128(a, b), _mm_xor_si128(c, d));
+    __asm__ volatile("" : : "x"(folded));
+}
+
+__attribute__((noinline)) static void Write128(char *destination, const char *, size_t bytes)
+{
+    __m128i value = _mm_set1_epi32(0x5A5A5A5A);
+    for (size_t offset = 0; offset < bytes; offset += 64)
+    {
+        _mm_store_si128((__m128i *)(destination + offset), value);
+        _mm_store_si128((__m128i *)(destination + offset + 16), value);
+        _mm_store_si128((__m128i *)(destination + offset + 32), value);
+        _mm_store_si128((__m128i *)(destination + offset + 48), value);
+    }
+}
+
+__attribute__((noinline)) static void Copy128(char *destination, const char *source, size_t bytes)
+{
+    for (size_t offset = 0; offset < bytes; offset += 64)
+    {
+        __m128i a = _mm_load_si128((const __m128i *)(source + offset));
+        __m128i b = _mm_load_si128((const __m128i *)(source + offset + 16));
+        __m128i c = _mm_load_si128((const __m128i *)(source + offset + 32));
+        __m128i d = _mm_load_si128((const __m128i *)(source + offset + 48));
+        _mm_store_si128((__m128i *)(destination + offset), a);
+        _mm_store_si128((__m128i *)(destination + offset + 16), b);
+        _mm_store_si128((__m128i *)(destination + offset + 32), c);
+        _mm_store_si128((__m128i *)(destination + offset + 48), d);
+    }
+}
+
+__attribute__((target("avx2"), noinline)) static void Read256(char *, const char *source, size_t bytes)
+{
+    __m256i a = _mm256_setzero_si256(), b = a, c = a, d = a;
+    for (size_t offset = 0; offset < bytes; offset += 128)
+    {
+        a = _mm256_xor_si256(a, _mm256_load_si256((const __m256i *)(source + offset)));
+        b = _mm256_xor_si256(b, _mm256_load_si256((const __m256i *)(source + offset + 32)));
+        c = _mm256_xor_si256(c, _mm256_load_si256((const __m256i *)(source + offset + 64)));
+        d = _mm256_xor_si256(d, _mm256_load_si256((const __m256i *)(source + offset + 96)));
+    }
+    __m256i folded = _mm256_xor_si256(_mm256_xor_si256(a, b), _mm256_xor_si256(c, d));
+    __asm__ volatile("" : : "x"(folded));
+}
+
+__attribute__((target("avx2"), noinline)) static void Write256(char *destination, const char *, size_t bytes)
+{
+    __m256i value = _mm256_set1_epi32(0x5A5A5A5A);
+    for (size_t offset = 0; offset < bytes; offset += 128)
+    {
+        _mm256_store_si256((__m256i *)(destination + offset), value);
+        _mm256_store_si256((__m256i *)(destination + offset + 32), value);
+        _mm256_store_si256((__m256i *)(destination + offset + 64), value);
+        _mm256_store_si256((__m256i *)(destination + offset + 96), value);
+    }
+}
+
+__attribute__((target("avx2"), noinline)) static void Copy256(char *destination, const char *source, size_t bytes)
+{
+    for (size_t offset = 0; offset < bytes; offset += 128)
+    {
+        __m256i a = _mm256_load_si256((const __m256i *)(source + offset));
+        __m256i b = _mm256_load_si256((const __m256i *)(source + offset + 32));
+        __m256i c = _mm256_load_si256((const __m256i *)(source + offset + 64));
+        __m256i d = _mm256_load_si256((const __m256i *)(source + offset + 96));
+        _mm256_store_si256((__m256i *)(destination + offset), a);
+        _mm256_store_si256((__m256i *)(destination + offset + 32), b);
+        _mm256_store_si256((__m256i *)(destination + offset + 64), c);
+        _mm256_store_si256((__m256i *)(destination + offset + 96), d);
+    }
+}
+
+__attribute__((target("avx512f"), noinline)) static void Read512(char *, const char *source, size_t bytes)
+{
+    __m512i a = _mm512_setzero_si512(), b = a, c = a, d = a;
+    for (size_t offset = 0; offset < bytes; offset += 256)
+    {
+        a = _mm512_xor_si512(a, _mm512_load_si512(source + offset));
+        b = _mm512_xor_si512(b, _mm512_load_si512(source + offset + 64));
+        c = _mm512_xor_si512(c, _mm512_load_si512(source + offset + 128));
+        d = _mm512_xor_si512(d, _mm512_load_si512(source + offset + 192));
+    }
+    __m512i folded = _mm512_xor_si512(_mm512_xor_si512(a, b), _mm512_xor_si512(c, d));
+    __asm__ volatile("" : : "v"(folded));
+}
+
+__attribute__((target("avx512f"), noinline)) static void Write512(char *destination, const char *, size_t bytes)
+{
+    __m512i value = _mm512_set1_epi32(0x5A5A5A5A);
+    for (size_t offset = 0; offset < bytes; offset += 256)
+    {
+        _mm512_store_si512(destination + offset, value);
+        _mm512_store_si512(destination + offset + 64, value);
+        _mm512_store_si512(destination + offset + 128, value);
+        _mm512_store_si512(destination + offset + 192, value);
+    }
+}
+
+__attribute__((target("avx512f"), noinline)) static void Copy512(char *destination, const char *source, size_t bytes)
+{
+    for (size_t offset = 0; offset < bytes; offset += 256)
+    {
+        __m512i a = _mm512_load_si512(source + offset);
+        __m512i b = _mm512_load_si512(source + offset + 64);
+        __m512i c = _mm512_load_si512(source + offset + 128);
+        __m512i d = _mm512_load_si512(source + offset + 192);
+        _mm512_store_si512(destination + offset, a);
+        _mm512_store_si512(destination + offset + 64, b);
+        _mm512_store_si512(destination + offset + 128, c);
+        _mm512_store_si512(destination + offset + 192, d);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && (std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help"))
+    {
+        std::cout << "Usage: program [largest working set MB] [thread count] [seconds without a new minimum] "
+                     "[output.csv] [allocation mode]\n";
+        std::cout << "Sweeps read, write and copy at every vector width the CPU supports over working sets from 4 KB "
+                     "up (powers of two and the midpoints 1.5x above them), on one thread and on all of them.\n";
+        std::cout << "Allocation modes: normal, thp, hugetlb, each optionally followed by +populate or +touch\n";
+        return 0;
+    }
+
+    try
+    {
+        size_t largestWorkingSet = (argc > 1 ? (size_t)std::atoll(argv[1]) : 512) * 1024 * 1024;
+        int threadCount = argc > 2 ? std::atoi(argv[2]) : DefaultThreadCount();
+        uint32_t secondsToTry = argc > 3 ? (uint32_t)std::atoi(argv[3]) : 1;
+        std::string csvPath = argc > 4 ? argv[4] : "bandwidth.csv";
+        AllocationMode allocationMode = argc > 5 ? ParseAllocationMode(argv[5])
+                                                 : AllocationMode{PageMode::TransparentHuge, PrefaultMode::Populate};
+        threadCount = threadCount > 0 ? threadCount : 1;
+
+        // Source and destination halves, each large enough for the largest working set of every thread together
+        Arena arena(2 * largestWorkingSet + 2 * 4096, allocationMode);
+        char *source = (char *)arena.Allocate(largestWorkingSet, 4096);
+        char *destination = (char *)arena.Allocate(largestWorkingSet, 4096);
+        for (size_t i = 0; i < largestWorkingSet; i += 64)
+        {
+            source[i] = (char)i;
+        }
+        printf("Memory: %.0f MB, %s\n", arena.Used() / (1024.0 * 1024.0), AllocationModeName(arena.mode).c_str());
+
+        std::ofstream csv(csvPath);
+        if (!csv)
+        {
+            throw std::runtime_error("Unable to open file: " + csvPath);
+        }
+        csv << "operation,width_bits,threads,working_set_bytes,repetitions,min_seconds,max_gb_per_s,avg_gb_per_s\n";
+
+        std::vector<ProbeKernel> kernels = AvailableKernels();
+        std::vector<ProbeResult> results;
+        const double gigabyte = 1024.0 * 1024.0 * 1024.0;
+        uint64_t cpuTimerFreq = EstimateCpuTimerFreq();
+
+        std::vector<int> threadCounts = {1};
+        if (threadCount > 1)
+        {
+            threadCounts.push_back(threadCount);
+        }
+
+        for (int threads : threadCounts)
+        {
+            // Workers wait at the barrier between repetitions, so thread start-up is never timed
+            const ProbeKernel *currentKernel = nullptr;
+            size_t sliceBytes = 0;
+            size_t passes = 0;
+            bool done = false;
+            std::barrier start(threads);
+            std::barrier finish(threads);
+
+            auto runSlice = [&](int thread) {
+                char *sliceDestination = destination + thread * sliceBytes;
+                const char *sliceSource = source + thread * sliceBytes;
+                for (size_t pass = 0; pass < passes; pass++)
+                {
+                    currentKernel->function(sliceDestination, sliceSource, sliceBytes);
+                }
+            };
+
+            std::vector<std::thread> workers;
+            for (int thread = 1; thread < threads; thread++)
+            {
+                workers.emplace_back([&, thread] {
+                    for (;;)
+                    {
+                        start.arrive_and_wait();
+                        if (done)
+                        {
+                            return;
+                        }
+                        runSlice(thread);
+                        finish.arrive_and_wait();
+                    }
+                });
+            }
+
+            for (const ProbeKernel &kernel : kernels)
+            {
+                // The working set is split evenly between the threads
+                for (size_t workingSet : WorkingSetSizes(threads, largestWorkingSet))
+                {
+                    currentKernel = &kernel;
+                    sliceBytes = workingSet / threads;
+                    size_t movedPerPass = sliceBytes * threads * (kernel.operation == MemoryOperation::Copy ? 2 : 1);
+                    passes = (minimumRepetitionBytes + movedPerPass - 1) / movedPerPass;
+                    uint64_t repetitionBytes = movedPerPass * passes;
+
+                    char name[128];
+                    snprintf(name,
+                             sizeof(name),
+                             "%s %d-bit, %d thread%s, %zu KB",
+                             OperationName(kernel.operation),
+                             kernel.widthBits,
+                             threads,
+                             threads == 1 ? "" : "s",
+                             workingSet / 1024);
+
+                    RepetitionTester tester;
+                    tester.NewTestWave(name, repetitionBytes, secondsToTry);
+                    while (tester.IsTesting())
+                    {
+                        tester.BeginTime();
+                        start.arrive_and_wait();
+                        runSlice(0);
+                        finish.arrive_and_wait();
+                        tester.EndTime();
+                        tester.CountBytes(repetitionBytes);
+                    }
+
+                    const RepetitionResults &repetitionResults = tester.Results();
+                    uint64_t repetitions = repetitionResults.total.e[RepetitionValueTestCount];
+                    if (!repetitions)
+                    {
+                        continue;
+                    }
+                    double minSeconds = (double)repetitionResults.min.e[RepetitionValueCycles] / cpuTimerFreq;
+                    double avgSeconds =
+                        (double)repetitionResults.total.e[RepetitionValueCycles] / cpuTimerFreq / repetitions;
+                    double bestRate = repetitionBytes / gigabyte / minSeconds;
+
+                    char row[256];
+                    snprintf(row,
+                             sizeof(row),
+                             "%s,%d,%d,%zu,%llu,%.9f,%.3f,%.3f\n",
+                             OperationName(kernel.operation),
+                             kernel.widthBits,
+                             threads,
+                             workingSet,
+                             (unsigned long long)repetitions,
+                             minSeconds,
+                             bestRate,
+                             repetitionBytes / gigabyte / avgSeconds);
+                    csv << row << std::flush;
+                    results.push_back({kernel.operation, kernel.widthBits, threads, workingSet, bestRate});
+                }
+            }
+
+            done = true;
+            start.arrive_and_wait();
+            for (std::thread &worker : workers)
+            {
+                worker.join();
+            }
+        }
+
+        // The widest read on one thread has the sharpest knees: nothing else competes for the caches
+        const ProbeKernel *widestRead = nullptr;
+        for (const ProbeKernel &kernel : kernels)
+        {
+            if (kernel.operation == MemoryOperation::Read)
+            {
+                widestRead = &kernel;
+            }
+        }
+        PrintCacheSummary(results, *widestRead);
+        printf("\nWrote %s\n", csvPath.c_str());
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}
+
+static const char *OperationName(MemoryOperation operation)
+{
+    switch (operation)
+    {
+        case MemoryOperation::Read:
+            return "read";
+        case MemoryOperation::Write:
+            return "write";
+        case MemoryOperation::Copy:
+            return "copy";
+    }
+    return "unknown";
+}
+
+// SSE2 is part of x86-64; the wider kernels only when the CPU and the OS support their registers
+static std::vector<ProbeKernel> AvailableKernels()
+{
+    HaversineKernelType detected = DetectHaversineKernel();
+    std::vector<ProbeKernel> kernels = {
+        {MemoryOperation::Read, 128, Read128},
+        {MemoryOperation::Write, 128, Write128},
+        {MemoryOperation::Copy, 128, Copy128},
+    };
+    if ((int)detected >= (int)HaversineKernelType::Avx2)
+    {
+        kernels.push_back({MemoryOperation::Read, 256, Read256});
+        kernels.push_back({MemoryOperation::Write, 256, Write256});
+        kernels.push_back({MemoryOperation::Copy, 256, Copy256});
+    }
+    if (detected == HaversineKernelType::Avx512)
+    {
+        kernels.push_back({MemoryOperation::Read, 512, Read512});
+        kernels.push_back({MemoryOperation::Write, 512, Write512});
+        kernels.push_back({MemoryOperation::Copy, 512, Copy512});
+    }
+    return kernels;
+}
+
+// Powers of two with the point halfway between each pair (in log terms, 1.5x), so caches such as a 48 KB L1 or a
+// 1.5 MB L2 slice have a sample just at their capacity. Sizes are per-thread slices times the thread count, and a slice
+// has to be whole pages, so the halfway point is skipped below two pages (6 KB would only ever run as 4 KB).
+static std::vector<size_t> WorkingSetSizes(int threads, size_t largest)
+{
+    std::vector<size_t> sizes;
+    for (size_t slice = probePageBytes; slice * threads <= largest; slice *= 2)
+    {
+        sizes.push_back(slice * threads);
+        size_t halfway = slice + slice / 2;
+        if (halfway % probePageBytes == 0 && halfway * threads <= largest)
+        {
+            sizes.push_back(halfway * threads);
+        }
+    }
+    return sizes;
+}
+
+static size_t ReportedCacheBytes(int level)
+{
+    static const int names[] = {_SC_LEVEL1_DCACHE_SIZE, _SC_LEVEL2_CACHE_SIZE, _SC_LEVEL3_CACHE_SIZE};
+    long bytes = sysconf(names[level - 1]);
+    return bytes > 0 ? (size_t)bytes : 0;
+}
+
+// A level ends where the best rate drops below 75% of the fastest rate seen since the previous level ended. Rates often
+// fall over two or three working sets on the way to the next level, so consecutive drops are one transition, not one
+// level each. The capacity is the last working set before the drop, as precise as the sweep's 1.5x steps.
+static void PrintCacheSummary(const std::vector<ProbeResult> &results, const ProbeKernel &kernel)
+{
+    std::vector<const ProbeResult *> curve;
+    for (const ProbeResult &result : results)
+    {
+        if (result.operation == kernel.operation && result.widthBits == kernel.widthBits && result.threadCount == 1)
+        {
+            curve.push_back(&result);
+        }
+    }
+    if (curve.empty())
+    {
+        return;
+    }
+
+    printf("\n=== CACHE SUMMARY (%s %d-bit, 1 thread) ===\n\n", OperationName(kernel.operation), kernel.widthBits);
+    printf("%-8s %16s %16s %16s\n", "Level", "Apparent size", "Reported size", "Best GB/s");
+
+    int level = 1;
+    double levelBest = curve[0]->bestGigabytesPerSecond;
+    bool inTransition = false;
+    for (size_t i = 1; i < curve.size(); i++)
+    {
+        double rate = curve[i]->bestGigabytesPerSecond;
+        if (rate < 0.75 * levelBest)
+        {
+            if (!inTransition && level <= 3)
+            {
+                printf("L%-7d %13zu KB %13zu KB %16.2f\n",
+                       level,
+                       curve[i - 1]->workingSetBytes / 1024,
+                       ReportedCacheBytes(level) / 1024,
+                       levelBest);
+                level++;
+            }
+            inTransition = true;
+            levelBest = rate;
+        }
+        else
+        {
+            inTransition = false;
+            levelBest = rate > levelBest ? rate : levelBest;
+        }
+    }
+
+    // Whatever is left after the last drop: main memory after three levels, otherwise a cache level the sweep never
+    // outgrew
+    if (level > 3)
+    {
+        printf("%-8s %16s %16s %16.2f\n", "DRAM", "-", "-", levelBest);
+    }
+    else
+    {
+        printf("L%-7d %16s %13zu KB %16.2f\n", level, "not reached", ReportedCacheBytes(level) / 1024, levelBest);
+    }
+}
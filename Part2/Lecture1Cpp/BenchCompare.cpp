@@ -0,0 +1,343 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "BenchmarkResults.h"
+
+// Compares two revisions in the benchmark result store. The unit is the run, not the repetition: repetitions of one
+// run share that run's conditions (frequency, neighbours on the machine, page placement), so pooling them would read
+// run-to-run noise as a difference between revisions. Every run is reduced to its median repetition time, and for
+// every benchmark recorded at both revisions the run medians are compared with a two-sided Mann-Whitney U test (exact
+// up to exactMannWhitneyRuns runs per side when there are no ties, normal approximation with tie correction above).
+// The effect size is Cliff's delta: the probability that a candidate run is slower than a baseline one minus the
+// probability that it is faster, from -1 (always faster) to +1 (always slower). A difference is flagged when it is
+// significant at alpha and the effect is at least small (|delta| >= 0.147).
+//
+// Nothing is flagged with fewer than minimumRuns runs on either side. Even then the exact test cannot go below
+// p = 0.1 with 3 runs against 3; at the default alpha of 0.01 it takes 5 runs per side to flag anything. Record
+// runs at both revisions interleaved if possible.
+
+struct SampleSet
+{
+    std::vector<double> runMedians; // nanoseconds, one per run
+    std::string machine;
+    int runs = 0;
+    bool mixedMachines = false;
+};
+
+struct MannWhitney
+{
+    double p;
+    double cliffsDelta; // positive: the candidate is slower
+};
+
+static const double smallEffect = 0.147;
+static const int minimumRuns = 3;
+static const size_t exactMannWhitneyRuns = 20;
+
+// Function prototypes
+static MannWhitney MannWhitneyTest(const std::vector<double> &baseline, const std::vector<double> &candidate);
+static double ExactMannWhitneyP(size_t n1, size_t n2, double u);
+static double Median(std::vector<double> values);
+static std::string FormatNanoseconds(double nanoseconds);
+static const char *EffectName(double cliffsDelta);
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3 || std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help")
+    {
+        std::cout << "Usage: program <baseline revision> <candidate revision> [results.tsv] [alpha] [benchmark filter]\n";
+        std::cout << "Revisions match by prefix (\"+dirty\" runs only when it is given). The results file defaults to "
+                     "$BENCHMARK_RESULTS, alpha to 0.01.\n";
+        std::cout << "Runs are the unit: each run counts as its median repetition, and nothing is flagged with fewer "
+                     "than 3 runs per side.\n";
+        std::cout << "Exits with 1 when any benchmark regressed.\n";
+        return argc < 3 ? 1 : 0;
+    }
+
+    try
+    {
+        std::string baselineRevision = argv[1];
+        std::string candidateRevision = argv[2];
+        std::string path = argc > 3 ? argv[3] : BenchmarkResultsPath();
+        double alpha = argc > 4 ? std::atof(argv[4]) : 0.01;
+        std::string filter = argc > 5 ? argv[5] : "";
+        if (path.empty())
+        {
+            throw std::runtime_error("No results file: pass one or set BENCHMARK_RESULTS");
+        }
+
+        // A "+dirty" run only matches a revision given with the suffix
+        auto matches = [](const std::string &revision, const std::string &wanted) {
+            if (revision.compare(0, wanted.size(), wanted) != 0)
+            {
+                return false;
+            }
+            bool dirty = revision.find("+dirty") != std::string::npos;
+            return !dirty || wanted.find("+dirty") != std::string::npos;
+        };
+
+        std::map<std::string, SampleSet> baseline;
+        std::map<std::string, SampleSet> candidate;
+        for (const BenchmarkRecord &record : ReadBenchmarkResults(path))
+        {
+            if (!filter.empty() && record.benchmark.find(filter) == std::string::npos)
+            {
+                continue;
+            }
+            for (int side = 0; side < 2; side++)
+            {
+                if (!matches(record.revision, side == 0 ? baselineRevision : candidateRevision))
+                {
+                    continue;
+                }
+                SampleSet &set = (side == 0 ? baseline : candidate)[record.benchmark];
+                set.mixedMachines |= set.runs > 0 && set.machine != record.machine;
+                set.machine = record.machine;
+                set.runs++;
+                set.runMedians.push_back(record.medianNanoseconds);
+            }
+        }
+
+        printf("Baseline %s vs candidate %s, alpha %g, %s\n\n",
+               baselineRevision.c_str(),
+               candidateRevision.c_str(),
+               alpha,
+               path.c_str());
+        printf("%-44s %11s %11s %11s %8s %8s %10s  %s\n",
+               "Benchmark",
+               "Runs",
+               "Baseline",
+               "Candidate",
+               "Change",
+               "Delta",
+               "p",
+               "Verdict");
+
+        int compared = 0, regressions = 0, improvements = 0, tooFewRuns = 0;
+        for (const auto &[benchmark, before] : baseline)
+        {
+            auto found = candidate.find(benchmark);
+            if (found == candidate.end())
+            {
+                continue;
+            }
+            const SampleSet &after = found->second;
+
+            double baselineMedian = Median(before.runMedians);
+            double candidateMedian = Median(after.runMedians);
+            MannWhitney test = MannWhitneyTest(before.runMedians, after.runMedians);
+            bool enoughRuns = before.runs >= minimumRuns && after.runs >= minimumRuns;
+            bool significant = enoughRuns && test.p < alpha && std::fabs(test.cliffsDelta) >= smallEffect;
+
+            std::string verdict = "same";
+            if (!enoughRuns)
+            {
+                verdict = "too few runs";
+                tooFewRuns++;
+            }
+            else if (significant && test.cliffsDelta > 0)
+            {
+                verdict = std::string("REGRESSION (") + EffectName(test.cliffsDelta) + ")";
+                regressions++;
+            }
+            else if (significant)
+            {
+                verdict = std::string("improvement (") + EffectName(test.cliffsDelta) + ")";
+                improvements++;
+            }
+            if (before.mixedMachines || after.mixedMachines || before.machine != after.machine)
+            {
+                verdict += ", different machines";
+            }
+
+            char runs[32];
+            snprintf(runs, sizeof(runs), "%d/%d", before.runs, after.runs);
+            std::string name = benchmark.size() > 44 ? benchmark.substr(0, 41) + "..." : benchmark;
+            printf("%-44s %11s %11s %11s %+7.2f%% %+8.3f %10.2e  %s\n",
+                   name.c_str(),
+                   runs,
+                   FormatNanoseconds(baselineMedian).c_str(),
+                   FormatNanoseconds(candidateMedian).c_str(),
+                   100.0 * (candidateMedian - baselineMedian) / baselineMedian,
+                   test.cliffsDelta,
+                   test.p,
+                   verdict.c_str());
+            compared++;
+        }
+
+        printf("\n%d benchmarks compared: %d regressions, %d improvements\n", compared, regressions, improvements);
+        if (tooFewRuns)
+        {
+            printf("%d benchmarks have fewer than %d runs at one of the revisions and were not judged\n",
+                   tooFewRuns,
+                   minimumRuns);
+        }
+        if (!compared)
+        {
+            printf("No benchmark has results at both revisions\n");
+        }
+        return regressions ? 1 : 0;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+}
+
+static MannWhitney MannWhitneyTest(const std::vector<double> &baseline, const std::vector<double> &candidate)
+{
+    struct Ranked
+    {
+        double value;
+        bool candidate;
+    };
+
+    std::vector<Ranked> values;
+    values.reserve(baseline.size() + candidate.size());
+    for (double value : baseline)
+    {
+        values.push_back({value, false});
+    }
+    for (double value : candidate)
+    {
+        values.push_back({value, true});
+    }
+    std::sort(values.begin(), values.end(), [](const Ranked &a, const Ranked &b) { return a.value < b.value; });
+
+    // Tied values share the average of their ranks; each group of t ties shrinks the variance by t^3 - t
+    double candidateRankSum = 0.0;
+    double tieSum = 0.0;
+    for (size_t first = 0; first < values.size();)
+    {
+        size_t last = first;
+        while (last + 1 < values.size() && values[last + 1].value == values[first].value)
+        {
+            last++;
+        }
+        double rank = 0.5 * (double)(first + last) + 1.0;
+        for (size_t i = first; i <= last; i++)
+        {
+            candidateRankSum += values[i].candidate ? rank : 0.0;
+        }
+        double ties = (double)(last - first + 1);
+        tieSum += ties * ties * ties - ties;
+        first = last + 1;
+    }
+
+    double n1 = (double)baseline.size();
+    double n2 = (double)candidate.size();
+    double n = n1 + n2;
+    double u = candidateRankSum - n2 * (n2 + 1.0) / 2.0;
+    double mean = n1 * n2 / 2.0;
+    double variance = n1 * n2 / 12.0 * ((n + 1.0) - tieSum / (n * (n - 1.0)));
+
+    MannWhitney result;
+    result.cliffsDelta = n1 && n2 ? 2.0 * u / (n1 * n2) - 1.0 : 0.0;
+    if (!tieSum && baseline.size() <= exactMannWhitneyRuns && candidate.size() <= exactMannWhitneyRuns)
+    {
+        result.p = ExactMannWhitneyP(baseline.size(), candidate.size(), u);
+        return result;
+    }
+    if (variance <= 0.0)
+    {
+        result.p = 1.0;
+        return result;
+    }
+    double distance = std::fabs(u - mean) - 0.5; // continuity correction
+    double z = (distance > 0.0 ? distance : 0.0) / std::sqrt(variance);
+    result.p = std::erfc(z / std::sqrt(2.0));
+    return result;
+}
+
+// Two-sided p of U from its exact distribution without ties: ways[i][j][k] counts the orderings of i baseline and j
+// candidate values in which k baseline-candidate pairs have the candidate above. Placing the largest value last, it is
+// either a candidate above all i baseline values or a baseline value above none.
+static double ExactMannWhitneyP(size_t n1, size_t n2, double u)
+{
+    std::vector<std::vector<std::vector<double> > > ways(n1 + 1, std::vector<std::vector<double> >(n2 + 1));
+    for (size_t i = 0; i <= n1; i++)
+    {
+        for (size_t j = 0; j <= n2; j++)
+        {
+            std::vector<double> &counts = ways[i][j];
+            counts.assign(i * j + 1, 0.0);
+            if (!i || !j)
+            {
+                counts[0] = 1.0;
+                continue;
+            }
+            for (size_t k = 0; k <= i * j; k++)
+            {
+                double candidateLast = k >= i ? ways[i][j - 1][k - i] : 0.0;
+                double baselineLast = k < ways[i - 1][j].size() ? ways[i - 1][j][k] : 0.0;
+                counts[k] = candidateLast + baselineLast;
+            }
+        }
+    }
+
+    const std::vector<double> &counts = ways[n1][n2];
+    double total = 0.0, atOrBelow = 0.0, atOrAbove = 0.0;
+    for (size_t k = 0; k < counts.size(); k++)
+    {
+        total += counts[k];
+        atOrBelow += (double)k <= u ? counts[k] : 0.0;
+        atOrAbove += (double)k >= u ? counts[k] : 0.0;
+    }
+    double p = 2.0 * (atOrBelow < atOrAbove ? atOrBelow : atOrAbove) / total;
+    return p < 1.0 ? p : 1.0;
+}
+
+static double Median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    size_t count = values.size();
+    return count % 2 ? values[count / 2] : 0.5 * (values[count / 2 - 1] + values[count / 2]);
+}
+
+static std::string FormatNanoseconds(double nanoseconds)
+{
+    char text[32];
+    if (nanoseconds >= 1e9)
+    {
+        snprintf(text, sizeof(text), "%.3f s", nanoseconds / 1e9);
+    }
+    else if (nanoseconds >= 1e6)
+    {
+        snprintf(text, sizeof(text), "%.3f ms", nanoseconds / 1e6);
+    }
+    else if (nanoseconds >= 1e3)
+    {
+        snprintf(text, sizeof(text), "%.3f us", nanoseconds / 1e3);
+    }
+    else
+    {
+        snprintf(text, sizeof(text), "%.1f ns", nanoseconds);
+    }
+    return text;
+}
+
+// Romano et al.'s thresholds for |delta|
+static const char *EffectName(double cliffsDelta)
+{
+    double size = std::fabs(cliffsDelta);
+    if (size >= 0.474)
+    {
+        return "large";
+    }
+    if (size >= 0.33)
+    {
+        return "medium";
+    }
+    if (size >= smallEffect)
+    {
+        return "small";
+    }
+    return "negligible";
+}
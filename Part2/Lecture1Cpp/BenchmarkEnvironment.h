@@ -0,0 +1,267 @@
+#pragma once
+
+// What the machine was doing around a benchmark: which core it ran on, whether the core clock moved, and how often the
+// benchmark thread was interrupted or switched out.
+//
+//   BENCHMARK_CPU=n                 pins the benchmarking thread to logical CPU n, so it is not migrated mid-repetition
+//                                   and its interrupts can be counted on that CPU alone
+//   BENCHMARK_NOISE_THRESHOLD=r     interrupts per millisecond a repetition may take before it counts as noisy
+//                                   (default 1, about four times the tick rate of a 250 Hz kernel)
+//
+// The core clock is compared with the TSC by running a short dependent add chain: with perf_event, as core cycles over
+// reference cycles (ref-cycles tick at the TSC rate); without it, as the add chain's known 1 cycle per add over the TSC
+// ticks it took. A ratio above 1 means turbo, below 1 a throttled or power-saving core; a ratio that moved between two
+// checks means the frequency changed in between and repetitions on either side are not comparable.
+//
+// Interrupts come from /proc/interrupts, in the column of the CPU the repetition ran on: the pinned one, or the one
+// sched_getcpu reports when the thread is not pinned. ReadInterrupts(-1) sums every column and is only for totals, not
+// for comparing with the per-CPU threshold. Context switches come from getrusage(RUSAGE_THREAD); only involuntary ones
+// are noise, since a repetition that blocks in read() switches out voluntarily as part of the work.
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <sched.h>
+#include <stdexcept>
+#include <string>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "../Lecture1/Haversine.CpuTimer/rdtsc.h"
+
+static const double benchmarkClockDriftWarning = 0.02; // relative change of the core clock ratio worth a warning
+static const uint64_t benchmarkClockCheckAdds = 4 * 1024 * 1024;
+static const int benchmarkClockCheckRuns = 5;
+
+struct NoiseCount
+{
+    uint64_t voluntarySwitches = 0;
+    uint64_t involuntarySwitches = 0;
+    uint64_t interrupts = 0;
+};
+
+struct ClockRatio
+{
+    double coreToTsc = 0.0; // 0 when it could not be measured
+    bool fromPerf = false;
+};
+
+// -1 when BENCHMARK_CPU is not set
+static int BenchmarkPinnedCpu()
+{
+    const char *cpu = getenv("BENCHMARK_CPU");
+    if (!cpu || !*cpu)
+    {
+        return -1;
+    }
+    char *end = nullptr;
+    long value = strtol(cpu, &end, 10);
+    if (*end || value < 0 || value >= CPU_SETSIZE)
+    {
+        throw std::runtime_error(std::string("BENCHMARK_CPU is not a CPU number: ") + cpu);
+    }
+    return (int)value;
+}
+
+static double BenchmarkNoiseThreshold()
+{
+    const char *threshold = getenv("BENCHMARK_NOISE_THRESHOLD");
+    return threshold && *threshold ? std::atof(threshold) : 1.0;
+}
+
+static void PinThreadToCpu(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+    {
+        throw std::runtime_error("Could not pin to CPU " + std::to_string(cpu) + ": " + strerror(errno));
+    }
+}
+
+// Interrupts taken so far by one CPU, or by all of them when cpu is -1. Offline CPUs have no column, so the header
+// line is searched for the CPU's name rather than indexed by number.
+static uint64_t ReadInterrupts(int cpu)
+{
+    int fd = open("/proc/interrupts", O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return 0;
+    }
+    std::string text;
+    char buffer[16384];
+    ssize_t bytes;
+    while ((bytes = read(fd, buffer, sizeof(buffer))) > 0)
+    {
+        text.append(buffer, (size_t)bytes);
+    }
+    close(fd);
+
+    size_t lineEnd = text.find('\n');
+    if (lineEnd == std::string::npos)
+    {
+        return 0;
+    }
+
+    int columns = 0;
+    int wantedColumn = -1;
+    const char *header = text.c_str();
+    for (const char *at = header; at < header + lineEnd; at++)
+    {
+        if (at[0] == 'C' && at[1] == 'P' && at[2] == 'U')
+        {
+            if (atoi(at + 3) == cpu)
+            {
+                wantedColumn = columns;
+            }
+            columns++;
+        }
+    }
+    if (cpu >= 0 && wantedColumn < 0)
+    {
+        return 0;
+    }
+
+    // "IRQ:  count count ...  description"; ERR: and MIS: hold a single system-wide error count and are left out
+    uint64_t total = 0;
+    const char *at = header + lineEnd + 1;
+    while (*at)
+    {
+        const char *colon = strchr(at, ':');
+        const char *end = strchr(at, '\n');
+        end = end ? end : at + strlen(at);
+        const char *label = at;
+        while (*label == ' ')
+        {
+            label++;
+        }
+        if (colon && colon < end && strncmp(label, "ERR:", 4) != 0 && strncmp(label, "MIS:", 4) != 0)
+        {
+            const char *field = colon + 1;
+            for (int column = 0; column < columns; column++)
+            {
+                char *next;
+                unsigned long long count = strtoull(field, &next, 10);
+                if (next == field || next > end)
+                {
+                    break;
+                }
+                if (cpu < 0 || column == wantedColumn)
+                {
+                    total += count;
+                }
+                field = next;
+            }
+        }
+        at = *end ? end + 1 : end;
+    }
+    return total;
+}
+
+static NoiseCount ReadNoise(int cpu)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    NoiseCount count;
+    count.voluntarySwitches = (uint64_t)usage.ru_nvcsw;
+    count.involuntarySwitches = (uint64_t)usage.ru_nivcsw;
+    count.interrupts = ReadInterrupts(cpu);
+    return count;
+}
+
+// Four dependent adds per iteration: the loop runs at one add per core cycle whatever the core's width
+static void RunAddChain(uint64_t iterations)
+{
+    uint64_t sum = 0;
+    uint64_t one = 1;
+    __asm__ volatile("1:\n\t"
+                     "add %[one], %[sum]\n\t"
+                     "add %[one], %[sum]\n\t"
+                     "add %[one], %[sum]\n\t"
+                     "add %[one], %[sum]\n\t"
+                     "dec %[iterations]\n\t"
+                     "jnz 1b"
+                     : [iterations] "+r"(iterations), [sum] "+r"(sum)
+                     : [one] "r"(one)
+                     : "cc");
+}
+
+static int OpenClockEvent(uint64_t config, int groupFd)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+
+// Core clock over TSC rate for the calling thread, right now. Takes a few milliseconds.
+static ClockRatio MeasureClockRatio()
+{
+    ClockRatio ratio;
+    uint64_t iterations = benchmarkClockCheckAdds / 4;
+
+    int cycles = OpenClockEvent(PERF_COUNT_HW_CPU_CYCLES, -1);
+    int refCycles = cycles >= 0 ? OpenClockEvent(PERF_COUNT_HW_REF_CPU_CYCLES, cycles) : -1;
+    if (refCycles >= 0)
+    {
+        // Group read: { nr, cycles, ref-cycles }; counting stops in the kernel, so interrupts do not skew the ratio
+        uint64_t before[3], after[3];
+        uint64_t coreTotal = 0, referenceTotal = 0;
+        for (int run = 0; run < benchmarkClockCheckRuns; run++)
+        {
+            if (read(cycles, before, sizeof(before)) != sizeof(before))
+            {
+                break;
+            }
+            RunAddChain(iterations);
+            if (read(cycles, after, sizeof(after)) != sizeof(after))
+            {
+                break;
+            }
+            coreTotal += after[1] - before[1];
+            referenceTotal += after[2] - before[2];
+        }
+        if (referenceTotal)
+        {
+            ratio.coreToTsc = (double)coreTotal / (double)referenceTotal;
+            ratio.fromPerf = true;
+        }
+    }
+    if (refCycles >= 0)
+    {
+        close(refCycles);
+    }
+    if (cycles >= 0)
+    {
+        close(cycles);
+    }
+    if (ratio.fromPerf)
+    {
+        return ratio;
+    }
+
+    // The fastest run is the one nothing interrupted
+    uint64_t minTicks = UINT64_MAX;
+    for (int run = 0; run < benchmarkClockCheckRuns; run++)
+    {
+        uint64_t start = ReadTimestampCounterBegin();
+        RunAddChain(iterations);
+        uint64_t ticks = ReadTimestampCounterEnd() - start;
+        minTicks = ticks < minTicks ? ticks : minTicks;
+    }
+    if (minTicks)
+    {
+        ratio.coreToTsc = (double)benchmarkClockCheckAdds / (double)minTicks;
+    }
+    return ratio;
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+// Local store of benchmark results, one tab-separated line per completed repetition-tester wave, or per whole run of
+// haversine_processor (a wave of one repetition):
+//
+//   time  benchmark  revision  machine  repetitions  min_ns  median_ns  samples_ns
+//
+// benchmark is the program name and the wave name ("read_matrix/read 4096 KB"), revision the git commit the program
+// was built from (BENCHMARK_REVISION, set by build.sh, with "+dirty" when the tree had uncommitted changes) and
+// machine a fingerprint of the CPU, the number of logical CPUs, the TSC frequency and the kernel release, so runs on
+// different hardware are not compared by accident. samples_ns holds the time of every repetition, ';'-separated, with
+// a trailing '!' on the ones the repetition tester marked noisy; past benchmarkStoredSamples the repetitions are thinned
+// to an evenly spaced subset. min_ns and median_ns always cover every repetition.
+//
+// The store is opt-in: results are only appended when BENCHMARK_RESULTS names the file (BENCHMARK_RESULTS=off is
+// the same as leaving it unset), so a plain run leaves nothing behind. bench_compare reads it back.
+
+#include <algorithm>
+#include <cpuid.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <errno.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/utsname.h>
+#include <unistd.h>
+#include <vector>
+#include "../Lecture1/Haversine.CpuTimer/rdtsc.h"
+
+static const size_t benchmarkStoredSamples = 1000;
+
+struct BenchmarkRecord
+{
+    std::string time;
+    std::string benchmark;
+    std::string revision;
+    std::string machine;
+    uint64_t repetitions;
+    double minNanoseconds;
+    double medianNanoseconds;
+    std::vector<double> samples; // nanoseconds
+};
+
+// Empty when the store is turned off, which is the default
+static std::string BenchmarkResultsPath()
+{
+    const char *path = getenv("BENCHMARK_RESULTS");
+    if (!path || !*path || strcmp(path, "off") == 0)
+    {
+        return "";
+    }
+    return path;
+}
+
+#ifndef BENCHMARK_REVISION
+#    define BENCHMARK_REVISION "unknown"
+#endif
+
+static std::string MachineFingerprint()
+{
+    unsigned int brand[12] = {0};
+    if (__get_cpuid_max(0x80000000, 0) >= 0x80000004)
+    {
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            __cpuid(0x80000002 + i, brand[4 * i], brand[4 * i + 1], brand[4 * i + 2], brand[4 * i + 3]);
+        }
+    }
+    char brandString[sizeof(brand) + 1];
+    memcpy(brandString, brand, sizeof(brand));
+    brandString[sizeof(brand)] = '\0';
+
+    // Some brand strings are padded with leading spaces
+    const char *name = brandString;
+    while (*name == ' ')
+    {
+        name++;
+    }
+
+    struct utsname system;
+    const char *release = uname(&system) == 0 ? system.release : "unknown";
+
+    char fingerprint[256];
+    snprintf(fingerprint,
+             sizeof(fingerprint),
+             "%s | %ld cpus | %llu MHz | %s",
+             *name ? name : "unknown cpu",
+             sysconf(_SC_NPROCESSORS_ONLN),
+             (unsigned long long)(EstimateCpuTimerFreq() / 1000000),
+             release);
+    return fingerprint;
+}
+
+// Appends one wave. samples are repetition times in TSC ticks, in the order they ran; noisy is empty or marks each.
+static inline void AppendBenchmarkResult(const std::string &benchmark, const std::vector<uint64_t> &samples,
+                                         const std::vector<uint8_t> &noisy, uint64_t cpuTimerFreq)
+{
+    std::string path = BenchmarkResultsPath();
+    if (path.empty() || samples.empty() || !cpuTimerFreq)
+    {
+        return;
+    }
+
+    FILE *file = fopen(path.c_str(), "a");
+    if (!file)
+    {
+        printf("Could not append to %s: %s\n", path.c_str(), strerror(errno));
+        return;
+    }
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) == 0)
+    {
+        fprintf(file, "time\tbenchmark\trevision\tmachine\trepetitions\tmin_ns\tmedian_ns\tsamples_ns\n");
+    }
+
+    double nanosecondsPerTick = 1e9 / (double)cpuTimerFreq;
+    std::vector<uint64_t> sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+    size_t count = sorted.size();
+    double median = count % 2 ? (double)sorted[count / 2] : 0.5 * ((double)sorted[count / 2 - 1] + sorted[count / 2]);
+
+    char time[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(time, sizeof(time), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    // Tabs and newlines would break the line format
+    std::string name = benchmark;
+    std::replace(name.begin(), name.end(), '\t', ' ');
+    std::replace(name.begin(), name.end(), '\n', ' ');
+
+    fprintf(file,
+            "%s\t%s\t%s\t%s\t%zu\t%.1f\t%.1f\t",
+            time,
+            name.c_str(),
+            BENCHMARK_REVISION,
+            MachineFingerprint().c_str(),
+            count,
+            sorted[0] * nanosecondsPerTick,
+            median * nanosecondsPerTick);
+
+    size_t stored = count < benchmarkStoredSamples ? count : benchmarkStoredSamples;
+    for (size_t i = 0; i < stored; i++)
+    {
+        size_t sample = i * count / stored;
+        bool noisySample = sample < noisy.size() && noisy[sample];
+        fprintf(file, "%s%.1f%s", i ? ";" : "", samples[sample] * nanosecondsPerTick, noisySample ? "!" : "");
+    }
+    fprintf(file, "\n");
+    fclose(file);
+}
+
+// Every record in the file, in the order they were appended. Malformed lines are skipped.
+static inline std::vector<BenchmarkRecord> ReadBenchmarkResults(const std::string &path)
+{
+    FILE *file = fopen(path.c_str(), "r");
+    if (!file)
+    {
+        throw std::runtime_error("Unable to open file: " + path);
+    }
+
+    std::vector<BenchmarkRecord> records;
+    std::string line;
+    char buffer[65536];
+    while (fgets(buffer, sizeof(buffer), file))
+    {
+        line += buffer;
+        if (line.empty() || line.back() != '\n')
+        {
+            continue;
+        }
+        line.pop_back();
+
+        std::vector<std::string> fields;
+        std::stringstream stream(line);
+        std::string field;
+        while (std::getline(stream, field, '\t'))
+        {
+            fields.push_back(field);
+        }
+        line.clear();
+        if (fields.size() != 8 || fields[0] == "time")
+        {
+            continue;
+        }
+
+        BenchmarkRecord record;
+        record.time = fields[0];
+        record.benchmark = fields[1];
+        record.revision = fields[2];
+        record.machine = fields[3];
+        record.repetitions = std::strtoull(fields[4].c_str(), nullptr, 10);
+        record.minNanoseconds = std::atof(fields[5].c_str());
+        record.medianNanoseconds = std::atof(fields[6].c_str());
+        std::stringstream samples(fields[7]);
+        while (std::getline(samples, field, ';'))
+        {
+            record.samples.push_back(std::atof(field.c_str())); // atof stops at a noisy mark
+        }
+        if (!record.samples.empty())
+        {
+            records.push_back(record);
+        }
+    }
+    fclose(file);
+    return records;
+}
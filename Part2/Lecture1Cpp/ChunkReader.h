@@ -0,0 +1,259 @@
+#pragma once
+
+// Chunked file reader that keeps several buffers in flight. A background thread read()s the next chunks while the
+// consumer works on the current one, so parse time hides disk and page-cache time on cold files.
+//
+// Every buffer has prefixBytes of writable space in front of the data. A consumer that needs to carry the unfinished
+// end of one chunk into the next (a JSON object cut in half) copies it to just before the next chunk's data and keeps
+// parsing contiguous memory.
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <fcntl.h>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "MappedFile.h"
+
+struct Chunk
+{
+    char *data = nullptr;
+    size_t size = 0; // 0 once the whole file has been handed out
+    int buffer = -1;
+};
+
+class ChunkReader
+{
+private:
+    int fd = -1;
+    size_t chunkBytes;
+    size_t prefixBytes;
+    std::vector<std::vector<char> > buffers;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<int> freeBuffers;
+    std::deque<Chunk> filledChunks;
+    bool readFailed = false;
+    bool stopping = false;
+    std::thread ioThread;
+    std::chrono::steady_clock::time_point lastRelease;
+    bool released = false;
+
+    void ReadLoop()
+    {
+        while (true)
+        {
+            int buffer;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] {
+                    return stopping || !freeBuffers.empty();
+                });
+                if (stopping)
+                {
+                    return;
+                }
+                buffer = freeBuffers.front();
+                freeBuffers.pop_front();
+            }
+
+            Chunk chunk;
+            chunk.buffer = buffer;
+            chunk.data = buffers[buffer].data() + prefixBytes;
+
+            auto readStart = std::chrono::steady_clock::now();
+            bool failed = false;
+            while (chunk.size < chunkBytes)
+            {
+                ssize_t bytesRead = read(fd, chunk.data + chunk.size, chunkBytes - chunk.size);
+                if (bytesRead < 0)
+                {
+                    failed = true;
+                    break;
+                }
+                if (bytesRead == 0)
+                {
+                    break;
+                }
+                chunk.size += bytesRead;
+            }
+            ioSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - readStart).count();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                readFailed = failed;
+                filledChunks.push_back(chunk);
+            }
+            changed.notify_all();
+
+            if (failed || chunk.size == 0)
+            {
+                return;
+            }
+        }
+    }
+
+public:
+    // Written by the I/O thread, which may still be inside read() after the consumer has found what it needed: only
+    // read once Finish has returned
+    double ioSeconds = 0.0;
+    // Time between the consumer releasing a chunk and getting the next one
+    double waitSeconds = 0.0;
+    size_t bytesRead = 0;
+
+    ChunkReader(const std::string &filePath, size_t chunkBytes, int bufferCount, size_t prefixBytes)
+        : chunkBytes(chunkBytes), prefixBytes(prefixBytes)
+    {
+        fd = open(filePath.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Unable to open file: " + filePath);
+        }
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        if (bufferCount < 1)
+        {
+            bufferCount = 1;
+        }
+        buffers.resize(bufferCount);
+        for (int i = 0; i < bufferCount; i++)
+        {
+            buffers[i].resize(prefixBytes + chunkBytes);
+            freeBuffers.push_back(i);
+        }
+
+        ioThread = std::thread(&ChunkReader::ReadLoop, this);
+    }
+
+    ~ChunkReader()
+    {
+        Finish();
+        close(fd);
+    }
+
+    ChunkReader(const ChunkReader &) = delete;
+    ChunkReader &operator=(const ChunkReader &) = delete;
+
+    // Blocks until the next chunk is read. The chunk stays valid until it is passed to Release.
+    Chunk Acquire()
+    {
+        // Waiting counts from the previous Release: on a busy or single core the I/O thread can run in between, and
+        // that time is just as exposed as time blocked in here
+        auto waitStart = released ? lastRelease : std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] {
+            return !filledChunks.empty();
+        });
+        Chunk chunk = filledChunks.front();
+        filledChunks.pop_front();
+        bool failed = readFailed;
+        lock.unlock();
+        waitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+
+        if (failed)
+        {
+            throw std::runtime_error("Failed to read file");
+        }
+        bytesRead += chunk.size;
+        return chunk;
+    }
+
+    void Release(const Chunk &chunk)
+    {
+        lastRelease = std::chrono::steady_clock::now();
+        released = true;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            freeBuffers.push_back(chunk.buffer);
+        }
+        changed.notify_all();
+    }
+
+    // Stops reading ahead and waits for the I/O thread to exit, after which ioSeconds is final. No chunk may be
+    // acquired afterwards.
+    void Finish()
+    {
+        if (!ioThread.joinable())
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        ioThread.join();
+    }
+
+    // Share of the time spent in read() that the consumer did not have to wait for. Only valid after Finish.
+    double OverlappedFraction() const
+    {
+        if (ioSeconds <= 0.0)
+        {
+            return 0.0;
+        }
+        double overlapped = (ioSeconds - waitSeconds) / ioSeconds;
+        return overlapped < 0.0 ? 0.0 : overlapped;
+    }
+};
+
+// Hands out the whole memory-mapped file as a single chunk, for comparing the chunked readers with mmap. Pages are
+// faulted in by the parser as it goes, so all I/O shows up as parse time.
+class MappedChunkReader
+{
+private:
+    MappedFile mapping;
+    bool handedOut = false;
+
+public:
+    double ioSeconds = 0.0;
+    double waitSeconds = 0.0;
+    size_t bytesRead = 0;
+
+    MappedChunkReader(const std::string &filePath) : mapping(filePath)
+    {
+        madvise((void *)mapping.data, mapping.size, MADV_SEQUENTIAL);
+    }
+
+    // The chunk has no prefix space and is read-only: with a single chunk there is never anything to carry into it
+    Chunk Acquire()
+    {
+        Chunk chunk;
+        if (!handedOut && mapping.size)
+        {
+            chunk.data = (char *)mapping.data;
+            chunk.size = mapping.size;
+            chunk.buffer = 0;
+            bytesRead = mapping.size;
+        }
+        handedOut = true;
+        return chunk;
+    }
+
+    void Release(const Chunk &)
+    {
+    }
+
+    void Finish()
+    {
+    }
+};
+
+// Asks the kernel to drop this file's pages from the page cache so the next read comes from disk.
+static void EvictFromPageCache(const std::string &filePath)
+{
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Unable to open file: " + filePath);
+    }
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
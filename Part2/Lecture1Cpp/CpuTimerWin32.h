@@ -0,0 +1,93 @@
+#pragma once
+
+// The rdtsc.h timer functions Profiler.h needs, for Windows builds (the Part1 simulators are MSVC projects).
+// rdtsc.c is Linux-only: it calibrates from CPUID 0x15, the kernel's tsc_khz or a spin against clock_gettime, and reads
+// the CPU number from IA32_TSC_AUX as Linux sets it. Here everything is header-only, so a project that includes
+// Profiler.h has nothing extra to compile or link. The TSC rate always comes from a spin against
+// QueryPerformanceCounter, and the CPU number from GetCurrentProcessorNumber.
+
+#include <intrin.h>
+#include <stdint.h>
+#include <windows.h>
+
+static const uint32_t cpuTimerUnknownCpu = 0xFFFFFFFF;
+
+static inline uint64_t ReadTimestampCounterBegin()
+{
+    _mm_lfence();
+    uint64_t ticks = __rdtsc();
+    _mm_lfence();
+    return ticks;
+}
+
+static inline uint64_t ReadTimestampCounterEnd()
+{
+    unsigned int aux;
+    uint64_t ticks = __rdtscp(&aux);
+    _mm_lfence();
+    return ticks;
+}
+
+// The CPU is read next to the timestamp rather than with it, so a move in between goes unnoticed; the window is a few
+// instructions wide.
+static inline uint64_t ReadTimestampCounterBeginCpu(uint32_t *cpu)
+{
+    *cpu = (uint32_t)GetCurrentProcessorNumber();
+    return ReadTimestampCounterBegin();
+}
+
+static inline uint64_t ReadTimestampCounterEndCpu(uint32_t *cpu)
+{
+    uint64_t ticks = ReadTimestampCounterEnd();
+    *cpu = (uint32_t)GetCurrentProcessorNumber();
+    return ticks;
+}
+
+// CPUID 0x80000007 EDX bit 8. Windows only uses the TSC for QueryPerformanceCounter when it is also in step across
+// cores, but does not say so, so the invariant bit is all there is to go on.
+static inline int IsCpuTimerInvariant()
+{
+    int registers[4];
+    __cpuid(registers, 0x80000000);
+    if ((unsigned)registers[0] < 0x80000007u)
+    {
+        return 0;
+    }
+    __cpuid(registers, 0x80000007);
+    return (registers[3] & (1 << 8)) != 0;
+}
+
+// TSC ticks over 100 ms of QueryPerformanceCounter, measured once.
+static inline uint64_t EstimateCpuTimerFreq()
+{
+    static uint64_t cpuTimerFreq;
+    if (!cpuTimerFreq)
+    {
+        LARGE_INTEGER osFreq, osStart, osNow;
+        QueryPerformanceFrequency(&osFreq);
+        uint64_t osWait = (uint64_t)osFreq.QuadPart / 10;
+
+        QueryPerformanceCounter(&osStart);
+        uint64_t cpuStart = ReadTimestampCounterBegin();
+        uint64_t osElapsed = 0;
+        while (osElapsed < osWait)
+        {
+            QueryPerformanceCounter(&osNow);
+            osElapsed = (uint64_t)(osNow.QuadPart - osStart.QuadPart);
+        }
+        uint64_t cpuElapsed = ReadTimestampCounterEnd() - cpuStart;
+        cpuTimerFreq = osElapsed ? (uint64_t)((double)cpuElapsed * (double)osFreq.QuadPart / (double)osElapsed) : 0;
+    }
+    return cpuTimerFreq;
+}
+
+// CpuTimerFreqSource_Spin in rdtsc.h
+static inline int GetCpuTimerFreqSource()
+{
+    return 5;
+}
+
+static inline const char *CpuTimerFreqSourceName(int)
+{
+    return "spin against QueryPerformanceCounter";
+}
@@ -0,0 +1,440 @@
+#pragma once
+
+// Fast decimal -> double conversion for the coordinate fields written by JsonFile::Write.
+//
+// Integers of up to four digits with an optional sign, which is everything the generator writes, take an inlined path
+// with no per-digit branches and a fixed instruction sequence: one 8-byte load, the digit count from a SWAR digit mask,
+// and a four-digit SWAR conversion with two multiplies. Everything else goes through an out-of-line function, so the
+// callers' loops keep their registers. There, decimals of up to seven integer and seven fraction digits get the same
+// treatment with eight-digit conversions and one exact division. With numbers of two or three digits, per-digit loops
+// spend most of their time on mispredicted loop exits, so these paths are what set the throughput.
+//
+// Other numbers are accumulated into a 64-bit mantissa (eight digits at a time with SWAR when the input allows it),
+// then converted with Clinger's exact fast path, or the Eisel-Lemire algorithm when that does not apply. Anything
+// neither of them can decide exactly (more than 19 significant digits, exponents outside the table, subnormals,
+// overflow) falls back to strtod, so the result is always the correctly rounded double strtod would return.
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// 128-bit truncated approximations of 5^q, normalized so the top bit is set. Negative powers are rounded up.
+static const int fastFloatSmallestPower = -32;
+static const int fastFloatLargestPower = 32;
+static const uint64_t fastFloatPowersOfFive[][2] = {
+    {0xcfb11ead453994baull, 0x67de18eda5814af2ull}, // 5^-32
+    {0x81ceb32c4b43fcf4ull, 0x80eacf948770ced7ull}, // 5^-31
+    {0xa2425ff75e14fc31ull, 0xa1258379a94d028dull}, // 5^-30
+    {0xcad2f7f5359a3b3eull, 0x096ee45813a04330ull}, // 5^-29
+    {0xfd87b5f28300ca0dull, 0x8bca9d6e188853fcull}, // 5^-28
+    {0x9e74d1b791e07e48ull, 0x775ea264cf55347eull}, // 5^-27
+    {0xc612062576589ddaull, 0x95364afe032a819eull}, // 5^-26
+    {0xf79687aed3eec551ull, 0x3a83ddbd83f52205ull}, // 5^-25
+    {0x9abe14cd44753b52ull, 0xc4926a9672793543ull}, // 5^-24
+    {0xc16d9a0095928a27ull, 0x75b7053c0f178294ull}, // 5^-23
+    {0xf1c90080baf72cb1ull, 0x5324c68b12dd6339ull}, // 5^-22
+    {0x971da05074da7beeull, 0xd3f6fc16ebca5e04ull}, // 5^-21
+    {0xbce5086492111aeaull, 0x88f4bb1ca6bcf585ull}, // 5^-20
+    {0xec1e4a7db69561a5ull, 0x2b31e9e3d06c32e6ull}, // 5^-19
+    {0x9392ee8e921d5d07ull, 0x3aff322e62439fd0ull}, // 5^-18
+    {0xb877aa3236a4b449ull, 0x09befeb9fad487c3ull}, // 5^-17
+    {0xe69594bec44de15bull, 0x4c2ebe687989a9b4ull}, // 5^-16
+    {0x901d7cf73ab0acd9ull, 0x0f9d37014bf60a11ull}, // 5^-15
+    {0xb424dc35095cd80full, 0x538484c19ef38c95ull}, // 5^-14
+    {0xe12e13424bb40e13ull, 0x2865a5f206b06fbaull}, // 5^-13
+    {0x8cbccc096f5088cbull, 0xf93f87b7442e45d4ull}, // 5^-12
+    {0xafebff0bcb24aafeull, 0xf78f69a51539d749ull}, // 5^-11
+    {0xdbe6fecebdedd5beull, 0xb573440e5a884d1cull}, // 5^-10
+    {0x89705f4136b4a597ull, 0x31680a88f8953031ull}, // 5^-9
+    {0xabcc77118461cefcull, 0xfdc20d2b36ba7c3eull}, // 5^-8
+    {0xd6bf94d5e57a42bcull, 0x3d32907604691b4dull}, // 5^-7
+    {0x8637bd05af6c69b5ull, 0xa63f9a49c2c1b110ull}, // 5^-6
+    {0xa7c5ac471b478423ull, 0x0fcf80dc33721d54ull}, // 5^-5
+    {0xd1b71758e219652bull, 0xd3c36113404ea4a9ull}, // 5^-4
+    {0x83126e978d4fdf3bull, 0x645a1cac083126eaull}, // 5^-3
+    {0xa3d70a3d70a3d70aull, 0x3d70a3d70a3d70a4ull}, // 5^-2
+    {0xccccccccccccccccull, 0xcccccccccccccccdull}, // 5^-1
+    {0x8000000000000000ull, 0x0000000000000000ull}, // 5^0
+    {0xa000000000000000ull, 0x0000000000000000ull}, // 5^1
+    {0xc800000000000000ull, 0x0000000000000000ull}, // 5^2
+    {0xfa00000000000000ull, 0x0000000000000000ull}, // 5^3
+    {0x9c40000000000000ull, 0x0000000000000000ull}, // 5^4
+    {0xc350000000000000ull, 0x0000000000000000ull}, // 5^5
+    {0xf424000000000000ull, 0x0000000000000000ull}, // 5^6
+    {0x9896800000000000ull, 0x0000000000000000ull}, // 5^7
+    {0xbebc200000000000ull, 0x0000000000000000ull}, // 5^8
+    {0xee6b280000000000ull, 0x0000000000000000ull}, // 5^9
+    {0x9502f90000000000ull, 0x0000000000000000ull}, // 5^10
+    {0xba43b74000000000ull, 0x0000000000000000ull}, // 5^11
+    {0xe8d4a51000000000ull, 0x0000000000000000ull}, // 5^12
+    {0x9184e72a00000000ull, 0x0000000000000000ull}, // 5^13
+    {0xb5e620f480000000ull, 0x0000000000000000ull}, // 5^14
+    {0xe35fa931a0000000ull, 0x0000000000000000ull}, // 5^15
+    {0x8e1bc9bf04000000ull, 0x0000000000000000ull}, // 5^16
+    {0xb1a2bc2ec5000000ull, 0x0000000000000000ull}, // 5^17
+    {0xde0b6b3a76400000ull, 0x0000000000000000ull}, // 5^18
+    {0x8ac7230489e80000ull, 0x0000000000000000ull}, // 5^19
+    {0xad78ebc5ac620000ull, 0x0000000000000000ull}, // 5^20
+    {0xd8d726b7177a8000ull, 0x0000000000000000ull}, // 5^21
+    {0x878678326eac9000ull, 0x0000000000000000ull}, // 5^22
+    {0xa968163f0a57b400ull, 0x0000000000000000ull}, // 5^23
+    {0xd3c21bcecceda100ull, 0x0000000000000000ull}, // 5^24
+    {0x84595161401484a0ull, 0x0000000000000000ull}, // 5^25
+    {0xa56fa5b99019a5c8ull, 0x0000000000000000ull}, // 5^26
+    {0xcecb8f27f4200f3aull, 0x0000000000000000ull}, // 5^27
+    {0x813f3978f8940984ull, 0x4000000000000000ull}, // 5^28
+    {0xa18f07d736b90be5ull, 0x5000000000000000ull}, // 5^29
+    {0xc9f2c9cd04674edeull, 0xa400000000000000ull}, // 5^30
+    {0xfc6f7c4045812296ull, 0x4d00000000000000ull}, // 5^31
+    {0x9dc5ada82b70b59dull, 0xf020000000000000ull}, // 5^32
+};
+
+// Multipliers that move the first 1 to 4 digits of a chunk to the top of its low 32 bits, by digit count
+static const uint32_t fastFloatAlignDigits[8] = {0, 1u << 24, 1u << 16, 1u << 8, 1, 0, 0, 0};
+static const double fastFloatSigns[2] = {1.0, -1.0};
+
+static const double fastFloatExactPowersOfTen[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                                   1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                                   1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static bool IsDigit(char C)
+{
+    return (unsigned char)(C - '0') < 10;
+}
+
+// True when all eight bytes of Chunk are ASCII digits.
+static bool IsEightDigits(uint64_t Chunk)
+{
+    return (((Chunk + 0x4646464646464646ull) | (Chunk - 0x3030303030303030ull)) & 0x8080808080808080ull) == 0;
+}
+
+// Converts eight ASCII digits (first digit in the lowest byte) to their value with three multiplies.
+static uint32_t ParseEightDigits(uint64_t Chunk)
+{
+    Chunk -= 0x3030303030303030ull;
+    Chunk = (Chunk * 10) + (Chunk >> 8);
+    Chunk = (((Chunk & 0x000000FF000000FFull) * 0x000F424000000064ull)
+             + (((Chunk >> 16) & 0x000000FF000000FFull) * 0x0000271000000001ull))
+            >> 32;
+    return (uint32_t)Chunk;
+}
+
+static uint64_t LoadEightBytes(const char *At)
+{
+    uint64_t Result;
+    memcpy(&Result, At, sizeof(Result));
+    return Result;
+}
+
+// Number of leading ASCII digits in Chunk (first character in the lowest byte), 8 when all are digits. A non-digit
+// byte can disturb the flags of the bytes above it through carries, but never those below, so the lowest flag is exact.
+static int CountLeadingDigits(uint64_t Chunk)
+{
+    uint64_t nonDigits = ((Chunk + 0x4646464646464646ull) | (Chunk - 0x3030303030303030ull)) & 0x8080808080808080ull;
+    return nonDigits ? __builtin_ctzll(nonDigits) >> 3 : 8;
+}
+
+// Value of the first Count (1 to 7) digits of Chunk: they are shifted to the top and the bytes below filled with '0'
+static uint32_t ParseLeadingDigits(uint64_t Chunk, int Count)
+{
+    int shift = 8 * (8 - Count);
+    return ParseEightDigits((Chunk << shift) | (0x3030303030303030ull >> (64 - shift)));
+}
+
+// Accumulates a run of digits into Mantissa. Returns a pointer to the first non-digit.
+static const char *AccumulateDigits(const char *At, const char *End, uint64_t *Mantissa)
+{
+    uint64_t mantissa = *Mantissa;
+    while ((End - At) >= 8 && IsEightDigits(LoadEightBytes(At)))
+    {
+        mantissa = mantissa * 100000000 + ParseEightDigits(LoadEightBytes(At));
+        At += 8;
+    }
+    while (At < End && IsDigit(*At))
+    {
+        mantissa = mantissa * 10 + (uint64_t)(*At - '0');
+        At++;
+    }
+    *Mantissa = mantissa;
+    return At;
+}
+
+static void FullMultiply(uint64_t A, uint64_t B, uint64_t *Low, uint64_t *High)
+{
+    unsigned __int128 product = (unsigned __int128)A * B;
+    *Low = (uint64_t)product;
+    *High = (uint64_t)(product >> 64);
+}
+
+// Eisel-Lemire: computes Mantissa * 10^Power10 correctly rounded, or returns false when it cannot be sure.
+static bool EiselLemire(uint64_t Mantissa, int Power10, bool Negative, double *Result)
+{
+    if (Power10 < fastFloatSmallestPower || Power10 > fastFloatLargestPower)
+    {
+        return false;
+    }
+
+    const uint64_t *powerOfFive = fastFloatPowersOfFive[Power10 - fastFloatSmallestPower];
+
+    int leadingZeros = __builtin_clzll(Mantissa);
+    uint64_t w = Mantissa << leadingZeros;
+
+    // 52 explicit mantissa bits + 3 guard bits
+    const uint64_t precisionMask = 0xFFFFFFFFFFFFFFFFull >> 55;
+    uint64_t low;
+    uint64_t high;
+    FullMultiply(w, powerOfFive[0], &low, &high);
+    if ((high & precisionMask) == precisionMask)
+    {
+        uint64_t secondLow;
+        uint64_t secondHigh;
+        FullMultiply(w, powerOfFive[1], &secondLow, &secondHigh);
+        low += secondHigh;
+        if (secondHigh > low)
+        {
+            high++;
+        }
+    }
+
+    if (low == 0xFFFFFFFFFFFFFFFFull && (Power10 < -27 || Power10 > 55))
+    {
+        return false;
+    }
+
+    int upperBit = (int)(high >> 63);
+    int shift = upperBit + 64 - 52 - 3;
+    uint64_t mantissa = high >> shift;
+    // floor(Power10 * log2(10)) + 63, plus the double exponent bias
+    int power2 = (((152170 + 65536) * Power10) >> 16) + 63 + upperBit - leadingZeros + 1023;
+    if (power2 <= 0)
+    {
+        return false;
+    }
+
+    // Exactly halfway between two doubles: round to even instead of up
+    if (low <= 1 && Power10 >= -4 && Power10 <= 23 && (mantissa & 3) == 1 && (mantissa << shift) == high)
+    {
+        mantissa &= ~1ull;
+    }
+
+    mantissa += (mantissa & 1);
+    mantissa >>= 1;
+    if (mantissa >= (2ull << 52))
+    {
+        mantissa = (1ull << 52);
+        power2++;
+    }
+    mantissa &= ~(1ull << 52);
+
+    if (power2 >= 0x7FF)
+    {
+        return false;
+    }
+
+    uint64_t bits = mantissa | ((uint64_t)power2 << 52) | ((uint64_t)Negative << 63);
+    memcpy(Result, &bits, sizeof(bits));
+    return true;
+}
+
+static double StrtodFallback(const char *Start, const char *End)
+{
+    char buffer[128];
+    size_t length = (size_t)(End - Start);
+    if (length < sizeof(buffer))
+    {
+        memcpy(buffer, Start, length);
+        buffer[length] = '\0';
+        return strtod(buffer, nullptr);
+    }
+
+    std::string copy(Start, length);
+    return strtod(copy.c_str(), nullptr);
+}
+
+// Any number ParseDouble's integer path does not take. Kept out of line so that path inlines into the callers' loops
+// without this function's registers and spills.
+__attribute__((noinline)) static const char *ParseDoubleGeneral(const char *At, const char *End, double *Result)
+{
+    const char *start = At;
+
+    // Without a branch: signs in the generator's output are random, so a branch would mispredict half the time
+    bool negative = At < End && *At == '-';
+    At += negative;
+
+    if (At == End || !IsDigit(*At))
+    {
+        return nullptr;
+    }
+
+    // Decimal path: both digit runs and the byte after them must lie within End
+    if (End - At >= 16)
+    {
+        uint64_t chunk = LoadEightBytes(At);
+        int integerDigits = CountLeadingDigits(chunk);
+        if (integerDigits < 8)
+        {
+            uint64_t mantissa = ParseLeadingDigits(chunk, integerDigits);
+            const char *next = At + integerDigits;
+            int fractionDigits = 0;
+            if (*next == '.')
+            {
+                uint64_t fraction = LoadEightBytes(next + 1);
+                fractionDigits = CountLeadingDigits(fraction);
+                if (fractionDigits > 0 && fractionDigits < 8)
+                {
+                    mantissa = mantissa * (uint64_t)fastFloatExactPowersOfTen[fractionDigits] +
+                               ParseLeadingDigits(fraction, fractionDigits);
+                    next += 1 + fractionDigits;
+                }
+                else
+                {
+                    fractionDigits = -1;
+                }
+            }
+            // At most 14 digits, so the mantissa and the power of ten are exact doubles: one division rounds correctly.
+            // Integers skip the division, whose latency would otherwise be most of the cost.
+            if (fractionDigits >= 0 && *next != 'e' && *next != 'E')
+            {
+                double value = (double)mantissa;
+                if (fractionDigits)
+                {
+                    value /= fastFloatExactPowersOfTen[fractionDigits];
+                }
+                uint64_t bits;
+                memcpy(&bits, &value, sizeof(bits));
+                bits |= (uint64_t)negative << 63;
+                memcpy(Result, &bits, sizeof(bits));
+                return next;
+            }
+        }
+    }
+
+    // Leading zeros carry no significant digits
+    while (At < End && *At == '0')
+    {
+        At++;
+    }
+
+    uint64_t mantissa = 0;
+    const char *integerStart = At;
+    At = AccumulateDigits(At, End, &mantissa);
+    int digitCount = (int)(At - integerStart);
+    int power10 = 0;
+
+    if (At < End && *At == '.')
+    {
+        At++;
+        const char *fractionStart = At;
+        if (mantissa == 0 && digitCount == 0)
+        {
+            while (At < End && *At == '0')
+            {
+                At++;
+            }
+        }
+        const char *significantStart = At;
+        At = AccumulateDigits(At, End, &mantissa);
+        if (At == fractionStart)
+        {
+            return nullptr;
+        }
+        digitCount += (int)(At - significantStart);
+        power10 = -(int)(At - fractionStart);
+    }
+
+    if (At < End && (*At == 'e' || *At == 'E'))
+    {
+        At++;
+        bool negativeExponent = false;
+        if (At < End && (*At == '+' || *At == '-'))
+        {
+            negativeExponent = (*At == '-');
+            At++;
+        }
+        if (At == End || !IsDigit(*At))
+        {
+            return nullptr;
+        }
+        int exponent = 0;
+        while (At < End && IsDigit(*At))
+        {
+            if (exponent < 100000)
+            {
+                exponent = exponent * 10 + (*At - '0');
+            }
+            At++;
+        }
+        power10 += negativeExponent ? -exponent : exponent;
+    }
+
+    if (digitCount > 19)
+    {
+        *Result = StrtodFallback(start, At);
+        return At;
+    }
+
+    if (mantissa == 0)
+    {
+        *Result = negative ? -0.0 : 0.0;
+        return At;
+    }
+
+    // Clinger: both operands are exact doubles, so one correctly rounded IEEE operation gives the answer
+    if (power10 >= -22 && power10 <= 22 && mantissa <= (1ull << 53))
+    {
+        double value = (double)mantissa;
+        if (power10 < 0)
+        {
+            value /= fastFloatExactPowersOfTen[-power10];
+        }
+        else
+        {
+            value *= fastFloatExactPowersOfTen[power10];
+        }
+        *Result = negative ? -value : value;
+        return At;
+    }
+
+    if (!EiselLemire(mantissa, power10, negative, Result))
+    {
+        *Result = StrtodFallback(start, At);
+    }
+    return At;
+}
+
+// Parses a JSON number starting at At into *Result. Returns a pointer one past the number, or nullptr if At does not
+// start a valid number. Never reads at or beyond End.
+__attribute__((always_inline)) static inline const char *ParseDouble(const char *At, const char *End, double *Result)
+{
+    // Integer path, for an optional sign and 1 to 4 digits: the sign, one 8-byte load and the byte after the digits
+    // must lie within End
+    if (__builtin_expect(End - At >= 9, 1))
+    {
+        // Without a branch: signs in the generator's output are random, so a branch would mispredict half the time
+        uint64_t negative = *At == '-';
+        const char *digits = At + negative;
+        uint64_t chunk = LoadEightBytes(digits);
+        uint64_t values = chunk - 0x3030303030303030ull;
+        uint64_t nonDigits = (values | (chunk + 0x4646464646464646ull)) & 0x8080808080808080ull;
+
+        // The flag of the first non-digit is bit 8 * count + 7; the top bit stands in when all eight are digits
+        unsigned lowestFlag = (unsigned)__builtin_ctzll(nonDigits | 0x8000000000000000ull);
+        unsigned count = lowestFlag >> 3;
+        const char *next = digits + count;
+        char after = *next;
+        if (__builtin_expect(lowestFlag - 15 < 25 && after != '.' && (after | 0x20) != 'e', 1))
+        {
+            // Four digits with the first in the lowest byte, zeros in front when there are fewer: pairs, then one
+            // multiply for 100 * high pair + low pair
+            uint32_t fourDigits = (uint32_t)values * fastFloatAlignDigits[count];
+            fourDigits = fourDigits * 10 + (fourDigits >> 8);
+            uint32_t value = ((fourDigits & 0x00FF00FF) * ((100 << 16) + 1)) >> 16;
+
+            // A multiply rather than setting the sign bit keeps the value in a vector register; -0 still comes out -0
+            *Result = (double)(int32_t)value * fastFloatSigns[negative];
+            return next;
+        }
+    }
+    return ParseDoubleGeneral(At, End, Result);
+}
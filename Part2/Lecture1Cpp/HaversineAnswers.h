@@ -0,0 +1,198 @@
+#pragma once
+
+// Binary answer file written by the generator next to the JSON, so a parser and kernel can be validated without
+// parsing the text reference again.
+//
+// Layout (little-endian):
+//   AnswerFileHeader
+//   double distances[count]
+//   AnswerFileTrailer
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <immintrin.h>
+#include <stdexcept>
+#include <string>
+#include "MappedFile.h"
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#    error "The answer file is little-endian and is written and read with plain memory copies"
+#endif
+
+static const char answerFileMagic[8] = {'H', 'V', 'A', 'N', 'S', 'W', 'E', 'R'};
+static const uint32_t answerFileVersion = 1;
+
+struct AnswerFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t distribution;
+    uint64_t count;
+    int64_t seed;
+};
+
+struct AnswerFileTrailer
+{
+    double referenceSum;
+};
+
+static_assert(sizeof(AnswerFileHeader) == 32, "AnswerFileHeader layout is part of the file format");
+
+static inline void WriteAnswerFile(const std::string &filePath,
+                                   const double *distances,
+                                   uint64_t count,
+                                   int64_t seed,
+                                   uint32_t distribution,
+                                   double referenceSum)
+{
+    FILE *file = fopen(filePath.c_str(), "wb");
+    if (!file)
+    {
+        throw std::runtime_error("File is not open, couldn't not write the file");
+    }
+
+    AnswerFileHeader header = {};
+    memcpy(header.magic, answerFileMagic, sizeof(header.magic));
+    header.version = answerFileVersion;
+    header.distribution = distribution;
+    header.count = count;
+    header.seed = seed;
+
+    AnswerFileTrailer trailer = {};
+    trailer.referenceSum = referenceSum;
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+                   && fwrite(distances, sizeof(double), count, file) == count
+                   && fwrite(&trailer, sizeof(trailer), 1, file) == 1;
+    fclose(file);
+
+    if (!written)
+    {
+        throw std::runtime_error("Failed to write file: " + filePath);
+    }
+}
+
+// Maps an answer file and checks that it is complete. distances points straight into the mapping.
+struct AnswerFile
+{
+    MappedFile mapping;
+    AnswerFileHeader header;
+    AnswerFileTrailer trailer;
+    const double *distances;
+
+    AnswerFile(const std::string &filePath) : mapping(filePath)
+    {
+        if (mapping.size < sizeof(header) + sizeof(trailer))
+        {
+            throw std::runtime_error("Answer file is truncated: " + filePath);
+        }
+
+        memcpy(&header, mapping.data, sizeof(header));
+        if (memcmp(header.magic, answerFileMagic, sizeof(header.magic)) != 0 || header.version != answerFileVersion)
+        {
+            throw std::runtime_error("Not a version 1 answer file: " + filePath);
+        }
+        // The count is checked against the space left before multiplying, so a corrupt count cannot wrap the size
+        size_t maxCount = (mapping.size - sizeof(header) - sizeof(trailer)) / sizeof(double);
+        if (header.count > maxCount
+            || mapping.size != sizeof(header) + header.count * sizeof(double) + sizeof(trailer))
+        {
+            throw std::runtime_error("Answer file size does not match its pair count: " + filePath);
+        }
+
+        distances = (const double *)(mapping.data + sizeof(header));
+        memcpy(&trailer, mapping.data + sizeof(header) + header.count * sizeof(double), sizeof(trailer));
+    }
+};
+
+struct AnswerComparison
+{
+    size_t firstMismatch = SIZE_MAX; // SIZE_MAX when every distance is within tolerance
+    size_t maxErrorIndex = 0;
+    double maxError = 0.0;
+};
+
+// Absolute differences above tolerance count as mismatches. NaN answers (libm rounding a slightly outside [0, 1]) never
+// compare greater than the tolerance, so they are skipped rather than reported.
+static AnswerComparison CompareAnswersScalar(const double *computed,
+                                             const double *expected,
+                                             size_t count,
+                                             double tolerance)
+{
+    AnswerComparison result;
+    for (size_t i = 0; i < count; i++)
+    {
+        double error = fabs(computed[i] - expected[i]);
+        if (error > result.maxError)
+        {
+            result.maxError = error;
+            result.maxErrorIndex = i;
+        }
+        if (error > tolerance && result.firstMismatch == SIZE_MAX)
+        {
+            result.firstMismatch = i;
+        }
+    }
+    return result;
+}
+
+__attribute__((target("avx2"))) static AnswerComparison CompareAnswersAvx2(const double *computed,
+                                                                           const double *expected,
+                                                                           size_t count,
+                                                                           double tolerance)
+{
+    AnswerComparison result;
+    __m256d signMask = _mm256_set1_pd(-0.0);
+    __m256d toleranceWide = _mm256_set1_pd(tolerance);
+    __m256d maxError = _mm256_setzero_pd();
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256d error = _mm256_andnot_pd(signMask,
+                                         _mm256_sub_pd(_mm256_loadu_pd(computed + i), _mm256_loadu_pd(expected + i)));
+
+        // Only go back to the scalar bookkeeping when this group raises the running maximum or fails
+        __m256d raised = _mm256_cmp_pd(error, maxError, _CMP_GT_OQ);
+        __m256d failed = _mm256_cmp_pd(error, toleranceWide, _CMP_GT_OQ);
+        if (_mm256_movemask_pd(_mm256_or_pd(raised, failed)))
+        {
+            AnswerComparison group = CompareAnswersScalar(computed + i, expected + i, 4, tolerance);
+            if (group.maxError > result.maxError)
+            {
+                result.maxError = group.maxError;
+                result.maxErrorIndex = i + group.maxErrorIndex;
+                maxError = _mm256_set1_pd(result.maxError);
+            }
+            if (group.firstMismatch != SIZE_MAX && result.firstMismatch == SIZE_MAX)
+            {
+                result.firstMismatch = i + group.firstMismatch;
+                toleranceWide = _mm256_set1_pd(INFINITY);
+            }
+        }
+    }
+
+    AnswerComparison tail = CompareAnswersScalar(computed + i, expected + i, count - i, tolerance);
+    if (tail.maxError > result.maxError)
+    {
+        result.maxError = tail.maxError;
+        result.maxErrorIndex = i + tail.maxErrorIndex;
+    }
+    if (tail.firstMismatch != SIZE_MAX && result.firstMismatch == SIZE_MAX)
+    {
+        result.firstMismatch = i + tail.firstMismatch;
+    }
+    return result;
+}
+
+static inline AnswerComparison CompareAnswers(const double *computed, const double *expected, size_t count,
+                                              double tolerance)
+{
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return CompareAnswersAvx2(computed, expected, count, tolerance);
+    }
+    return CompareAnswersScalar(computed, expected, count, tolerance);
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+// Columnar binary container for coordinate pairs, an mmap-able alternative to the JSON for repeated benchmark runs.
+//
+// Layout (little-endian):
+//   PairFileHeader (64 bytes)
+//   double x0[count], padded to 64 bytes
+//   double y0[count], padded to 64 bytes
+//   double x1[count], padded to 64 bytes
+//   double y1[count], padded to 64 bytes
+//
+// Each column starts on a 64-byte boundary of the file, and mmap returns page-aligned memory, so a mapped file can be
+// handed straight to the batch kernels with no parsing or copying.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "MappedFile.h"
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#    error "The pair file is little-endian and is written and read with plain memory copies"
+#endif
+
+static const char pairFileMagic[8] = {'H', 'V', 'P', 'A', 'I', 'R', 'S', '\0'};
+static const uint32_t pairFileVersion = 1;
+static const uint32_t pairFileDistributionUnknown = 0xFFFFFFFF;
+static const size_t pairFileAlignment = 64;
+
+struct PairFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t distribution;
+    uint64_t count;
+    int64_t seed;
+    uint64_t checksum;
+    uint8_t reserved[24];
+};
+
+static_assert(sizeof(PairFileHeader) == pairFileAlignment, "PairFileHeader layout is part of the file format");
+
+static size_t PairFileColumnStride(uint64_t count)
+{
+    size_t bytes = count * sizeof(double);
+    return (bytes + pairFileAlignment - 1) & ~(pairFileAlignment - 1);
+}
+
+// FNV-1a over 64-bit words of one column, chained across columns through hash.
+static uint64_t PairFileChecksum(uint64_t hash, const double *column, uint64_t count)
+{
+    for (uint64_t i = 0; i < count; i++)
+    {
+        uint64_t word;
+        memcpy(&word, column + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static uint64_t PairFileChecksum(const double *x0, const double *y0, const double *x1, const double *y1, uint64_t count)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = PairFileChecksum(hash, x0, count);
+    hash = PairFileChecksum(hash, y0, count);
+    hash = PairFileChecksum(hash, x1, count);
+    hash = PairFileChecksum(hash, y1, count);
+    return hash;
+}
+
+static void WritePairFile(const std::string &filePath,
+                          const double *x0,
+                          const double *y0,
+                          const double *x1,
+                          const double *y1,
+                          uint64_t count,
+                          int64_t seed,
+                          uint32_t distribution)
+{
+    FILE *file = fopen(filePath.c_str(), "wb");
+    if (!file)
+    {
+        throw std::runtime_error("File is not open, couldn't not write the file");
+    }
+
+    PairFileHeader header = {};
+    memcpy(header.magic, pairFileMagic, sizeof(header.magic));
+    header.version = pairFileVersion;
+    header.distribution = distribution;
+    header.count = count;
+    header.seed = seed;
+    header.checksum = PairFileChecksum(x0, y0, x1, y1, count);
+
+    static const uint8_t padding[pairFileAlignment] = {};
+    size_t paddingBytes = PairFileColumnStride(count) - count * sizeof(double);
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    const double *columns[] = {x0, y0, x1, y1};
+    for (const double *column : columns)
+    {
+        written = written && fwrite(column, sizeof(double), count, file) == count;
+        written = written && fwrite(padding, 1, paddingBytes, file) == paddingBytes;
+    }
+    fclose(file);
+
+    if (!written)
+    {
+        throw std::runtime_error("Failed to write file: " + filePath);
+    }
+}
+
+// Maps a pair file and validates its header and size. The column pointers point straight into the mapping.
+struct PairFile
+{
+    MappedFile mapping;
+    PairFileHeader header;
+    const double *x0;
+    const double *y0;
+    const double *x1;
+    const double *y1;
+
+    PairFile(const std::string &filePath) : mapping(filePath)
+    {
+        if (mapping.size < sizeof(header))
+        {
+            throw std::runtime_error("Pair file is truncated: " + filePath);
+        }
+
+        memcpy(&header, mapping.data, sizeof(header));
+        if (memcmp(header.magic, pairFileMagic, sizeof(header.magic)) != 0 || header.version != pairFileVersion)
+        {
+            throw std::runtime_error("Not a version 1 pair file: " + filePath);
+        }
+
+        // The count is checked against the space the four columns have before multiplying, so a corrupt count cannot
+        // wrap the stride to a size that happens to match
+        size_t maxCount = (mapping.size - sizeof(header)) / 4 / sizeof(double);
+        if (header.count > maxCount)
+        {
+            throw std::runtime_error("Pair file size does not match its pair count: " + filePath);
+        }
+
+        size_t stride = PairFileColumnStride(header.count);
+        if (mapping.size != sizeof(header) + 4 * stride)
+        {
+            throw std::runtime_error("Pair file size does not match its pair count: " + filePath);
+        }
+
+        const char *columns = mapping.data + sizeof(header);
+        x0 = (const double *)(columns + 0 * stride);
+        y0 = (const double *)(columns + 1 * stride);
+        x1 = (const double *)(columns + 2 * stride);
+        y1 = (const double *)(columns + 3 * stride);
+    }
+
+    // Reads every column once, so only call this when the data is not trusted
+    bool VerifyChecksum() const
+    {
+        return PairFileChecksum(x0, y0, x1, y1, header.count) == header.checksum;
+    }
+};
@@ -1,45 +1,44 @@
+#include <chrono>
 #include <cmath>
 #include <cstdio>
 #include <cstring>
 #include <fstream>
 #include <iostream>
-#include <memory>
 #include <stdexcept>
 #include <vector>
-
-// Prototypes
-static double Square(double A);
-static double RadiansFromDegrees(double Degrees);
-static double ReferenceHaversine(double X0, double Y0, double X1, double Y1, double EarthRadius);
+#include "Haversine.h"
+#include "HaversineAnswers.h"
+#include "HaversineBinary.h"
+#include "HaversineJson.h"
+#include "HaversineSum.h"
+#include "PairTable.h"
+#include "Profiler.h"
 
 enum class DistributionType
 {
     Uniform,
     Cluster
 };
-struct Pair
-{
-    double x0;
-    double y0;
-    double x1;
-    double y1;
-};
 
 // Globals
 DistributionType distributionType = DistributionType::Cluster;
 int seed = 1000;
 int numPairs = 1000;
+int threadCount = DefaultThreadCount();
+std::string outputFormat = "json";
+AllocationMode allocationMode = {PageMode::TransparentHuge, PrefaultMode::None};
 
 struct JsonFile
 {
     std::string name;
-    std::shared_ptr<std::vector<Pair> > pairs = std::make_shared<std::vector<Pair> >();
+    PairTable pairs;
 
-    JsonFile(std::string name) : name(name)
+    JsonFile(std::string name, size_t pairCount) : name(name), pairs(pairCount, allocationMode)
     {}
 
     void AddRandom()
     {
+        TimeBandwidth(__func__, numPairs * sizeof(Pair));
         int index = 0;
         for (int i = 0; i < numPairs / 2; i++)
         {
@@ -47,7 +46,7 @@ struct JsonFile
             double x1 = rand() % 361 - 270;
             double y0 = rand() % 181 - 135;
             double y1 = rand() % 181 - 135;
-            pairs->push_back({x0, y0, x1, y1});
+            pairs.Append({x0, y0, x1, y1});
             index++;
         }
 
@@ -57,7 +56,7 @@ struct JsonFile
             double x1 = rand() % 361 - 180;
             double y0 = rand() % 181 - 90;
             double y1 = rand() % 181 - 90;
-            pairs->push_back({x0, y0, x1, y1});
+            pairs.Append({x0, y0, x1, y1});
             index++;
         }
 
@@ -66,6 +65,7 @@ struct JsonFile
 
     void Write()
     {
+        TimeFunction;
         std::string jsonPath = name + ".json";
         std::ofstream file;
         file.open(jsonPath);
@@ -75,30 +75,25 @@ struct JsonFile
             throw std::runtime_error("File is not open, couldn't not write the file");
         }
 
-        file << "{\n";
-        file << "    \"pairs\": [\n";
-
-        for (size_t i = 0; i < pairs->size(); i++)
-        {
-            file << "        { \"x0\": " << pairs->at(i).x0 << ", \"y0\": " << pairs->at(i).y0
-                 << ", \"x1\": " << pairs->at(i).x1 << ", \"y1\": " << pairs->at(i).y1 << " }";
-
-            if (i < pairs->size() - 1)
-            {
-                file << ",\n";
-            }
-            else
-            {
-                file << "\n";
-            }
-        }
+        WritePairsJson(file, pairs);
+    }
 
-        file << "    ]\n";
-        file << "}";
+    void WriteBinary()
+    {
+        TimeBandwidth(__func__, pairs.Size() * sizeof(Pair));
+        WritePairFile(name + ".hvp",
+                      pairs.X0().data(),
+                      pairs.Y0().data(),
+                      pairs.X1().data(),
+                      pairs.Y1().data(),
+                      pairs.Size(),
+                      seed,
+                      (uint32_t)distributionType);
     }
 
     void WriteReferenceHaversine()
     {
+        TimeFunction;
         std::string filePath = name + ".txt";
         std::ofstream file;
         file.open(filePath);
@@ -108,29 +103,67 @@ struct JsonFile
             throw std::runtime_error("File is not open, couldn't not write the file");
         }
 
-        double haversineSum = 0.0;
+        // Same allocation mode as the coordinates, so the fault counts below cover the distance buffer too
+        Arena distanceArena(pairs.Size() * sizeof(double), allocationMode);
+        double *distances = (double *)distanceArena.Allocate(pairs.Size() * sizeof(double), alignof(double));
 
-        file << "Reference Haversine\n";
+        auto computeStart = std::chrono::steady_clock::now();
+        PageFaultCount faultsBefore = ReadPageFaults();
+        double haversineSum;
+        {
+            // The outer zone is the whole parallel pass on the calling thread; every thread's blocks add up in
+            // ReferenceBlocks, with a row per thread
+            TimeBandwidth("ReferenceSum", pairs.Size() * sizeof(Pair));
+            haversineSum = ParallelHaversineSum(pairs.Size(),
+                                                threadCount,
+                                                distances,
+                                                [&](size_t begin, size_t end) {
+                                                    TimeBandwidth("ReferenceBlocks", (end - begin) * sizeof(Pair));
+                                                    PairBatch batch = pairs.Batch(begin, end);
+                                                    for (size_t i = 0; i < batch.size(); i++)
+                                                    {
+                                                        distances[begin + i] = ReferenceHaversine(batch.x0[i],
+                                                                                                  batch.y0[i],
+                                                                                                  batch.x1[i],
+                                                                                                  batch.y1[i],
+                                                                                                  earthRadius);
+                                                    }
+                                                });
+        }
+        double computeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - computeStart).count();
+        PageFaultCount faultsAfter = ReadPageFaults();
 
-        for (size_t i = 0; i < pairs->size(); i++)
         {
-            double x0 = pairs->at(i).x0;
-            double x1 = pairs->at(i).x1;
-            double y0 = pairs->at(i).y0;
-            double y1 = pairs->at(i).y1;
-            double referenceHaversine = ReferenceHaversine(x0, y0, x1, y1, 6372.8);
-
-            haversineSum += referenceHaversine;
-
-            file << "lon1: " << x0;
-            file << ", lon2: " << x1;
-            file << ", lat1: " << y0;
-            file << ", lat2: " << y1;
-            file << ", distance: " << referenceHaversine;
-            file << std::endl;
+            TimeBlock("WriteReferenceText");
+            file << "Reference Haversine\n";
+
+            for (size_t i = 0; i < pairs.Size(); i++)
+            {
+                Pair pair = pairs.Get(i);
+                file << "lon1: " << pair.x0;
+                file << ", lon2: " << pair.x1;
+                file << ", lat1: " << pair.y0;
+                file << ", lat2: " << pair.y1;
+                file << ", distance: " << distances[i];
+                file << std::endl;
+            }
         }
 
-        printf("Expected sum: %f\n", (haversineSum / pairs->size()));
+        double coordinateBytes = (double)pairs.Size() * sizeof(Pair);
+        printf("Threads: %d, %.3f GB/s of coordinates\n",
+               threadCount,
+               computeSeconds > 0 ? coordinateBytes / computeSeconds / 1e9 : 0.0);
+        printf("Reference: %ld minor / %ld major faults (%ld / %ld prefaulting the distances)\n",
+               faultsAfter.minor - faultsBefore.minor,
+               faultsAfter.major - faultsBefore.major,
+               distanceArena.prefaultFaults.minor,
+               distanceArena.prefaultFaults.major);
+        printf("Expected sum: %f\n", (haversineSum / pairs.Size()));
+
+        {
+            TimeBandwidth("WriteAnswerFile", pairs.Size() * sizeof(double));
+            WriteAnswerFile(name + ".f64", distances, pairs.Size(), seed, (uint32_t)distributionType, haversineSum);
+        }
 
         file << "\n";
     }
@@ -140,7 +173,9 @@ int main(int argc, char *argv[])
 {
     if (argc > 1 && (std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help"))
     {
-        std::cout << "Usage: program [uniform/cluster] [random seed] [number of coordinate pairs]\n";
+        std::cout << "Usage: program [uniform/cluster] [random seed] [number of coordinate pairs] [thread count] "
+                     "[json/binary/both] [allocation mode]\n";
+        std::cout << "Allocation modes: normal, thp, hugetlb, each optionally followed by +populate or +touch\n";
         return 0;
     }
 
@@ -149,7 +184,8 @@ int main(int argc, char *argv[])
         std::string type = argv[1];
         if (type != "uniform" && type != "cluster")
         {
-            std::cout << "Usage: program [uniform/cluster] [random seed] [number of coordinate pairs]\n";
+            std::cout << "Usage: program [uniform/cluster] [random seed] [number of coordinate pairs] [thread count] "
+                         "[json/binary/both] [allocation mode]\n";
             return 0;
         }
 
@@ -157,6 +193,10 @@ int main(int argc, char *argv[])
         {
             distributionType = DistributionType::Cluster;
         }
+        else
+        {
+            distributionType = DistributionType::Uniform;
+        }
     }
 
     if (argc > 2)
@@ -168,46 +208,75 @@ int main(int argc, char *argv[])
     if (argc > 3)
     {
         numPairs = std::atoi(argv[3]);
+        if (numPairs < 0)
+        {
+            std::cout << "Number of coordinate pairs must not be negative\n";
+            return 0;
+        }
     }
 
-    JsonFile jsonFile("haversine_input");
-
-    jsonFile.AddRandom();
-    jsonFile.Write();
-    jsonFile.WriteReferenceHaversine();
-
-    return 0;
-}
+    if (argc > 4)
+    {
+        threadCount = std::atoi(argv[4]);
+    }
 
-static double Square(double A)
-{
-    double Result = (A * A);
-    return Result;
-}
+    if (argc > 5)
+    {
+        outputFormat = argv[5];
+        if (outputFormat != "json" && outputFormat != "binary" && outputFormat != "both")
+        {
+            std::cout << "Usage: program [uniform/cluster] [random seed] [number of coordinate pairs] [thread count] "
+                         "[json/binary/both] [allocation mode]\n";
+            return 0;
+        }
+    }
 
-static double RadiansFromDegrees(double Degrees)
-{
-    double Result = 0.01745329251994329577f * Degrees;
-    return Result;
-}
+    if (argc > 6)
+    {
+        try
+        {
+            allocationMode = ParseAllocationMode(argv[6]);
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << e.what() << '\n';
+            return 0;
+        }
+    }
 
-// NOTE(casey): EarthRadius is generally expected to be 6372.8
-static double ReferenceHaversine(double X0, double Y0, double X1, double Y1, double EarthRadius)
-{
-    double lat1 = Y0;
-    double lat2 = Y1;
-    double lon1 = X0;
-    double lon2 = X1;
+    BeginProfile();
 
-    double dLat = RadiansFromDegrees(lat2 - lat1);
-    double dLon = RadiansFromDegrees(lon2 - lon1);
-    lat1 = RadiansFromDegrees(lat1);
-    lat2 = RadiansFromDegrees(lat2);
+    JsonFile jsonFile("haversine_input", numPairs);
+    const Arena &memory = jsonFile.pairs.Memory();
+    printf("Allocation: %s (requested %s), %.1f MB, prefault %.3f s, %ld minor / %ld major faults\n",
+           AllocationModeName(memory.mode).c_str(),
+           AllocationModeName(allocationMode).c_str(),
+           memory.Used() / (1024.0 * 1024.0),
+           memory.prefaultSeconds,
+           memory.prefaultFaults.minor,
+           memory.prefaultFaults.major);
 
-    double a = Square(sin(dLat / 2.0)) + cos(lat1) * cos(lat2) * Square(sin(dLon / 2));
-    double c = 2.0 * asin(sqrt(a));
+    auto generateStart = std::chrono::steady_clock::now();
+    PageFaultCount faultsBefore = ReadPageFaults();
+    jsonFile.AddRandom();
+    PageFaultCount faultsAfter = ReadPageFaults();
+    printf("Generate: %.3f s, %ld minor / %ld major faults\n",
+           std::chrono::duration<double>(std::chrono::steady_clock::now() - generateStart).count(),
+           faultsAfter.minor - faultsBefore.minor,
+           faultsAfter.major - faultsBefore.major);
+    if (outputFormat != "binary")
+    {
+        jsonFile.Write();
+    }
+    if (outputFormat != "json")
+    {
+        jsonFile.WriteBinary();
+    }
+    jsonFile.WriteReferenceHaversine();
 
-    double Result = EarthRadius * c;
+    EndAndPrintProfile();
 
-    return Result;
+    return 0;
 }
+
+ProfilerEndOfCompilationUnit;
@@ -0,0 +1,35 @@
+#pragma once
+
+// The generator's JSON output format, one pair object per line under "pairs".
+
+#include <ostream>
+#include <span>
+#include "PairTable.h"
+
+static void WritePairsJson(std::ostream &out, const PairTable &pairs)
+{
+    out << "{\n";
+    out << "    \"pairs\": [\n";
+
+    std::span<const double> x0 = pairs.X0();
+    std::span<const double> y0 = pairs.Y0();
+    std::span<const double> x1 = pairs.X1();
+    std::span<const double> y1 = pairs.Y1();
+    for (size_t i = 0; i < pairs.Size(); i++)
+    {
+        out << "        { \"x0\": " << x0[i] << ", \"y0\": " << y0[i] << ", \"x1\": " << x1[i] << ", \"y1\": " << y1[i]
+            << " }";
+
+        if (i < pairs.Size() - 1)
+        {
+            out << ",\n";
+        }
+        else
+        {
+            out << "\n";
+        }
+    }
+
+    out << "    ]\n";
+    out << "}";
+}
@@ -0,0 +1,416 @@
+#pragma once
+
+// Batch Haversine kernels over structure-of-arrays coordinates.
+//
+// ReferenceHaversine goes through libm one pair at a time, which the compiler cannot vectorize. These kernels use
+// in-house polynomial approximations instead: sin/cos are reduced to [-pi/4, pi/4] by quadrant and evaluated with
+// minimax-style polynomials, asin is evaluated on [0, 0.5] and reflected above that. sqrt stays the hardware
+// instruction, which is already exact and has vector forms. The AVX2 and AVX-512 paths are picked at runtime from CPUID.
+//
+// Every lane only depends on its own inputs (tails go through a padded vector pass rather than a scalar loop), so a
+// pair produces the same distance no matter where it falls in a batch.
+//
+// Away from antipodes the kernels agree with ReferenceHaversine to about 1e-9 km. Near them the distance is
+// ill-conditioned: with a = 1 - e, asin(sqrt(a)) is about pi/2 - sqrt(e), so a few ulps of difference in a (both sides
+// round differently) become up to a few 1e-4 km in the distance. The same holds at a = 0 for pairs that name one point
+// in two ways, where a is a cancellation. haversineKernelTolerance covers both with margin.
+
+#include <cpuid.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+#include "Haversine.h"
+
+// Largest difference from ReferenceHaversine the kernels are expected to show, in km; the default for validate
+static const double haversineKernelTolerance = 1e-3;
+
+typedef void HaversineBatchFunction(const double *x0,
+                                    const double *y0,
+                                    const double *x1,
+                                    const double *y1,
+                                    double *distances,
+                                    size_t count);
+
+// Matches RadiansFromDegrees, which multiplies by a float literal
+static const double kernelRadiansPerDegree = (double)0.01745329251994329577f;
+
+static const double kernelTwoOverPi = 0.6366197723675814;
+static const double kernelPiOverTwoHigh = 1.5707963267341256; // top 33 bits, so q * high is exact
+static const double kernelPiOverTwoLow = 6.077100506506192e-11;
+static const double kernelPiOverTwo = 1.5707963267948966;
+
+// sin(r) = r + r^3 * S(r^2) on [-pi/4, pi/4]
+static const double kernelSinCoefficients[] = {
+    -0.16666666666666635,
+    0.008333333333322916,
+    -0.00019841269830141677,
+    2.7557313791641424e-06,
+    -2.5050771906061267e-08,
+    1.5897514962677681e-10,
+};
+
+// cos(r) = 1 - r^2 / 2 + r^4 * C(r^2) on [-pi/4, pi/4]
+static const double kernelCosCoefficients[] = {
+    0.041666666666666595,
+    -0.001388888888887329,
+    2.480158728898988e-05,
+    -2.755731421724458e-07,
+    2.087570575327916e-09,
+    -1.1358779199462991e-11,
+};
+
+// asin(x) = x + x^3 * A(x^2) on [0, 0.5]
+static const double kernelAsinCoefficients[] = {
+    0.16666666666665722,
+    0.0750000000027037,
+    0.04464285687901896,
+    0.03038195718570274,
+    0.022371802104300585,
+    0.01735907526936109,
+    0.013891155990621113,
+    0.012132049318887632,
+    0.006682141809386172,
+    0.0191224152709308,
+    -0.015610094529673511,
+    0.03150541852224863,
+};
+
+//
+// Scalar
+//
+
+static double ScalarPolynomial(const double *coefficients, int count, double x)
+{
+    double result = coefficients[count - 1];
+    for (int i = count - 2; i >= 0; i--)
+    {
+        result = result * x + coefficients[i];
+    }
+    return result;
+}
+
+// Quadrant 0 gives sin(x), quadrant 1 gives cos(x)
+static double ScalarSinQuadrant(double x, int quadrantOffset)
+{
+    double q = __builtin_nearbyint(x * kernelTwoOverPi);
+    double r = (x - q * kernelPiOverTwoHigh) - q * kernelPiOverTwoLow;
+    double r2 = r * r;
+
+    double sinR = r + r * r2 * ScalarPolynomial(kernelSinCoefficients, 6, r2);
+    double cosR = 1.0 - 0.5 * r2 + r2 * r2 * ScalarPolynomial(kernelCosCoefficients, 6, r2);
+
+    int quadrant = ((int)q + quadrantOffset) & 3;
+    double result = (quadrant & 1) ? cosR : sinR;
+    return (quadrant & 2) ? -result : result;
+}
+
+static double ScalarAsin(double x)
+{
+    bool reflect = x > 0.5;
+    double u = reflect ? __builtin_sqrt((1.0 - x) * 0.5) : x;
+    double u2 = u * u;
+    double p = u + u * u2 * ScalarPolynomial(kernelAsinCoefficients, 12, u2);
+    return reflect ? kernelPiOverTwo - 2.0 * p : p;
+}
+
+static double ScalarHaversine(double x0, double y0, double x1, double y1)
+{
+    double dLat = (y1 - y0) * kernelRadiansPerDegree;
+    double dLon = (x1 - x0) * kernelRadiansPerDegree;
+    double lat1 = y0 * kernelRadiansPerDegree;
+    double lat2 = y1 * kernelRadiansPerDegree;
+
+    double sinLat = ScalarSinQuadrant(dLat * 0.5, 0);
+    double sinLon = ScalarSinQuadrant(dLon * 0.5, 0);
+    double a = sinLat * sinLat + ScalarSinQuadrant(lat1, 1) * ScalarSinQuadrant(lat2, 1) * (sinLon * sinLon);
+    a = a < 0.0 ? 0.0 : (a > 1.0 ? 1.0 : a);
+
+    return earthRadius * 2.0 * ScalarAsin(__builtin_sqrt(a));
+}
+
+static void HaversineBatchScalar(const double *x0,
+                                 const double *y0,
+                                 const double *x1,
+                                 const double *y1,
+                                 double *distances,
+                                 size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        distances[i] = ScalarHaversine(x0[i], y0[i], x1[i], y1[i]);
+    }
+}
+
+//
+// AVX2 (4 pairs per instruction)
+//
+
+__attribute__((target("avx2,fma"))) static __m256d Avx2Polynomial(const double *coefficients, int count, __m256d x)
+{
+    __m256d result = _mm256_set1_pd(coefficients[count - 1]);
+    for (int i = count - 2; i >= 0; i--)
+    {
+        result = _mm256_fmadd_pd(result, x, _mm256_set1_pd(coefficients[i]));
+    }
+    return result;
+}
+
+__attribute__((target("avx2,fma"))) static __m256d Avx2SinQuadrant(__m256d x, double quadrantOffset)
+{
+    __m256d q = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(kernelTwoOverPi)),
+                                _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_fnmadd_pd(q, _mm256_set1_pd(kernelPiOverTwoHigh), x);
+    r = _mm256_fnmadd_pd(q, _mm256_set1_pd(kernelPiOverTwoLow), r);
+    __m256d r2 = _mm256_mul_pd(r, r);
+
+    __m256d sinR = _mm256_fmadd_pd(_mm256_mul_pd(r, r2), Avx2Polynomial(kernelSinCoefficients, 6, r2), r);
+    __m256d cosR = _mm256_fmadd_pd(_mm256_mul_pd(r2, r2),
+                                   Avx2Polynomial(kernelCosCoefficients, 6, r2),
+                                   _mm256_fnmadd_pd(_mm256_set1_pd(0.5), r2, _mm256_set1_pd(1.0)));
+
+    // quadrant mod 4, kept in doubles so the masks stay 64 bits wide
+    __m256d quadrant = _mm256_add_pd(q, _mm256_set1_pd(quadrantOffset));
+    quadrant = _mm256_sub_pd(quadrant,
+                             _mm256_mul_pd(_mm256_floor_pd(_mm256_mul_pd(quadrant, _mm256_set1_pd(0.25))),
+                                           _mm256_set1_pd(4.0)));
+    __m256d half = _mm256_mul_pd(quadrant, _mm256_set1_pd(0.5));
+    __m256d odd = _mm256_cmp_pd(half, _mm256_floor_pd(half), _CMP_NEQ_OQ);
+    __m256d negate = _mm256_cmp_pd(quadrant, _mm256_set1_pd(2.0), _CMP_GE_OQ);
+
+    __m256d result = _mm256_blendv_pd(sinR, cosR, odd);
+    return _mm256_xor_pd(result, _mm256_and_pd(negate, _mm256_set1_pd(-0.0)));
+}
+
+__attribute__((target("avx2,fma"))) static __m256d Avx2Asin(__m256d x)
+{
+    __m256d reflect = _mm256_cmp_pd(x, _mm256_set1_pd(0.5), _CMP_GT_OQ);
+    __m256d reflected = _mm256_sqrt_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_set1_pd(1.0), x), _mm256_set1_pd(0.5)));
+    __m256d u = _mm256_blendv_pd(x, reflected, reflect);
+    __m256d u2 = _mm256_mul_pd(u, u);
+    __m256d p = _mm256_fmadd_pd(_mm256_mul_pd(u, u2), Avx2Polynomial(kernelAsinCoefficients, 12, u2), u);
+    __m256d pReflected = _mm256_fnmadd_pd(_mm256_set1_pd(2.0), p, _mm256_set1_pd(kernelPiOverTwo));
+    return _mm256_blendv_pd(p, pReflected, reflect);
+}
+
+__attribute__((target("avx2,fma"))) static __m256d Avx2Haversine(__m256d x0, __m256d y0, __m256d x1, __m256d y1)
+{
+    __m256d radians = _mm256_set1_pd(kernelRadiansPerDegree);
+    __m256d dLat = _mm256_mul_pd(_mm256_sub_pd(y1, y0), radians);
+    __m256d dLon = _mm256_mul_pd(_mm256_sub_pd(x1, x0), radians);
+    __m256d lat1 = _mm256_mul_pd(y0, radians);
+    __m256d lat2 = _mm256_mul_pd(y1, radians);
+
+    __m256d sinLat = Avx2SinQuadrant(_mm256_mul_pd(dLat, _mm256_set1_pd(0.5)), 0.0);
+    __m256d sinLon = Avx2SinQuadrant(_mm256_mul_pd(dLon, _mm256_set1_pd(0.5)), 0.0);
+    __m256d cosLat = _mm256_mul_pd(Avx2SinQuadrant(lat1, 1.0), Avx2SinQuadrant(lat2, 1.0));
+    __m256d a = _mm256_fmadd_pd(sinLat, sinLat, _mm256_mul_pd(cosLat, _mm256_mul_pd(sinLon, sinLon)));
+    a = _mm256_min_pd(_mm256_max_pd(a, _mm256_setzero_pd()), _mm256_set1_pd(1.0));
+
+    __m256d c = _mm256_mul_pd(_mm256_set1_pd(2.0), Avx2Asin(_mm256_sqrt_pd(a)));
+    return _mm256_mul_pd(_mm256_set1_pd(earthRadius), c);
+}
+
+__attribute__((target("avx2,fma"))) static void HaversineBatchAvx2(const double *x0,
+                                                                   const double *y0,
+                                                                   const double *x1,
+                                                                   const double *y1,
+                                                                   double *distances,
+                                                                   size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256d result = Avx2Haversine(_mm256_loadu_pd(x0 + i),
+                                       _mm256_loadu_pd(y0 + i),
+                                       _mm256_loadu_pd(x1 + i),
+                                       _mm256_loadu_pd(y1 + i));
+        _mm256_storeu_pd(distances + i, result);
+    }
+
+    if (i < count)
+    {
+        double tail[5][4] = {};
+        size_t remaining = count - i;
+        memcpy(tail[0], x0 + i, remaining * sizeof(double));
+        memcpy(tail[1], y0 + i, remaining * sizeof(double));
+        memcpy(tail[2], x1 + i, remaining * sizeof(double));
+        memcpy(tail[3], y1 + i, remaining * sizeof(double));
+        _mm256_storeu_pd(tail[4],
+                         Avx2Haversine(_mm256_loadu_pd(tail[0]),
+                                       _mm256_loadu_pd(tail[1]),
+                                       _mm256_loadu_pd(tail[2]),
+                                       _mm256_loadu_pd(tail[3])));
+        memcpy(distances + i, tail[4], remaining * sizeof(double));
+    }
+}
+
+//
+// AVX-512 (8 pairs per instruction)
+//
+
+__attribute__((target("avx512f"))) static __m512d Avx512Polynomial(const double *coefficients, int count, __m512d x)
+{
+    __m512d result = _mm512_set1_pd(coefficients[count - 1]);
+    for (int i = count - 2; i >= 0; i--)
+    {
+        result = _mm512_fmadd_pd(result, x, _mm512_set1_pd(coefficients[i]));
+    }
+    return result;
+}
+
+__attribute__((target("avx512f"))) static __m512d Avx512SinQuadrant(__m512d x, double quadrantOffset)
+{
+    __m512d q = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(kernelTwoOverPi)),
+                                     _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m512d r = _mm512_fnmadd_pd(q, _mm512_set1_pd(kernelPiOverTwoHigh), x);
+    r = _mm512_fnmadd_pd(q, _mm512_set1_pd(kernelPiOverTwoLow), r);
+    __m512d r2 = _mm512_mul_pd(r, r);
+
+    __m512d sinR = _mm512_fmadd_pd(_mm512_mul_pd(r, r2), Avx512Polynomial(kernelSinCoefficients, 6, r2), r);
+    __m512d cosR = _mm512_fmadd_pd(_mm512_mul_pd(r2, r2),
+                                   Avx512Polynomial(kernelCosCoefficients, 6, r2),
+                                   _mm512_fnmadd_pd(_mm512_set1_pd(0.5), r2, _mm512_set1_pd(1.0)));
+
+    __m512d quadrant = _mm512_add_pd(q, _mm512_set1_pd(quadrantOffset));
+    quadrant = _mm512_sub_pd(quadrant,
+                             _mm512_mul_pd(_mm512_floor_pd(_mm512_mul_pd(quadrant, _mm512_set1_pd(0.25))),
+                                           _mm512_set1_pd(4.0)));
+    __m512d half = _mm512_mul_pd(quadrant, _mm512_set1_pd(0.5));
+    __mmask8 odd = _mm512_cmp_pd_mask(half, _mm512_floor_pd(half), _CMP_NEQ_OQ);
+    __mmask8 negate = _mm512_cmp_pd_mask(quadrant, _mm512_set1_pd(2.0), _CMP_GE_OQ);
+
+    __m512d result = _mm512_mask_blend_pd(odd, sinR, cosR);
+    return _mm512_mask_sub_pd(result, negate, _mm512_setzero_pd(), result);
+}
+
+__attribute__((target("avx512f"))) static __m512d Avx512Asin(__m512d x)
+{
+    __mmask8 reflect = _mm512_cmp_pd_mask(x, _mm512_set1_pd(0.5), _CMP_GT_OQ);
+    __m512d reflected = _mm512_sqrt_pd(_mm512_mul_pd(_mm512_sub_pd(_mm512_set1_pd(1.0), x), _mm512_set1_pd(0.5)));
+    __m512d u = _mm512_mask_blend_pd(reflect, x, reflected);
+    __m512d u2 = _mm512_mul_pd(u, u);
+    __m512d p = _mm512_fmadd_pd(_mm512_mul_pd(u, u2), Avx512Polynomial(kernelAsinCoefficients, 12, u2), u);
+    __m512d pReflected = _mm512_fnmadd_pd(_mm512_set1_pd(2.0), p, _mm512_set1_pd(kernelPiOverTwo));
+    return _mm512_mask_blend_pd(reflect, p, pReflected);
+}
+
+__attribute__((target("avx512f"))) static __m512d Avx512Haversine(__m512d x0, __m512d y0, __m512d x1, __m512d y1)
+{
+    __m512d radians = _mm512_set1_pd(kernelRadiansPerDegree);
+    __m512d dLat = _mm512_mul_pd(_mm512_sub_pd(y1, y0), radians);
+    __m512d dLon = _mm512_mul_pd(_mm512_sub_pd(x1, x0), radians);
+    __m512d lat1 = _mm512_mul_pd(y0, radians);
+    __m512d lat2 = _mm512_mul_pd(y1, radians);
+
+    __m512d sinLat = Avx512SinQuadrant(_mm512_mul_pd(dLat, _mm512_set1_pd(0.5)), 0.0);
+    __m512d sinLon = Avx512SinQuadrant(_mm512_mul_pd(dLon, _mm512_set1_pd(0.5)), 0.0);
+    __m512d cosLat = _mm512_mul_pd(Avx512SinQuadrant(lat1, 1.0), Avx512SinQuadrant(lat2, 1.0));
+    __m512d a = _mm512_fmadd_pd(sinLat, sinLat, _mm512_mul_pd(cosLat, _mm512_mul_pd(sinLon, sinLon)));
+    a = _mm512_min_pd(_mm512_max_pd(a, _mm512_setzero_pd()), _mm512_set1_pd(1.0));
+
+    __m512d c = _mm512_mul_pd(_mm512_set1_pd(2.0), Avx512Asin(_mm512_sqrt_pd(a)));
+    return _mm512_mul_pd(_mm512_set1_pd(earthRadius), c);
+}
+
+__attribute__((target("avx512f"))) static void HaversineBatchAvx512(const double *x0,
+                                                                    const double *y0,
+                                                                    const double *x1,
+                                                                    const double *y1,
+                                                                    double *distances,
+                                                                    size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m512d result = Avx512Haversine(_mm512_loadu_pd(x0 + i),
+                                         _mm512_loadu_pd(y0 + i),
+                                         _mm512_loadu_pd(x1 + i),
+                                         _mm512_loadu_pd(y1 + i));
+        _mm512_storeu_pd(distances + i, result);
+    }
+
+    if (i < count)
+    {
+        __mmask8 mask = (__mmask8)((1u << (count - i)) - 1);
+        __m512d result = Avx512Haversine(_mm512_maskz_loadu_pd(mask, x0 + i),
+                                         _mm512_maskz_loadu_pd(mask, y0 + i),
+                                         _mm512_maskz_loadu_pd(mask, x1 + i),
+                                         _mm512_maskz_loadu_pd(mask, y1 + i));
+        _mm512_mask_storeu_pd(distances + i, mask, result);
+    }
+}
+
+//
+// Dispatch
+//
+
+enum class HaversineKernelType
+{
+    Scalar,
+    Avx2,
+    Avx512
+};
+
+static inline const char *HaversineKernelName(HaversineKernelType type)
+{
+    switch (type)
+    {
+        case HaversineKernelType::Avx512:
+            return "AVX-512";
+        case HaversineKernelType::Avx2:
+            return "AVX2";
+        default:
+            return "Scalar";
+    }
+}
+
+static inline HaversineBatchFunction *HaversineKernel(HaversineKernelType type)
+{
+    switch (type)
+    {
+        case HaversineKernelType::Avx512:
+            return HaversineBatchAvx512;
+        case HaversineKernelType::Avx2:
+            return HaversineBatchAvx2;
+        default:
+            return HaversineBatchScalar;
+    }
+}
+
+// Checks CPUID for the instruction set and XGETBV for the OS actually saving the wider registers.
+static inline HaversineKernelType DetectHaversineKernel()
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    {
+        return HaversineKernelType::Scalar;
+    }
+
+    bool hasFma = (ecx & bit_FMA) != 0;
+    bool hasOsxsave = (ecx & bit_OSXSAVE) != 0;
+    if (!hasOsxsave)
+    {
+        return HaversineKernelType::Scalar;
+    }
+
+    uint32_t xcrLow, xcrHigh;
+    __asm__("xgetbv" : "=a"(xcrLow), "=d"(xcrHigh) : "c"(0));
+    bool osSavesYmm = (xcrLow & 0x6) == 0x6;
+    bool osSavesZmm = (xcrLow & 0xE6) == 0xE6;
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+    {
+        return HaversineKernelType::Scalar;
+    }
+
+    if ((ebx & bit_AVX512F) && osSavesZmm)
+    {
+        return HaversineKernelType::Avx512;
+    }
+    if ((ebx & bit_AVX2) && hasFma && osSavesYmm)
+    {
+        return HaversineKernelType::Avx2;
+    }
+    return HaversineKernelType::Scalar;
+}
@@ -0,0 +1,1134 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
+#include "BenchmarkResults.h"
+#include "ChunkReader.h"
+#include "FastFloat.h"
+#include "Haversine.h"
+#include "HaversineAnswers.h"
+#include "HaversineBinary.h"
+#include "HaversineKernel.h"
+#include "HaversineSum.h"
+#include "PairTable.h"
+#include "ReadFile.h"
+#include "UringReader.h"
+#include "../Lecture1/Haversine.CpuTimer/rdtsc.h"
+
+struct StreamResult
+{
+    size_t count = 0;
+    double haversineSum = 0.0;
+    size_t bytesRead = 0;
+    double seconds = 0.0;
+    double ioSeconds = 0.0;
+    double waitSeconds = 0.0;
+    double overlappedFraction = -1.0; // Only known for the background-thread reader
+    std::string readerDescription;
+};
+
+// A pair object cut by a chunk boundary is carried over in this much prefix space in front of each chunk
+static const size_t streamCarryBytes = 64 * 1024;
+
+struct NumberSpan
+{
+    const char *start;
+    const char *end;
+};
+
+// Function prototypes
+static PairTable ParsePairs(const char *at, const char *end);
+static const char *FindPairsArray(const char *at, const char *end);
+static const char *ParsePairObject(const char *at, const char *end, Pair *pair);
+static const char *SkipWhiteSpace(const char *at, const char *end);
+static double ComputeDistances(const PairBatch &pairs, std::vector<double> *distances);
+static void Process(const std::string &filePath);
+static void StreamProcess(const std::string &filePath,
+                          size_t chunkBytes,
+                          int bufferCount,
+                          bool cold,
+                          const std::string &readerName);
+static void ReadBench(const std::string &filePath, size_t chunkBytes, int queueDepth);
+static void Convert(const std::string &filePath, const std::string &pairFilePath);
+static void RoundTrip(const std::string &filePath);
+static void Validate(const std::string &filePath, const std::string &answerPath, double tolerance);
+static void FloatCheck(const std::string &filePath);
+static void KernelReport(size_t count);
+static void AllocBench(size_t count);
+static void RecordRun(const std::string &benchmark, double seconds);
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && (std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help"))
+    {
+        std::cout << "Usage: program [haversine_input.json/haversine_input.hvp]\n";
+        std::cout << "       program stream [haversine_input.json] [chunk KB] [buffers in flight] [cold/warm] "
+                     "[thread/uring/pread/mmap]\n";
+        std::cout << "       program readbench [haversine_input.json] [chunk KB] [queue depth]\n";
+        std::cout << "       program convert [haversine_input.json] [haversine_input.hvp]\n";
+        std::cout << "       program roundtrip [haversine_input.json]\n";
+        std::cout << "       program floatcheck [haversine_input.json]\n";
+        std::cout << "       program validate [haversine_input.json] [haversine_input.f64] [tolerance km]\n";
+        std::cout << "       program kernelreport [number of coordinate pairs]\n";
+        std::cout << "       program allocbench [number of coordinate pairs]\n";
+        return 0;
+    }
+
+    try
+    {
+        if (argc > 1 && std::string(argv[1]) == "floatcheck")
+        {
+            FloatCheck(argc > 2 ? argv[2] : "haversine_input.json");
+        }
+        else if (argc > 1 && std::string(argv[1]) == "stream")
+        {
+            StreamProcess(argc > 2 ? argv[2] : "haversine_input.json",
+                          (argc > 3 ? std::atoll(argv[3]) : 1024) * 1024,
+                          argc > 4 ? std::atoi(argv[4]) : 3,
+                          argc > 5 && std::string(argv[5]) == "cold",
+                          argc > 6 ? argv[6] : "thread");
+        }
+        else if (argc > 1 && std::string(argv[1]) == "readbench")
+        {
+            ReadBench(argc > 2 ? argv[2] : "haversine_input.json",
+                      (argc > 3 ? std::atoll(argv[3]) : 1024) * 1024,
+                      argc > 4 ? std::atoi(argv[4]) : 4);
+        }
+        else if (argc > 1 && std::string(argv[1]) == "convert")
+        {
+            Convert(argc > 2 ? argv[2] : "haversine_input.json", argc > 3 ? argv[3] : "haversine_input.hvp");
+        }
+        else if (argc > 1 && std::string(argv[1]) == "roundtrip")
+        {
+            RoundTrip(argc > 2 ? argv[2] : "haversine_input.json");
+        }
+        else if (argc > 1 && std::string(argv[1]) == "validate")
+        {
+            Validate(argc > 2 ? argv[2] : "haversine_input.json",
+                     argc > 3 ? argv[3] : "haversine_input.f64",
+                     argc > 4 ? std::atof(argv[4]) : haversineKernelTolerance);
+        }
+        else if (argc > 1 && std::string(argv[1]) == "kernelreport")
+        {
+            KernelReport(argc > 2 ? std::atoll(argv[2]) : 1000000);
+        }
+        else if (argc > 1 && std::string(argv[1]) == "allocbench")
+        {
+            AllocBench(argc > 2 ? std::atoll(argv[2]) : 4000000);
+        }
+        else
+        {
+            Process(argc > 1 ? argv[1] : "haversine_input.json");
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}
+
+// Runs the best kernel for this CPU over all pairs, filling *distances, and returns the deterministic sum.
+static double ComputeDistances(const PairBatch &pairs, std::vector<double> *distances)
+{
+    size_t count = pairs.size();
+    HaversineKernelType kernelType = DetectHaversineKernel();
+    HaversineBatchFunction *kernel = HaversineKernel(kernelType);
+    distances->resize(count);
+    std::span<double> distanceSpan(*distances);
+    int threadCount = DefaultThreadCount();
+
+    auto computeStart = std::chrono::steady_clock::now();
+    double haversineSum = ParallelHaversineSum(count, threadCount, distanceSpan.data(), [&](size_t begin, size_t end) {
+        ComputeBatch(kernel, pairs.Slice(begin, end), distanceSpan.subspan(begin, end - begin));
+    });
+    double computeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - computeStart).count();
+
+    double coordinateBytes = (double)count * sizeof(Pair);
+    printf("Kernel: %s\n", HaversineKernelName(kernelType));
+    printf("Threads: %d, %.3f GB/s of coordinates\n",
+           threadCount,
+           computeSeconds > 0 ? coordinateBytes / computeSeconds / 1e9 : 0.0);
+
+    return haversineSum;
+}
+
+static bool EndsWith(const std::string &text, const std::string &suffix)
+{
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static double PeakMemoryMegabytes()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+}
+
+static void Process(const std::string &filePath)
+{
+    auto start = std::chrono::steady_clock::now();
+    size_t fileBytes;
+    std::vector<double> distances;
+    double haversineSum;
+    size_t count;
+
+    if (EndsWith(filePath, ".hvp"))
+    {
+        PairFile pairFile(filePath);
+        fileBytes = pairFile.mapping.size;
+        count = pairFile.header.count;
+        haversineSum = ComputeDistances(MakePairBatch(pairFile.x0, pairFile.y0, pairFile.x1, pairFile.y1, count),
+                                        &distances);
+    }
+    else
+    {
+        std::vector<char> fileContent = ReadFile(filePath);
+        fileBytes = fileContent.size();
+        PairTable pairs = ParsePairs(fileContent.data(), fileContent.data() + fileContent.size());
+        count = pairs.Size();
+        haversineSum = ComputeDistances(pairs.Batch(), &distances);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    RecordRun("process " + filePath, seconds);
+
+    printf("Pair count: %zu\n", count);
+    printf("Haversine sum: %f\n", count ? (haversineSum / count) : 0.0);
+    printf("Total: %.3f s, %.3f GB/s of input, peak memory %.1f MB\n",
+           seconds,
+           seconds > 0 ? fileBytes / seconds / 1e9 : 0.0,
+           PeakMemoryMegabytes());
+}
+
+// Feeds complete pair objects from reader straight into the kernel one sum block at a time, so memory stays at the
+// reader's buffers and one block however large the file is. The blocks and their reduction match ParallelHaversineSum,
+// so the sum is bit-identical to the load-everything path. A pair object cut by a chunk boundary is copied into the
+// prefix space in front of the next chunk.
+template <typename Reader>
+static StreamResult StreamPairs(Reader &reader, HaversineBatchFunction *kernel)
+{
+    double block[5][sumBlockPairs];
+    size_t blockCount = 0;
+    BlockSumReducer reducer;
+
+    auto flushBlock = [&]() {
+        kernel(block[0], block[1], block[2], block[3], block[4], blockCount);
+        reducer.Add(KahanSum(block[4], blockCount));
+        blockCount = 0;
+    };
+
+    size_t count = 0;
+    bool inArray = false;
+    bool finished = false;
+    std::vector<char> carry;
+    while (!finished)
+    {
+        Chunk chunk = reader.Acquire();
+        if (chunk.size == 0)
+        {
+            throw std::runtime_error(inArray ? "Unexpected end of file inside the \"pairs\" array"
+                                             : "Malformed JSON, no \"pairs\" array");
+        }
+
+        memcpy(chunk.data - carry.size(), carry.data(), carry.size());
+        const char *at = chunk.data - carry.size();
+        const char *end = chunk.data + chunk.size;
+
+        // "pairs" may be chunks into the file or cut by a chunk boundary: until its '[' is in view, only the part that
+        // could still be the key's start is carried over
+        if (!inArray)
+        {
+            static const char pairsKey[] = "\"pairs\"";
+            const char *key = std::search(at, end, pairsKey, pairsKey + strlen(pairsKey));
+            if (key != end && memchr(key, '[', end - key))
+            {
+                at = FindPairsArray(key, end);
+                inArray = true;
+            }
+            else
+            {
+                at = key != end ? key : end - std::min((size_t)(end - at), strlen(pairsKey) - 1);
+            }
+        }
+
+        while (inArray)
+        {
+            at = SkipWhiteSpace(at, end);
+            if (at == end)
+            {
+                break;
+            }
+            if (*at == ']')
+            {
+                finished = true;
+                break;
+            }
+            if (*at == ',')
+            {
+                at++;
+                continue;
+            }
+
+            // Pair objects never nest, so the first '}' closes this one. Without it the object is still incomplete.
+            const char *closeBrace = (const char *)memchr(at, '}', end - at);
+            if (!closeBrace)
+            {
+                break;
+            }
+
+            Pair pair;
+            at = ParsePairObject(at, closeBrace + 1, &pair);
+            block[0][blockCount] = pair.x0;
+            block[1][blockCount] = pair.y0;
+            block[2][blockCount] = pair.x1;
+            block[3][blockCount] = pair.y1;
+            blockCount++;
+            count++;
+            if (blockCount == sumBlockPairs)
+            {
+                flushBlock();
+            }
+        }
+
+        if ((size_t)(end - at) > streamCarryBytes)
+        {
+            throw std::runtime_error(inArray ? "A pair object does not fit in the carry space"
+                                             : "Malformed JSON, no \"pairs\" array");
+        }
+        carry.assign(at, end);
+        reader.Release(chunk);
+    }
+
+    if (blockCount)
+    {
+        flushBlock();
+    }
+
+    // The array can end before the file does, with reads of the tail still running
+    reader.Finish();
+
+    StreamResult result;
+    result.count = count;
+    result.haversineSum = reducer.Total();
+    result.bytesRead = reader.bytesRead;
+    result.ioSeconds = reader.ioSeconds;
+    result.waitSeconds = reader.waitSeconds;
+    return result;
+}
+
+// Streams filePath through one of the readers: "thread" (read() on a background thread), "uring" (io_uring with
+// registered buffers, pread if unavailable), "pread" (the io_uring reader's fallback, forced) or "mmap".
+// buffers is the number of chunks in flight, which is the queue depth for io_uring.
+static StreamResult StreamFile(const std::string &filePath,
+                               const std::string &readerName,
+                               size_t chunkBytes,
+                               int buffers,
+                               bool cold,
+                               HaversineBatchFunction *kernel)
+{
+    if (chunkBytes < 4096)
+    {
+        throw std::runtime_error("Chunk size must be at least 4 KB");
+    }
+    if (cold)
+    {
+        EvictFromPageCache(filePath);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    StreamResult result;
+    if (readerName == "thread")
+    {
+        ChunkReader reader(filePath, chunkBytes, buffers, streamCarryBytes);
+        result = StreamPairs(reader, kernel);
+        result.overlappedFraction = reader.OverlappedFraction();
+        result.readerDescription = "read() on a background thread, " + std::to_string(buffers) + " buffers";
+    }
+    else if (readerName == "uring" || readerName == "pread")
+    {
+        UringReader reader(filePath, chunkBytes, buffers, streamCarryBytes, readerName == "uring");
+        result = StreamPairs(reader, kernel);
+        result.readerDescription = reader.usingUring
+                                       ? "io_uring, queue depth " + std::to_string(buffers) + ", registered buffers"
+                                       : std::string("pread") + (readerName == "uring" ? " (io_uring unavailable)" : "");
+    }
+    else if (readerName == "mmap")
+    {
+        MappedChunkReader reader(filePath);
+        result = StreamPairs(reader, kernel);
+        result.readerDescription = "mmap";
+    }
+    else
+    {
+        throw std::runtime_error("Unknown reader: " + readerName);
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+static void StreamProcess(const std::string &filePath,
+                          size_t chunkBytes,
+                          int bufferCount,
+                          bool cold,
+                          const std::string &readerName)
+{
+    HaversineKernelType kernelType = DetectHaversineKernel();
+    StreamResult result = StreamFile(filePath, readerName, chunkBytes, bufferCount, cold, HaversineKernel(kernelType));
+    RecordRun("stream " + readerName + " " + std::to_string(chunkBytes / 1024) + " KB x" + std::to_string(bufferCount)
+                  + (cold ? " cold " : " warm ") + filePath,
+              result.seconds);
+
+    printf("Kernel: %s\n", HaversineKernelName(kernelType));
+    printf("Reader: %s\n", result.readerDescription.c_str());
+    printf("Chunk: %zu KB, %s\n", chunkBytes / 1024, cold ? "cold" : "warm");
+    printf("Pair count: %zu\n", result.count);
+    printf("Haversine sum: %f\n", result.count ? (result.haversineSum / result.count) : 0.0);
+    printf("Total: %.3f s, %.3f GB/s of input, peak memory %.1f MB\n",
+           result.seconds,
+           result.seconds > 0 ? result.bytesRead / result.seconds / 1e9 : 0.0,
+           PeakMemoryMegabytes());
+    if (result.overlappedFraction >= 0.0)
+    {
+        printf("I/O: %.3f s reading, %.3f s waited for, %.1f%% overlapped with parsing\n",
+               result.ioSeconds,
+               result.waitSeconds,
+               result.overlappedFraction * 100.0);
+    }
+    else
+    {
+        printf("I/O: %.3f s in read calls, %.3f s waited for\n", result.ioSeconds, result.waitSeconds);
+    }
+}
+
+// Streams the same file through every reader, cold and warm, and checks they all produce the same sum.
+static void ReadBench(const std::string &filePath, size_t chunkBytes, int queueDepth)
+{
+    HaversineKernelType kernelType = DetectHaversineKernel();
+    HaversineBatchFunction *kernel = HaversineKernel(kernelType);
+    const char *readerNames[] = {"thread", "uring", "pread", "mmap"};
+
+    printf("Kernel: %s, chunk %zu KB, %d in flight\n", HaversineKernelName(kernelType), chunkBytes / 1024, queueDepth);
+    printf("%-8s %-5s %9s %9s %9s %9s  %s\n", "reader", "cache", "seconds", "GB/s", "read s", "waited s", "details");
+
+    bool haveReference = false;
+    double referenceSum = 0.0;
+    for (bool cold : {true, false})
+    {
+        for (const char *readerName : readerNames)
+        {
+            // The warm runs read the file once first so every reader starts from the same fully cached state
+            if (!cold)
+            {
+                StreamFile(filePath, readerName, chunkBytes, queueDepth, false, kernel);
+            }
+            StreamResult result = StreamFile(filePath, readerName, chunkBytes, queueDepth, cold, kernel);
+            printf("%-8s %-5s %9.3f %9.3f %9.3f %9.3f  %s\n",
+                   readerName,
+                   cold ? "cold" : "warm",
+                   result.seconds,
+                   result.seconds > 0 ? result.bytesRead / result.seconds / 1e9 : 0.0,
+                   result.ioSeconds,
+                   result.waitSeconds,
+                   result.readerDescription.c_str());
+
+            if (!haveReference)
+            {
+                referenceSum = result.haversineSum;
+                haveReference = true;
+            }
+            else if (result.haversineSum != referenceSum)
+            {
+                throw std::runtime_error(std::string("The ") + readerName + " reader produced a different sum");
+            }
+        }
+    }
+}
+
+// The JSON does not record how it was generated, so converted files carry seed 0 and an unknown distribution.
+static void Convert(const std::string &filePath, const std::string &pairFilePath)
+{
+    std::vector<char> fileContent = ReadFile(filePath);
+    PairTable pairs = ParsePairs(fileContent.data(), fileContent.data() + fileContent.size());
+
+    WritePairFile(pairFilePath,
+                  pairs.X0().data(),
+                  pairs.Y0().data(),
+                  pairs.X1().data(),
+                  pairs.Y1().data(),
+                  pairs.Size(),
+                  0,
+                  pairFileDistributionUnknown);
+    printf("Wrote %zu pairs to %s\n", pairs.Size(), pairFilePath.c_str());
+}
+
+// Converts the JSON to a temporary pair file, maps it back and checks every coordinate is bit-identical, then corrupts
+// the pair count and checks the file is refused.
+static void RoundTrip(const std::string &filePath)
+{
+    std::vector<char> fileContent = ReadFile(filePath);
+    PairTable pairs = ParsePairs(fileContent.data(), fileContent.data() + fileContent.size());
+    size_t count = pairs.Size();
+
+    std::string pairFilePath = filePath + ".roundtrip.hvp";
+    WritePairFile(pairFilePath,
+                  pairs.X0().data(),
+                  pairs.Y0().data(),
+                  pairs.X1().data(),
+                  pairs.Y1().data(),
+                  count,
+                  0,
+                  pairFileDistributionUnknown);
+
+    bool passed;
+    {
+        PairFile pairFile(pairFilePath);
+        size_t bytes = count * sizeof(double);
+        passed = pairFile.header.count == count && pairFile.header.seed == 0
+                 && pairFile.header.distribution == pairFileDistributionUnknown && pairFile.VerifyChecksum()
+                 && ((uintptr_t)pairFile.x0 % pairFileAlignment) == 0
+                 && ((uintptr_t)pairFile.y1 % pairFileAlignment) == 0
+                 && memcmp(pairFile.x0, pairs.X0().data(), bytes) == 0
+                 && memcmp(pairFile.y0, pairs.Y0().data(), bytes) == 0
+                 && memcmp(pairFile.x1, pairs.X1().data(), bytes) == 0
+                 && memcmp(pairFile.y1, pairs.Y1().data(), bytes) == 0;
+    }
+
+    // A count that wraps count * sizeof(double) back to the real column size must be rejected, not mapped
+    bool corruptRejected = false;
+    if (passed)
+    {
+        FILE *file = fopen(pairFilePath.c_str(), "r+b");
+        uint64_t corruptCount = count + (1ull << 61);
+        bool patched = file && fseek(file, offsetof(PairFileHeader, count), SEEK_SET) == 0
+                       && fwrite(&corruptCount, sizeof(corruptCount), 1, file) == 1;
+        if (file)
+        {
+            fclose(file);
+        }
+        try
+        {
+            PairFile corrupt(pairFilePath);
+        }
+        catch (const std::runtime_error &)
+        {
+            corruptRejected = patched;
+        }
+    }
+    remove(pairFilePath.c_str());
+
+    if (!passed)
+    {
+        throw std::runtime_error("Round trip through " + pairFilePath + " did not reproduce the JSON pairs");
+    }
+    if (!corruptRejected)
+    {
+        throw std::runtime_error("Pair file with a wrapping pair count was not rejected: " + pairFilePath);
+    }
+    printf("Round trip passed: %zu pairs\n", count);
+}
+
+// Parses and computes the JSON as usual, then compares every distance against the generator's binary answer file. Any
+// distance further than tolerance km from its answer fails the run. The default is haversineKernelTolerance: near
+// antipodes the kernels and libm legitimately differ by more than 1e-6 km.
+static void Validate(const std::string &filePath, const std::string &answerPath, double tolerance)
+{
+    std::vector<char> fileContent = ReadFile(filePath);
+    PairTable pairs = ParsePairs(fileContent.data(), fileContent.data() + fileContent.size());
+
+    std::vector<double> distances;
+    double haversineSum = ComputeDistances(pairs.Batch(), &distances);
+
+    AnswerFile answers(answerPath);
+    printf("Answer file: %llu pairs, seed %lld, distribution %u\n",
+           (unsigned long long)answers.header.count,
+           (long long)answers.header.seed,
+           answers.header.distribution);
+    if (answers.header.count != pairs.Size())
+    {
+        throw std::runtime_error("Pair count " + std::to_string(pairs.Size()) + " does not match the answer file");
+    }
+
+    AnswerComparison comparison = CompareAnswers(distances.data(), answers.distances, pairs.Size(), tolerance);
+    double expectedSum = answers.trailer.referenceSum;
+
+    printf("Max error: %.3e km (pair %zu)\n", comparison.maxError, comparison.maxErrorIndex);
+    if (comparison.firstMismatch == SIZE_MAX)
+    {
+        printf("All %zu distances within %.3e km\n", pairs.Size(), tolerance);
+    }
+    else
+    {
+        size_t i = comparison.firstMismatch;
+        Pair pair = pairs.Get(i);
+        printf("First mismatch: pair %zu (%.17g, %.17g, %.17g, %.17g) computed %.17g, expected %.17g\n",
+               i,
+               pair.x0,
+               pair.y0,
+               pair.x1,
+               pair.y1,
+               distances[i],
+               answers.distances[i]);
+    }
+    // Averages, as the other modes and the generator print them
+    double count = pairs.Size() ? (double)pairs.Size() : 1.0;
+    printf("Haversine sum: %.17g, expected %.17g (difference %.3e)\n",
+           haversineSum / count,
+           expectedSum / count,
+           (haversineSum - expectedSum) / count);
+
+    if (comparison.firstMismatch != SIZE_MAX)
+    {
+        char message[128];
+        snprintf(message, sizeof(message), "Distances differ from the answer file by more than %.3e km", tolerance);
+        throw std::runtime_error(message);
+    }
+}
+
+// Parses every number in the file with ParseDouble and with strtod, reports any result that is not bit-identical and
+// the throughput of both over the number bytes only.
+//
+// The whole-file pass streams a 16-byte span in and an 8-byte result out for every 3-byte number, so it mostly measures
+// memory bandwidth. The per-core figure times the same parses block by block, with each block's spans, text and results
+// brought into cache beforehand, as the processor's chunked reads leave them.
+static void FloatCheck(const std::string &filePath)
+{
+    std::vector<char> fileContent = ReadFile(filePath);
+    fileContent.push_back('\0');
+
+    const char *at = fileContent.data();
+    const char *end = fileContent.data() + fileContent.size() - 1;
+
+    std::vector<NumberSpan> numbers;
+    size_t numberBytes = 0;
+    while (at < end)
+    {
+        bool startsNumber = (*at == '-' || IsDigit(*at)) && (at == fileContent.data() || at[-1] == ' ' || at[-1] == ':');
+        if (!startsNumber)
+        {
+            at++;
+            continue;
+        }
+
+        double value;
+        const char *numberEnd = ParseDouble(at, end, &value);
+        if (!numberEnd)
+        {
+            at++;
+            continue;
+        }
+
+        numbers.push_back({at, numberEnd});
+        numberBytes += numberEnd - at;
+        at = numberEnd;
+    }
+
+    std::vector<double> fast(numbers.size());
+    std::vector<double> reference(numbers.size());
+
+    // Parsed up to the file end, as the processor does, so the short path may load past the number itself
+    auto fastStart = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < numbers.size(); i++)
+    {
+        ParseDouble(numbers[i].start, end, &fast[i]);
+    }
+    auto fastEnd = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < numbers.size(); i++)
+    {
+        reference[i] = strtod(numbers[i].start, nullptr);
+    }
+    auto referenceEnd = std::chrono::steady_clock::now();
+
+    const size_t blockCount = 4096;
+    const int passCount = 5;
+    std::vector<NumberSpan> blockNumbers(blockCount);
+    std::vector<double> blockValues(blockCount);
+    double coreSeconds = 0.0;
+    for (int pass = 0; pass < passCount; pass++)
+    {
+        double passSeconds = 0.0;
+        for (size_t first = 0; first < numbers.size(); first += blockCount)
+        {
+            size_t count = std::min(blockCount, numbers.size() - first);
+            char touched = 0;
+            for (size_t i = 0; i < count; i++)
+            {
+                blockNumbers[i] = numbers[first + i];
+                touched ^= *blockNumbers[i].start;
+                blockValues[i] = touched;
+            }
+
+            auto blockStart = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < count; i++)
+            {
+                ParseDouble(blockNumbers[i].start, end, &blockValues[i]);
+            }
+            passSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - blockStart).count();
+
+            if (memcmp(blockValues.data(), &fast[first], count * sizeof(double)) != 0)
+            {
+                throw std::runtime_error("ParseDouble gave different results on a second parse");
+            }
+        }
+        coreSeconds = pass == 0 || passSeconds < coreSeconds ? passSeconds : coreSeconds;
+    }
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < numbers.size(); i++)
+    {
+        if (memcmp(&fast[i], &reference[i], sizeof(double)) != 0)
+        {
+            if (mismatches < 10)
+            {
+                printf("Mismatch: %.*s -> %.17g (strtod %.17g)\n",
+                       (int)(numbers[i].end - numbers[i].start),
+                       numbers[i].start,
+                       fast[i],
+                       reference[i]);
+            }
+            mismatches++;
+        }
+    }
+
+    double fastSeconds = std::chrono::duration<double>(fastEnd - fastStart).count();
+    double referenceSeconds = std::chrono::duration<double>(referenceEnd - fastEnd).count();
+
+    printf("Numbers: %zu (%zu bytes)\n", numbers.size(), numberBytes);
+    printf("Mismatches: %zu\n", mismatches);
+    printf("ParseDouble: %.3f GB/s\n", fastSeconds > 0 ? numberBytes / fastSeconds / 1e9 : 0.0);
+    printf("ParseDouble per core: %.3f GB/s, %.2f ns per number (best of %d passes, blocks of %zu numbers in cache)\n",
+           coreSeconds > 0 ? numberBytes / coreSeconds / 1e9 : 0.0,
+           numbers.empty() ? 0.0 : coreSeconds / numbers.size() * 1e9,
+           passCount,
+           blockCount);
+    printf("strtod: %.3f GB/s\n", referenceSeconds > 0 ? numberBytes / referenceSeconds / 1e9 : 0.0);
+}
+
+struct KernelErrors
+{
+    double maxAbsolute = 0.0;
+    double maxRelative = 0.0;
+    size_t worstPair = 0;
+};
+
+// Relative errors only count distances of at least relativeFloor km: a pair that names one point in two ways (latitudes
+// 180 degrees apart and longitudes 180 apart) reaches a = 0 by cancellation, and its rounding error is a large fraction
+// of a distance that is itself about 1e-4 km.
+static KernelErrors MeasureKernelErrors(const std::vector<double> &distances, const std::vector<double> &reference,
+                                        double relativeFloor)
+{
+    KernelErrors errors;
+    for (size_t i = 0; i < reference.size(); i++)
+    {
+        // libm can round a slightly outside [0, 1] and return NaN, the kernels clamp instead
+        if (reference[i] != reference[i])
+        {
+            continue;
+        }
+
+        double absolute = fabs(distances[i] - reference[i]);
+        if (absolute > errors.maxAbsolute)
+        {
+            errors.maxAbsolute = absolute;
+            errors.worstPair = i;
+        }
+        if (reference[i] >= relativeFloor)
+        {
+            double relative = absolute / reference[i];
+            errors.maxRelative = relative > errors.maxRelative ? relative : errors.maxRelative;
+        }
+    }
+    return errors;
+}
+
+// Pairs as haversine_input writes them: whole degrees, half of them from the shifted range x in [-270, 90], y in
+// [-135, 45] and half from x in [-180, 180], y in [-90, 90]. Every fourth pair is made exactly antipodal and every
+// fourth coincident, since the generator writes plenty of both and a random lattice draw hits few.
+static PairTable MakeLatticePairs(size_t count)
+{
+    std::mt19937_64 random(1001);
+    PairTable pairs(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        int xMin = i < count / 2 ? -270 : -180;
+        int yMin = i < count / 2 ? -135 : -90;
+        std::uniform_int_distribution<int> randomX(xMin, xMin + 360);
+        std::uniform_int_distribution<int> randomY(yMin, yMin + 180);
+
+        Pair pair;
+        pair.x0 = randomX(random);
+        pair.y0 = randomY(random);
+        pair.x1 = randomX(random);
+        pair.y1 = randomY(random);
+        if (i % 4 == 1)
+        {
+            // y0 is drawn where -y0 is in range too
+            int yBound = yMin + 180 < -yMin ? yMin + 180 : -yMin;
+            pair.y0 = std::uniform_int_distribution<int>(-yBound, yBound)(random);
+            pair.y1 = -pair.y0;
+            pair.x1 = pair.x0 + 180 <= xMin + 360 ? pair.x0 + 180 : pair.x0 - 180;
+        }
+        else if (i % 4 == 2)
+        {
+            pair.x1 = pair.x0;
+            pair.y1 = pair.y0;
+        }
+        pairs.Append(pair);
+    }
+    return pairs;
+}
+
+// Runs every kernel this CPU supports and reports the worst error against ReferenceHaversine on two sample sets, along
+// with the best-of-N cycles per pair:
+//
+//   continuous  uniform real coordinates over the whole range the generator covers, which is what the timing uses
+//   lattice     the generator's actual output (see MakeLatticePairs), antipodal and coincident pairs included
+//
+// Near antipodes the distance is ill-conditioned rather than the kernels inaccurate: with a = 1 - e, asin(sqrt(a)) is
+// about pi/2 - sqrt(e), so a rounding a single ulp (1.1e-16) differently from libm moves the distance by
+// 2 * earthRadius * sqrt(1.1e-16), about 1.3e-4 km. The same happens at a = 0 when it is reached by cancellation. The
+// lattice set hits both exactly; its error is bounded by haversineKernelTolerance, not by how close the polynomials
+// are, and relative errors are only taken over distances of at least 1 km.
+static void KernelReport(size_t count)
+{
+    std::mt19937_64 random(1000);
+    std::uniform_real_distribution<double> randomX(-270.0, 180.0);
+    std::uniform_real_distribution<double> randomY(-135.0, 90.0);
+
+    PairTable pairs(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        Pair pair;
+        pair.x0 = randomX(random);
+        pair.y0 = randomY(random);
+        pair.x1 = randomX(random);
+        pair.y1 = randomY(random);
+        pairs.Append(pair);
+    }
+    std::span<const double> x0 = pairs.X0();
+    std::span<const double> y0 = pairs.Y0();
+    std::span<const double> x1 = pairs.X1();
+    std::span<const double> y1 = pairs.Y1();
+
+    const int repetitions = 5;
+    std::vector<double> reference(count);
+    uint64_t referenceCycles = UINT64_MAX;
+    for (int repetition = 0; repetition < repetitions; repetition++)
+    {
+        uint64_t start = ReadTimestampCounterBegin();
+        for (size_t i = 0; i < count; i++)
+        {
+            reference[i] = ReferenceHaversine(x0[i], y0[i], x1[i], y1[i], earthRadius);
+        }
+        uint64_t elapsed = ReadTimestampCounterEnd() - start;
+        referenceCycles = elapsed < referenceCycles ? elapsed : referenceCycles;
+    }
+
+    PairTable latticePairs = MakeLatticePairs(count);
+    std::vector<double> latticeReference(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        Pair pair = latticePairs.Get(i);
+        latticeReference[i] = ReferenceHaversine(pair.x0, pair.y0, pair.x1, pair.y1, earthRadius);
+    }
+
+    printf("Pairs: %zu per sample set\n", count);
+    printf("Continuous: x in [-270, 180], y in [-135, 90]\n");
+    printf("Lattice: whole degrees as the generator writes them, 1 in 4 antipodal, 1 in 4 coincident\n");
+    printf("Relative errors over distances of at least 1 km\n\n");
+    printf("%-12s %26s %26s %14s %10s\n", "", "Continuous", "Lattice", "", "");
+    printf("%-12s %12s %13s %12s %13s %14s %10s\n",
+           "Kernel",
+           "Max abs (km)",
+           "Max relative",
+           "Max abs (km)",
+           "Max relative",
+           "Cycles/pair",
+           "Speedup");
+    printf("%-12s %12s %13s %12s %13s %14.2f %9.2fx\n",
+           "Reference",
+           "-",
+           "-",
+           "-",
+           "-",
+           count ? (double)referenceCycles / count : 0.0,
+           1.0);
+
+    HaversineKernelType detected = DetectHaversineKernel();
+    HaversineKernelType kernelTypes[] = {HaversineKernelType::Scalar,
+                                         HaversineKernelType::Avx2,
+                                         HaversineKernelType::Avx512};
+    const double relativeFloor = 1.0;
+    std::vector<double> distances(count);
+    double worstLatticeError = 0.0;
+    Pair worstLatticePair = {};
+    for (HaversineKernelType kernelType : kernelTypes)
+    {
+        if ((int)kernelType > (int)detected)
+        {
+            continue;
+        }
+
+        HaversineBatchFunction *kernel = HaversineKernel(kernelType);
+        uint64_t kernelCycles = UINT64_MAX;
+        for (int repetition = 0; repetition < repetitions; repetition++)
+        {
+            uint64_t start = ReadTimestampCounterBegin();
+            ComputeBatch(kernel, pairs.Batch(), distances);
+            uint64_t elapsed = ReadTimestampCounterEnd() - start;
+            kernelCycles = elapsed < kernelCycles ? elapsed : kernelCycles;
+        }
+        KernelErrors continuous = MeasureKernelErrors(distances, reference, relativeFloor);
+
+        ComputeBatch(kernel, latticePairs.Batch(), distances);
+        KernelErrors lattice = MeasureKernelErrors(distances, latticeReference, relativeFloor);
+        if (lattice.maxAbsolute > worstLatticeError)
+        {
+            worstLatticeError = lattice.maxAbsolute;
+            worstLatticePair = latticePairs.Get(lattice.worstPair);
+        }
+
+        printf("%-12s %12.3e %13.3e %12.3e %13.3e %14.2f %9.2fx\n",
+               HaversineKernelName(kernelType),
+               continuous.maxAbsolute,
+               continuous.maxRelative,
+               lattice.maxAbsolute,
+               lattice.maxRelative,
+               count ? (double)kernelCycles / count : 0.0,
+               kernelCycles ? (double)referenceCycles / kernelCycles : 0.0);
+    }
+
+    if (worstLatticeError > 0.0)
+    {
+        printf("\nWorst lattice pair: (%g, %g, %g, %g)\n",
+               worstLatticePair.x0,
+               worstLatticePair.y0,
+               worstLatticePair.x1,
+               worstLatticePair.y1);
+    }
+    printf("Near antipodes and a = 0 the error is bounded by conditioning, not by the kernels: one ulp of a is about "
+           "%.1e km. validate accepts %.0e km.\n",
+           2.0 * earthRadius * sqrt(0x1p-53),
+           haversineKernelTolerance);
+}
+
+// Allocates the coordinate columns in every allocation mode and reports where the page faults land: up front while
+// prefaulting, while the columns are first written, or in the kernel pass that reads them back.
+static void AllocBench(size_t count)
+{
+    HaversineKernelType kernelType = DetectHaversineKernel();
+    HaversineBatchFunction *kernel = HaversineKernel(kernelType);
+
+    // Faulted in before any measurement so only the coordinate columns are counted
+    std::vector<double> distances(count);
+
+    printf("Pairs: %zu (%.1f MB of coordinates), kernel %s\n",
+           count,
+           count * sizeof(Pair) / (1024.0 * 1024.0),
+           HaversineKernelName(kernelType));
+    printf("%-18s %-18s %10s %9s %10s %9s %10s %9s\n",
+           "Requested",
+           "In effect",
+           "Prefault s",
+           "faults",
+           "Fill s",
+           "faults",
+           "Kernel s",
+           "faults");
+
+    for (PageMode pages : {PageMode::Normal, PageMode::TransparentHuge, PageMode::HugeTlb})
+    {
+        for (PrefaultMode prefault : {PrefaultMode::None, PrefaultMode::Populate, PrefaultMode::FirstTouch})
+        {
+            AllocationMode requested = {pages, prefault};
+            PairTable pairs(count, requested);
+
+            auto fillStart = std::chrono::steady_clock::now();
+            PageFaultCount fillBefore = ReadPageFaults();
+            for (size_t i = 0; i < count; i++)
+            {
+                double t = (double)(i % 3600) * 0.1;
+                pairs.Append({t - 180.0, t * 0.25 - 45.0, 180.0 - t, 45.0 - t * 0.25});
+            }
+            PageFaultCount fillAfter = ReadPageFaults();
+            double fillSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - fillStart).count();
+
+            auto kernelStart = std::chrono::steady_clock::now();
+            ComputeBatch(kernel, pairs.Batch(), distances);
+            PageFaultCount kernelAfter = ReadPageFaults();
+            double kernelSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - kernelStart).count();
+
+            const Arena &memory = pairs.Memory();
+            printf("%-18s %-18s %10.4f %9ld %10.4f %9ld %10.4f %9ld\n",
+                   AllocationModeName(requested).c_str(),
+                   AllocationModeName(memory.mode).c_str(),
+                   memory.prefaultSeconds,
+                   memory.prefaultFaults.minor + memory.prefaultFaults.major,
+                   fillSeconds,
+                   (fillAfter.minor - fillBefore.minor) + (fillAfter.major - fillBefore.major),
+                   kernelSeconds,
+                   (kernelAfter.minor - fillAfter.minor) + (kernelAfter.major - fillAfter.major));
+        }
+    }
+}
+
+static const char *SkipWhiteSpace(const char *at, const char *end)
+{
+    while (at < end && (*at == ' ' || *at == '\n' || *at == '\r' || *at == '\t'))
+    {
+        at++;
+    }
+    return at;
+}
+
+static const char *Expect(const char *at, const char *end, char expected)
+{
+    at = SkipWhiteSpace(at, end);
+    if (at == end || *at != expected)
+    {
+        throw std::runtime_error(std::string("Malformed JSON, expected '") + expected + "'");
+    }
+    return at + 1;
+}
+
+// Returns a pointer just past the '[' opening the "pairs" array, or nullptr if the key is not in [at, end).
+static const char *FindPairsArray(const char *at, const char *end)
+{
+    const char *pairsKey = "\"pairs\"";
+    const char *found = std::search(at, end, pairsKey, pairsKey + strlen(pairsKey));
+    if (found == end)
+    {
+        return nullptr;
+    }
+
+    at = Expect(found + strlen(pairsKey), end, ':');
+    return Expect(at, end, '[');
+}
+
+// Parses one { "x0": ..., "y0": ..., "x1": ..., "y1": ... } object, keys in any order. Returns a pointer past its '}'.
+// All four keys are required, which is also what lets ParsePairs bound the pair count by the shortest such object.
+static const char *ParsePairObject(const char *at, const char *end, Pair *pair)
+{
+    at = Expect(at, end, '{');
+
+    *pair = {};
+    unsigned keysSeen = 0;
+    while (true)
+    {
+        at = Expect(at, end, '"');
+        const char *keyStart = at;
+        while (at < end && *at != '"')
+        {
+            at++;
+        }
+        size_t keyLength = at - keyStart;
+        at = Expect(at, end, '"');
+        at = Expect(at, end, ':');
+        at = SkipWhiteSpace(at, end);
+
+        double value;
+        at = ParseDouble(at, end, &value);
+        if (!at)
+        {
+            throw std::runtime_error("Malformed JSON, expected a number");
+        }
+
+        if (keyLength == 2)
+        {
+            if (keyStart[0] == 'x' && keyStart[1] == '0')
+            {
+                pair->x0 = value;
+                keysSeen |= 1;
+            }
+            else if (keyStart[0] == 'y' && keyStart[1] == '0')
+            {
+                pair->y0 = value;
+                keysSeen |= 2;
+            }
+            else if (keyStart[0] == 'x' && keyStart[1] == '1')
+            {
+                pair->x1 = value;
+                keysSeen |= 4;
+            }
+            else if (keyStart[0] == 'y' && keyStart[1] == '1')
+            {
+                pair->y1 = value;
+                keysSeen |= 8;
+            }
+        }
+
+        at = SkipWhiteSpace(at, end);
+        if (at < end && *at == ',')
+        {
+            at++;
+            continue;
+        }
+        at = Expect(at, end, '}');
+        if (keysSeen != 15)
+        {
+            throw std::runtime_error("Malformed JSON, pair object is missing one of x0, y0, x1, y1");
+        }
+        return at;
+    }
+}
+
+// Parses the { "pairs": [ { "x0": ..., "y0": ..., "x1": ..., "y1": ... }, ... ] } layout written by the generators.
+static PairTable ParsePairs(const char *at, const char *end)
+{
+    at = FindPairsArray(at, end);
+    if (!at)
+    {
+        throw std::runtime_error("Malformed JSON, no \"pairs\" array");
+    }
+
+    // The shortest valid pair object, {"x0":0,"y0":0,"x1":0,"y1":0}, bounds the pair count from above. The table
+    // only touches the pages it fills, so over-reserving costs address space and nothing else.
+    PairTable pairs((end - at) / 29 + 1, {PageMode::TransparentHuge, PrefaultMode::None});
+    at = SkipWhiteSpace(at, end);
+    if (at < end && *at == ']')
+    {
+        return pairs;
+    }
+
+    while (true)
+    {
+        Pair pair;
+        at = ParsePairObject(at, end, &pair);
+        pairs.Append(pair);
+
+        at = SkipWhiteSpace(at, end);
+        if (at < end && *at == ',')
+        {
+            at++;
+            continue;
+        }
+        Expect(at, end, ']');
+        break;
+    }
+
+    return pairs;
+}
+
+// A whole run is one repetition: bench_compare pools every run of a benchmark at a revision, so recording several runs
+// per revision gives it a sample to compare, as a repetition-tester wave would.
+static void RecordRun(const std::string &benchmark, double seconds)
+{
+    uint64_t cpuTimerFreq = EstimateCpuTimerFreq();
+    std::vector<uint64_t> samples = {(uint64_t)(seconds * (double)cpuTimerFreq)};
+    AppendBenchmarkResult(std::string(program_invocation_short_name) + "/" + benchmark, samples, {}, cpuTimerFreq);
+}
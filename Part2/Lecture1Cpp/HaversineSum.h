@@ -0,0 +1,114 @@
+#pragma once
+
+// Deterministic parallel Haversine summation.
+//
+// Pairs are split into fixed-size blocks. Each block is summed with Kahan summation, and the block sums are combined
+// pairwise in a shape that only depends on the number of blocks. Threads only decide who computes which block, never
+// the order of any addition, so the total is bit-identical for every thread count.
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+static const size_t sumBlockPairs = 4096;
+
+static double KahanSum(const double *values, size_t count)
+{
+    double sum = 0.0;
+    double compensation = 0.0;
+    for (size_t i = 0; i < count; i++)
+    {
+        double y = values[i] - compensation;
+        double t = sum + y;
+        compensation = (t - sum) - y;
+        sum = t;
+    }
+    return sum;
+}
+
+// Pairwise reduction fed one block sum at a time, like a binary counter: levels[k] holds the sum of 2^k consecutive
+// blocks. Feeding the same block sums in the same order always builds the same tree, whether they arrive from a
+// finished parallel pass or one at a time from a stream.
+struct BlockSumReducer
+{
+    double levels[64] = {};
+    bool used[64] = {};
+
+    void Add(double blockSum)
+    {
+        int level = 0;
+        while (used[level])
+        {
+            blockSum = levels[level] + blockSum;
+            used[level] = false;
+            level++;
+        }
+        levels[level] = blockSum;
+        used[level] = true;
+    }
+
+    double Total() const
+    {
+        double total = 0.0;
+        for (int level = 0; level < 64; level++)
+        {
+            if (used[level])
+            {
+                total = levels[level] + total;
+            }
+        }
+        return total;
+    }
+};
+
+static int DefaultThreadCount()
+{
+    unsigned int threadCount = std::thread::hardware_concurrency();
+    return threadCount ? (int)threadCount : 1;
+}
+
+// Calls computeRange(begin, end) to fill distances[begin, end) for every block, spread over threadCount threads, and
+// returns the deterministic sum of all distances.
+template <typename ComputeRange>
+static double ParallelHaversineSum(size_t count, int threadCount, double *distances, ComputeRange computeRange)
+{
+    size_t blockCount = (count + sumBlockPairs - 1) / sumBlockPairs;
+    std::vector<double> blockSums(blockCount);
+
+    if (threadCount < 1)
+    {
+        threadCount = 1;
+    }
+    if ((size_t)threadCount > blockCount)
+    {
+        threadCount = blockCount ? (int)blockCount : 1;
+    }
+
+    auto sumBlocks = [&](size_t firstBlock, size_t lastBlock) {
+        for (size_t block = firstBlock; block < lastBlock; block++)
+        {
+            size_t begin = block * sumBlockPairs;
+            size_t end = begin + sumBlockPairs < count ? begin + sumBlockPairs : count;
+            computeRange(begin, end);
+            blockSums[block] = KahanSum(distances + begin, end - begin);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int thread = 1; thread < threadCount; thread++)
+    {
+        threads.emplace_back(sumBlocks, blockCount * thread / threadCount, blockCount * (thread + 1) / threadCount);
+    }
+    sumBlocks(0, blockCount / threadCount);
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    BlockSumReducer reducer;
+    for (size_t block = 0; block < blockCount; block++)
+    {
+        reducer.Add(blockSums[block]);
+    }
+    return reducer.Total();
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+// Read-only memory mapping of a whole file. The mapping lives as long as the MappedFile.
+
+#include <cstddef>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct MappedFile
+{
+    const char *data = nullptr;
+    size_t size = 0;
+
+    MappedFile(const std::string &filePath)
+    {
+        int fd = open(filePath.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Unable to open file: " + filePath);
+        }
+
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) != 0)
+        {
+            close(fd);
+            throw std::runtime_error("Unable to stat file: " + filePath);
+        }
+        size = (size_t)fileStat.st_size;
+
+        if (size > 0)
+        {
+            void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED)
+            {
+                close(fd);
+                throw std::runtime_error("Unable to map file: " + filePath);
+            }
+            data = (const char *)mapping;
+        }
+        close(fd);
+    }
+
+    ~MappedFile()
+    {
+        if (data)
+        {
+            munmap((void *)data, size);
+        }
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+};
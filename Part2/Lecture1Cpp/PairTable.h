@@ -0,0 +1,160 @@
+#pragma once
+
+// Structure-of-arrays coordinate storage. The four columns are carved out of one arena sized for the full pair count,
+// so filling the table never reallocates or copies, and each column starts on a 64-byte boundary for the vector
+// kernels.
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include "Arena.h"
+#include "Haversine.h"
+#include "HaversineKernel.h"
+
+static const size_t pairTableAlignment = 64;
+
+// A contiguous range of pairs, one span per column. All four spans have the same size.
+struct PairBatch
+{
+    std::span<const double> x0;
+    std::span<const double> y0;
+    std::span<const double> x1;
+    std::span<const double> y1;
+
+    size_t size() const
+    {
+        return x0.size();
+    }
+
+    // Pairs [begin, end). Unlike std::span::subspan, which takes an offset and a count.
+    PairBatch Slice(size_t begin, size_t end) const
+    {
+        return {x0.subspan(begin, end - begin),
+                y0.subspan(begin, end - begin),
+                x1.subspan(begin, end - begin),
+                y1.subspan(begin, end - begin)};
+    }
+};
+
+static inline PairBatch MakePairBatch(const double *x0, const double *y0, const double *x1, const double *y1,
+                                      size_t count)
+{
+    return {{x0, count}, {y0, count}, {x1, count}, {y1, count}};
+}
+
+// Runs a batch kernel over every pair of batch, writing one distance per pair.
+static inline void ComputeBatch(HaversineBatchFunction *kernel, const PairBatch &batch, std::span<double> distances)
+{
+    if (distances.size() < batch.size())
+    {
+        throw std::runtime_error("Distance span is smaller than the pair batch");
+    }
+    kernel(batch.x0.data(), batch.y0.data(), batch.x1.data(), batch.y1.data(), distances.data(), batch.size());
+}
+
+class PairTable
+{
+private:
+    Arena arena;
+    size_t capacity;
+    size_t count = 0;
+    double *x0;
+    double *y0;
+    double *x1;
+    double *y1;
+
+    // A negative count converted to size_t lands here, and would otherwise wrap the arena size
+    static size_t CheckedCapacity(size_t capacity)
+    {
+        if (capacity > SIZE_MAX / (8 * sizeof(double)))
+        {
+            throw std::runtime_error("Pair count is too large: " + std::to_string(capacity));
+        }
+        return capacity;
+    }
+
+    static size_t ColumnBytes(size_t capacity)
+    {
+        return (capacity * sizeof(double) + pairTableAlignment - 1) & ~(pairTableAlignment - 1);
+    }
+
+public:
+    PairTable(size_t capacity, AllocationMode mode = {})
+        : arena(4 * ColumnBytes(CheckedCapacity(capacity)) + pairTableAlignment, mode), capacity(capacity)
+    {
+        x0 = (double *)arena.Allocate(ColumnBytes(capacity), pairTableAlignment);
+        y0 = (double *)arena.Allocate(ColumnBytes(capacity), pairTableAlignment);
+        x1 = (double *)arena.Allocate(ColumnBytes(capacity), pairTableAlignment);
+        y1 = (double *)arena.Allocate(ColumnBytes(capacity), pairTableAlignment);
+    }
+
+    PairTable(PairTable &&) = default;
+    PairTable(const PairTable &) = delete;
+    PairTable &operator=(const PairTable &) = delete;
+
+    size_t Size() const
+    {
+        return count;
+    }
+
+    size_t Capacity() const
+    {
+        return capacity;
+    }
+
+    // The allocation mode in effect and what pre-faulting the columns cost
+    const Arena &Memory() const
+    {
+        return arena;
+    }
+
+    void Append(const Pair &pair)
+    {
+        if (count == capacity)
+        {
+            throw std::runtime_error("Pair table is full");
+        }
+        x0[count] = pair.x0;
+        y0[count] = pair.y0;
+        x1[count] = pair.x1;
+        y1[count] = pair.y1;
+        count++;
+    }
+
+    Pair Get(size_t index) const
+    {
+        return {x0[index], y0[index], x1[index], y1[index]};
+    }
+
+    std::span<const double> X0() const
+    {
+        return {x0, count};
+    }
+
+    std::span<const double> Y0() const
+    {
+        return {y0, count};
+    }
+
+    std::span<const double> X1() const
+    {
+        return {x1, count};
+    }
+
+    std::span<const double> Y1() const
+    {
+        return {y1, count};
+    }
+
+    PairBatch Batch() const
+    {
+        return {X0(), Y0(), X1(), Y1()};
+    }
+
+    PairBatch Batch(size_t begin, size_t end) const
+    {
+        return Batch().Slice(begin, end);
+    }
+};
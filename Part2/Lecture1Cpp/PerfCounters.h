@@ -0,0 +1,348 @@
+#pragma once
+
+// Per-thread hardware and software event counters through perf_event_open.
+//
+// All events are opened as one group, so the kernel always schedules them onto the PMU together and their counts cover
+// exactly the same instructions. When the kernel allows it (cap_user_rdpmc on the mmapped control page of every
+// hardware event), the hardware counters are read with rdpmc in user space, a few tens of cycles each, and only the
+// page-fault count, which has no PMU index, costs a read(). Otherwise one read() of the group leader
+// (PERF_FORMAT_GROUP) returns every count in the same snapshot.
+//
+// With more events than the PMU has counters, the kernel multiplexes groups and a group only counts part of the time.
+// Every count is then scaled up by time enabled over time running, as perf stat does, so zones stay comparable; the
+// counts become estimates.
+//
+// Everything counts user space only (exclude_kernel), which is what perf_event_paranoid=2 still permits. An event that
+// cannot be opened (paranoid 3, no PMU in a VM, seccomp) is simply reported as unavailable.
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+enum PerfEvent
+{
+    PerfEventCycles,
+    PerfEventInstructions,
+    PerfEventCacheMisses,
+    PerfEventBranchMisses,
+    PerfEventPageFaults,
+
+    perfEventCount
+};
+
+struct PerfEventValues
+{
+    uint64_t values[perfEventCount];
+};
+
+static inline const char *PerfEventName(int event)
+{
+    switch (event)
+    {
+        case PerfEventCycles:
+            return "cycles";
+        case PerfEventInstructions:
+            return "instructions";
+        case PerfEventCacheMisses:
+            return "cache-misses";
+        case PerfEventBranchMisses:
+            return "branch-misses";
+        case PerfEventPageFaults:
+            return "page-faults";
+    }
+    return "unknown";
+}
+
+class PerfCounters
+{
+private:
+    int fds[perfEventCount];
+    perf_event_mmap_page *pages[perfEventCount];
+    int openErrors[perfEventCount];
+    int groupSlots[perfEventCount]; // position in the group read, -1 when not open
+    int leader = -1;
+    int groupSize = 0;
+    bool opened = false;
+
+    static const uint64_t groupReadFormat =
+        PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // { nr, time enabled, time running, value[nr] }
+    struct GroupRead
+    {
+        uint64_t count;
+        uint64_t timeEnabled;
+        uint64_t timeRunning;
+        uint64_t values[perfEventCount];
+    };
+
+    static int OpenEvent(uint32_t type, uint64_t config, int groupFd, uint64_t readFormat)
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = readFormat;
+        return (int)syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0);
+    }
+
+    static uint64_t Scale(uint64_t count, uint64_t timeEnabled, uint64_t timeRunning)
+    {
+        if (timeRunning == 0 || timeRunning >= timeEnabled)
+        {
+            return count;
+        }
+        return (uint64_t)((double)count * (double)timeEnabled / (double)timeRunning);
+    }
+
+    // Seqlock read of the control page: retried if the kernel rescheduled the counter in between. The enabled and
+    // running times are brought up to now from the TSC the way the perf_event_mmap_page documentation describes, so
+    // the count can be scaled exactly like a group read's.
+    static bool ReadRdpmc(perf_event_mmap_page *page, uint64_t *value)
+    {
+        uint32_t sequence;
+        uint64_t count, timeEnabled, timeRunning, cycles = 0;
+        uint64_t timeOffset = 0;
+        uint32_t timeMultiplier = 0;
+        uint16_t timeShift = 0;
+        bool extendTimes;
+        do
+        {
+            sequence = page->lock;
+            __atomic_signal_fence(__ATOMIC_SEQ_CST);
+            uint32_t index = page->index;
+            if (!page->cap_user_rdpmc || index == 0)
+            {
+                return false;
+            }
+
+            timeEnabled = page->time_enabled;
+            timeRunning = page->time_running;
+            extendTimes = page->cap_user_time && timeEnabled != timeRunning;
+            if (extendTimes)
+            {
+                cycles = __rdtsc();
+                timeOffset = page->time_offset;
+                timeMultiplier = page->time_mult;
+                timeShift = page->time_shift;
+            }
+
+            int64_t raw = (int64_t)__rdpmc((int)index - 1);
+            unsigned shift = 64 - page->pmc_width;
+            raw = (raw << shift) >> shift;
+            count = page->offset + raw;
+            __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        } while (page->lock != sequence);
+
+        if (extendTimes)
+        {
+            uint64_t quotient = cycles >> timeShift;
+            uint64_t remainder = cycles & (((uint64_t)1 << timeShift) - 1);
+            uint64_t delta = timeOffset + quotient * timeMultiplier + ((remainder * timeMultiplier) >> timeShift);
+            timeEnabled += delta;
+            timeRunning += delta;
+        }
+        *value = Scale(count, timeEnabled, timeRunning);
+        return true;
+    }
+
+    bool ReadHardwareRdpmc(PerfEventValues *result) const
+    {
+        bool any = false;
+        for (int event = PerfEventCycles; event <= PerfEventBranchMisses; event++)
+        {
+            if (fds[event] < 0)
+            {
+                continue;
+            }
+            if (!pages[event] || !ReadRdpmc(pages[event], &result->values[event]))
+            {
+                return false;
+            }
+            any = true;
+        }
+        return any;
+    }
+
+public:
+    PerfCounters()
+    {
+        for (int event = 0; event < perfEventCount; event++)
+        {
+            fds[event] = -1;
+            pages[event] = nullptr;
+            openErrors[event] = 0;
+            groupSlots[event] = -1;
+        }
+    }
+
+    ~PerfCounters()
+    {
+        Close();
+    }
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    // Counts the calling thread from now on. Returns true if at least one event could be opened.
+    bool Open()
+    {
+        Close();
+
+        static const uint64_t hardwareConfigs[] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES,
+        };
+
+        // Only the leader is read as a group, so the page-fault event can still be read on its own next to rdpmc
+        for (int event = PerfEventCycles; event <= PerfEventBranchMisses; event++)
+        {
+            uint64_t readFormat = leader < 0 ? groupReadFormat : 0;
+            fds[event] = OpenEvent(PERF_TYPE_HARDWARE, hardwareConfigs[event], leader, readFormat);
+            if (fds[event] < 0)
+            {
+                openErrors[event] = errno;
+                continue;
+            }
+            if (leader < 0)
+            {
+                leader = fds[event];
+            }
+            groupSlots[event] = groupSize++;
+
+            void *page = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fds[event], 0);
+            pages[event] = page == MAP_FAILED ? nullptr : (perf_event_mmap_page *)page;
+        }
+
+        // A software event in a hardware group is scheduled, and multiplexed, with it, so it carries its own times for
+        // when it is read alone. Without a PMU it leads a group of its own.
+        uint64_t faultReadFormat =
+            leader < 0 ? groupReadFormat : PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fds[PerfEventPageFaults] = OpenEvent(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, leader, faultReadFormat);
+        if (fds[PerfEventPageFaults] < 0)
+        {
+            openErrors[PerfEventPageFaults] = errno;
+        }
+        else
+        {
+            if (leader < 0)
+            {
+                leader = fds[PerfEventPageFaults];
+            }
+            groupSlots[PerfEventPageFaults] = groupSize++;
+        }
+
+        opened = true;
+        for (int event = 0; event < perfEventCount; event++)
+        {
+            if (fds[event] >= 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Close()
+    {
+        for (int event = 0; event < perfEventCount; event++)
+        {
+            if (pages[event])
+            {
+                munmap(pages[event], sysconf(_SC_PAGESIZE));
+                pages[event] = nullptr;
+            }
+            if (fds[event] >= 0)
+            {
+                close(fds[event]);
+                fds[event] = -1;
+            }
+            groupSlots[event] = -1;
+        }
+        leader = -1;
+        groupSize = 0;
+        opened = false;
+    }
+
+    bool Available(int event) const
+    {
+        return fds[event] >= 0;
+    }
+
+    // Unavailable events read as 0. At most one syscall: the page-fault count next to rdpmc, or the group read.
+    void Read(PerfEventValues *result) const
+    {
+        memset(result->values, 0, sizeof(result->values));
+        if (leader < 0)
+        {
+            return;
+        }
+
+        if (ReadHardwareRdpmc(result))
+        {
+            // { value, time enabled, time running }
+            int faults = fds[PerfEventPageFaults];
+            uint64_t value[3];
+            if (faults >= 0 && read(faults, value, sizeof(value)) == sizeof(value))
+            {
+                result->values[PerfEventPageFaults] = Scale(value[0], value[1], value[2]);
+            }
+            return;
+        }
+
+        GroupRead group;
+        size_t bytes = sizeof(uint64_t) * (3 + groupSize);
+        if (read(leader, &group, bytes) != (ssize_t)bytes || group.count != (uint64_t)groupSize)
+        {
+            memset(result->values, 0, sizeof(result->values));
+            return;
+        }
+        for (int event = 0; event < perfEventCount; event++)
+        {
+            if (groupSlots[event] >= 0)
+            {
+                result->values[event] = Scale(group.values[groupSlots[event]], group.timeEnabled, group.timeRunning);
+            }
+        }
+    }
+
+    // How an event is read, or why it is not: "rdpmc", "read()", "not permitted (perf_event_paranoid)", ...
+    const char *Status(int event) const
+    {
+        if (!opened)
+        {
+            return "not opened";
+        }
+        if (fds[event] >= 0)
+        {
+            PerfEventValues values;
+            if (!ReadHardwareRdpmc(&values))
+            {
+                return "group read()";
+            }
+            return event == PerfEventPageFaults ? "read()" : "rdpmc";
+        }
+        switch (openErrors[event])
+        {
+            case EACCES:
+            case EPERM:
+                return "not permitted (perf_event_paranoid)";
+            case ENOENT:
+            case EOPNOTSUPP:
+                return "not supported (no PMU?)";
+            case ENOSYS:
+                return "perf_event_open unavailable";
+        }
+        return strerror(openErrors[event]);
+    }
+};
@@ -0,0 +1,784 @@
+#pragma once
+
+// Hierarchical RDTSC profiler.
+//
+// Every TimeBlock gets its own slot in a fixed anchor table, numbered at compile time with __COUNTER__, so entering a
+// zone is two stores and a timestamp read with no lookup. A zone's elapsed cycles are added to its own exclusive time
+// and subtracted from the exclusive time of the zone it is nested in, so exclusive times add up to the total.
+// Inclusive time is restored from the value saved on entry before the elapsed time is added, so a zone that recurses
+// into itself is only counted once, by its outermost entry.
+//
+// Zones read the fenced ReadTimestampCounterBeginCpu/EndCpu, so out-of-order execution cannot move the timestamps into or
+// out of the zone. The cost of one begin/end pair, measured by BeginProfile, is taken off every zone's elapsed time and
+// reported on its own line; the parent is still charged the full raw time, so the timer cost of a nested zone is not
+// misattributed to the code around it.
+//
+//   BeginProfile();
+//   {
+//       TimeBandwidth("Parse", fileBytes);
+//       ...
+//   }
+//   EndAndPrintProfile();
+//
+// Compile with -DPROFILER=0 to remove every zone; BeginProfile/EndAndPrintProfile then only read the two timestamps
+// that time the whole run, and allocate nothing.
+// Compile with -DPROFILER_PERF_COUNTERS=1 to also read the perf_event counters in PerfCounters.h on every zone entry and
+// exit. Each read costs far more than a timestamp (one read() syscall for the group, or rdpmc plus a read() for page
+// faults), so it is for finding out why a zone is slow, not for timing it.
+// Compile with -DPROFILER_TRACE=1 to also log every zone hit, with its thread and its begin and end timestamps, and have
+// EndAndPrintProfile write the log as Chrome Trace Event JSON to PROFILER_TRACE_FILE (profile_trace.json by default),
+// which chrome://tracing and Perfetto open as a timeline. Each thread logs into a ring of its own that only it writes,
+// so logging takes no lock; a full ring overwrites its oldest hits, and the report says how many were lost. A hit is
+// logged when the zone closes, as one complete event carrying both timestamps, so nested zones land child first,
+// which the viewers sort out.
+//
+// Every thread that opens a zone gets an anchor table of its own, registered once on its first zone (the thread that
+// calls BeginProfile is registered as "main"), so zones on different threads never share a counter and need no lock or
+// atomic. EndAndPrintProfile merges the tables: each zone's row is the sum over all threads, followed by a row per
+// thread when more than one thread entered it. Summed over parallel threads a zone can take more than 100% of the wall
+// time. Print only after the worker threads are done; tables outlive their threads, so joined threads still count.
+// Up to profilerThreadCount threads are recorded, zones on any further thread are skipped.
+//
+// A thread can be moved to another core while inside a zone. Each zone reads the CPU number along with its timestamps
+// (RDTSCP), and a hit that ends on a different core than it began on is counted as migrated. Its time is kept only if
+// the TSC is invariant and in step across cores (IsCpuTimerInvariant) and did not run backwards; otherwise the hit is
+// counted but its time stays with the enclosing zone.
+//
+// Compile with -DALLOCATION_TRACKING=1 to count heap allocations through the hooks in AllocationTracker.h: every zone
+// then also reports the allocations, bytes and peak live bytes of its hits, inclusive of the zones nested in it, and
+// the whole run is summarized at exit. A zone in a hot loop should read zero. The profiler's own tables bypass the
+// hooks, so they are neither counted in the zones nor reported as leaks or allocation sites.
+//
+// The anchor numbering has internal linkage, so zones have to live in the translation unit that prints the profile.
+//
+// The timer functions come from ../Lecture1/Haversine.CpuTimer/rdtsc.c on Linux, which has to be compiled into the
+// program (build.sh links build/rdtsc.o into every tool). On Windows, where the Part1 simulators are built with MSVC,
+// they come from CpuTimerWin32.h instead and there is nothing to link. Perf counters are Linux-only; allocation tracking
+// works with MSVC too, counting everything allocated through operator new (see AllocationTracker.h).
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+#if defined(_WIN32)
+#    include "CpuTimerWin32.h"
+#else
+#    include "../Lecture1/Haversine.CpuTimer/rdtsc.h"
+#endif
+
+#ifndef PROFILER
+#    define PROFILER 1
+#endif
+
+#ifndef PROFILER_PERF_COUNTERS
+#    define PROFILER_PERF_COUNTERS 0
+#endif
+
+#ifndef PROFILER_TRACE
+#    define PROFILER_TRACE 0
+#endif
+
+#ifndef PROFILER_TRACE_FILE
+#    define PROFILER_TRACE_FILE "profile_trace.json"
+#endif
+
+#ifndef ALLOCATION_TRACKING
+#    define ALLOCATION_TRACKING 0
+#endif
+
+#if defined(_WIN32) && PROFILER_PERF_COUNTERS
+#    error "PROFILER_PERF_COUNTERS needs Linux"
+#endif
+
+#if PROFILER && PROFILER_PERF_COUNTERS
+#    include "PerfCounters.h"
+#endif
+#if ALLOCATION_TRACKING
+#    include "AllocationTracker.h"
+#endif
+
+static const uint32_t profilerAnchorCount = 4096;
+static const uint32_t profilerThreadCount = 256;
+static const uint64_t profilerTraceEventCount = 1 << 20; // per thread, a power of two
+
+struct ProfileTraceEvent
+{
+    uint64_t startCycles;
+    uint64_t endCycles;
+    uint32_t anchorIndex;
+    uint32_t cpu;
+};
+
+struct ProfileAnchor
+{
+    uint64_t exclusiveCycles;
+    uint64_t inclusiveCycles;
+    uint64_t hitCount;
+    uint64_t processedBytes;
+    uint64_t migratedHits;
+    uint64_t droppedHits;
+    const char *label;
+#if PROFILER && PROFILER_PERF_COUNTERS
+    uint64_t inclusiveEvents[perfEventCount];
+#endif
+#if PROFILER && ALLOCATION_TRACKING
+    uint64_t inclusiveAllocations;
+    uint64_t inclusiveAllocatedBytes;
+    int64_t peakLiveBytes;
+#endif
+};
+
+// One thread's zones. Anchor 0 is the root: time spent outside every zone is subtracted from it and never printed.
+struct ProfileThread
+{
+    ProfileAnchor anchors[profilerAnchorCount];
+    uint64_t overheadCycles;
+    uint32_t parentIndex;
+    uint32_t index;
+    char name[32];
+#if PROFILER && PROFILER_PERF_COUNTERS
+    PerfCounters perf;
+#endif
+#if PROFILER && PROFILER_TRACE
+    ProfileTraceEvent *traceEvents;
+    uint64_t tracedHits; // every hit ever logged; the ring holds the last profilerTraceEventCount
+#endif
+};
+
+struct Profiler
+{
+    std::atomic<ProfileThread *> threads[profilerThreadCount];
+    std::atomic<uint32_t> registeredThreads;
+    uint64_t startCycles;
+    uint64_t endCycles;
+    uint64_t timerOverhead;
+    bool timerInvariant;
+};
+
+static Profiler globalProfiler;
+#if PROFILER
+static thread_local ProfileThread *profilerThread;
+static thread_local bool profilerThreadRejected;
+#endif
+
+// Zeroed storage for the profiler's own tables, bypassing the allocation tracker's hooks
+static inline void *ProfilerAllocate(size_t size)
+{
+#if ALLOCATION_TRACKING
+    void *storage = AllocateUntracked(size);
+#else
+    void *storage = calloc(1, size);
+#endif
+    if (!storage)
+    {
+        throw std::bad_alloc();
+    }
+    return storage;
+}
+
+static inline void ProfilerFree(void *storage)
+{
+#if ALLOCATION_TRACKING
+    FreeUntracked(storage);
+#else
+    free(storage);
+#endif
+}
+
+// For the tables the report builds, so printing the profile does not show up in the allocation summary either
+template <typename T>
+struct ProfilerAllocator
+{
+    typedef T value_type;
+
+    ProfilerAllocator() = default;
+    template <typename U>
+    ProfilerAllocator(const ProfilerAllocator<U> &)
+    {
+    }
+
+    T *allocate(size_t count)
+    {
+        return (T *)ProfilerAllocate(count * sizeof(T));
+    }
+
+    void deallocate(T *pointer, size_t)
+    {
+        ProfilerFree(pointer);
+    }
+
+    template <typename U>
+    bool operator==(const ProfilerAllocator<U> &) const
+    {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const ProfilerAllocator<U> &) const
+    {
+        return false;
+    }
+};
+
+typedef std::vector<const ProfileThread *, ProfilerAllocator<const ProfileThread *> > ProfileThreadList;
+typedef std::vector<ProfileAnchor, ProfilerAllocator<ProfileAnchor> > ProfileAnchorTable;
+
+#if PROFILER
+
+// Allocated once per thread and never freed, so the report can still read the tables of threads that have exited
+static ProfileThread *ProfilerRegisterThread(const char *name)
+{
+    uint32_t index = globalProfiler.registeredThreads.fetch_add(1);
+    if (index >= profilerThreadCount)
+    {
+        return nullptr;
+    }
+
+    ProfileThread *thread = new (ProfilerAllocate(sizeof(ProfileThread))) ProfileThread();
+    thread->index = index;
+    if (name)
+    {
+        snprintf(thread->name, sizeof(thread->name), "%s", name);
+    }
+    else
+    {
+        snprintf(thread->name, sizeof(thread->name), "thread %u", index);
+    }
+#if PROFILER && PROFILER_PERF_COUNTERS
+    thread->perf.Open();
+#endif
+#if PROFILER && PROFILER_TRACE
+    thread->traceEvents = (ProfileTraceEvent *)ProfilerAllocate(profilerTraceEventCount * sizeof(ProfileTraceEvent));
+#endif
+    globalProfiler.threads[index].store(thread, std::memory_order_release);
+    return thread;
+}
+
+// The calling thread's table, registering the thread on its first zone; null once every table is taken
+static ProfileThread *ProfilerCurrentThread()
+{
+    if (!profilerThread && !profilerThreadRejected)
+    {
+        profilerThread = ProfilerRegisterThread(nullptr);
+        profilerThreadRejected = !profilerThread;
+    }
+    return profilerThread;
+}
+
+class ProfileBlock
+{
+private:
+    const char *label;
+    ProfileThread *thread;
+    uint64_t oldInclusiveCycles;
+    uint64_t startCycles;
+    uint32_t startCpu;
+    uint32_t parentIndex;
+    uint32_t anchorIndex;
+#    if PROFILER_PERF_COUNTERS
+    PerfEventValues oldInclusiveEvents;
+    PerfEventValues startEvents;
+#    endif
+#    if ALLOCATION_TRACKING
+    uint64_t oldInclusiveAllocations;
+    uint64_t oldInclusiveAllocatedBytes;
+    uint64_t startAllocations;
+    uint64_t startAllocatedBytes;
+    int64_t startLiveBytes;
+    int64_t outerPeakLiveBytes;
+#    endif
+
+public:
+    ProfileBlock(const char *label, uint32_t anchorIndex, uint64_t byteCount)
+    {
+        thread = ProfilerCurrentThread();
+        if (!thread)
+        {
+            return;
+        }
+
+        parentIndex = thread->parentIndex;
+        this->anchorIndex = anchorIndex;
+        this->label = label;
+
+        ProfileAnchor *anchor = thread->anchors + anchorIndex;
+        oldInclusiveCycles = anchor->inclusiveCycles;
+        anchor->processedBytes += byteCount;
+
+        thread->parentIndex = anchorIndex;
+#    if ALLOCATION_TRACKING
+        // The thread's peak restarts from the current live bytes for this zone and is merged back on exit
+        AllocationThreadCounts &allocations = allocationThreadCounts;
+        oldInclusiveAllocations = anchor->inclusiveAllocations;
+        oldInclusiveAllocatedBytes = anchor->inclusiveAllocatedBytes;
+        startAllocations = allocations.allocations;
+        startAllocatedBytes = allocations.allocatedBytes;
+        startLiveBytes = allocations.liveBytes;
+        outerPeakLiveBytes = allocations.peakLiveBytes;
+        allocations.peakLiveBytes = allocations.liveBytes;
+#    endif
+#    if PROFILER_PERF_COUNTERS
+        memcpy(oldInclusiveEvents.values, anchor->inclusiveEvents, sizeof(oldInclusiveEvents.values));
+        thread->perf.Read(&startEvents);
+#    endif
+        startCycles = ReadTimestampCounterBeginCpu(&startCpu);
+    }
+
+    ~ProfileBlock()
+    {
+        uint32_t endCpu;
+        uint64_t endCycles = ReadTimestampCounterEndCpu(&endCpu);
+        if (!thread)
+        {
+            return;
+        }
+#    if PROFILER_PERF_COUNTERS
+        PerfEventValues endEvents;
+        thread->perf.Read(&endEvents);
+#    endif
+        thread->parentIndex = parentIndex;
+
+        ProfileAnchor *parent = thread->anchors + parentIndex;
+        ProfileAnchor *anchor = thread->anchors + anchorIndex;
+
+        uint64_t rawElapsed = endCycles - startCycles;
+        if (startCpu != endCpu)
+        {
+            anchor->migratedHits++;
+            if (!globalProfiler.timerInvariant || endCycles < startCycles)
+            {
+                anchor->droppedHits++;
+                rawElapsed = 0;
+            }
+        }
+
+        uint64_t overhead = rawElapsed < globalProfiler.timerOverhead ? rawElapsed : globalProfiler.timerOverhead;
+        uint64_t elapsed = rawElapsed - overhead;
+        thread->overheadCycles += overhead;
+
+        parent->exclusiveCycles -= rawElapsed;
+        anchor->exclusiveCycles += elapsed;
+        anchor->inclusiveCycles = oldInclusiveCycles + elapsed;
+        anchor->hitCount++;
+        anchor->label = label;
+#    if PROFILER_TRACE
+        ProfileTraceEvent *event = thread->traceEvents + (thread->tracedHits++ & (profilerTraceEventCount - 1));
+        event->startCycles = startCycles;
+        event->endCycles = endCycles;
+        event->anchorIndex = anchorIndex;
+        event->cpu = endCpu;
+#    endif
+#    if PROFILER_PERF_COUNTERS
+        for (int event = 0; event < perfEventCount; event++)
+        {
+            anchor->inclusiveEvents[event] =
+                oldInclusiveEvents.values[event] + (endEvents.values[event] - startEvents.values[event]);
+        }
+#    endif
+#    if ALLOCATION_TRACKING
+        AllocationThreadCounts &allocations = allocationThreadCounts;
+        anchor->inclusiveAllocations = oldInclusiveAllocations + (allocations.allocations - startAllocations);
+        anchor->inclusiveAllocatedBytes =
+            oldInclusiveAllocatedBytes + (allocations.allocatedBytes - startAllocatedBytes);
+        int64_t peak = allocations.peakLiveBytes - startLiveBytes;
+        anchor->peakLiveBytes = peak > anchor->peakLiveBytes ? peak : anchor->peakLiveBytes;
+        allocations.peakLiveBytes =
+            outerPeakLiveBytes > allocations.peakLiveBytes ? outerPeakLiveBytes : allocations.peakLiveBytes;
+#    endif
+    }
+
+    ProfileBlock(const ProfileBlock &) = delete;
+    ProfileBlock &operator=(const ProfileBlock &) = delete;
+};
+
+#    define ProfilerNameConcat2(A, B) A##B
+#    define ProfilerNameConcat(A, B)  ProfilerNameConcat2(A, B)
+#    define TimeBandwidth(Name, ByteCount)                                                                          \
+        ProfileBlock ProfilerNameConcat(profileBlock, __LINE__)(Name, __COUNTER__ + 1, ByteCount)
+#    define ProfilerEndOfCompilationUnit                                                                            \
+        static_assert(__COUNTER__ < profilerAnchorCount, "Number of profile zones exceeds the size of the anchor table")
+
+#else
+
+#    define TimeBandwidth(...)
+#    define ProfilerEndOfCompilationUnit
+
+#endif
+
+#define TimeBlock(Name) TimeBandwidth(Name, 0)
+#define TimeFunction    TimeBlock(__func__)
+
+#if PROFILER
+// Minimum cycles of an empty zone's timestamp pair, measured the way ProfileBlock reads them
+static uint64_t EstimateProfileBlockOverhead()
+{
+    uint64_t overhead = UINT64_MAX;
+    for (int i = 0; i < 10000; i++)
+    {
+        uint32_t cpu;
+        uint64_t start = ReadTimestampCounterBeginCpu(&cpu);
+        uint64_t elapsed = ReadTimestampCounterEndCpu(&cpu) - start;
+        overhead = elapsed < overhead ? elapsed : overhead;
+    }
+    return overhead;
+}
+#endif
+
+// Without PROFILER, only the start timestamp: no thread table and no overhead measurement
+static void BeginProfile()
+{
+#if PROFILER
+    if (!profilerThread && !profilerThreadRejected)
+    {
+        profilerThread = ProfilerRegisterThread("main");
+        profilerThreadRejected = !profilerThread;
+    }
+    globalProfiler.timerInvariant = IsCpuTimerInvariant();
+    globalProfiler.timerOverhead = EstimateProfileBlockOverhead();
+#endif
+    globalProfiler.startCycles = ReadTimestampCounterBegin();
+}
+
+static inline void PrintTimeElapsed(uint64_t totalCycles, uint64_t timerFrequency, const char *label,
+                                    const ProfileAnchor *anchor)
+{
+    double percent = 100.0 * (double)anchor->exclusiveCycles / (double)totalCycles;
+    double inclusivePercent = 100.0 * (double)anchor->inclusiveCycles / (double)totalCycles;
+    printf("%-30s %12llu %12.3f %7.2f%% %12.3f %7.2f%%",
+           label,
+           (unsigned long long)anchor->hitCount,
+           1000.0 * (double)anchor->exclusiveCycles / (double)timerFrequency,
+           percent,
+           1000.0 * (double)anchor->inclusiveCycles / (double)timerFrequency,
+           inclusivePercent);
+
+    if (anchor->processedBytes)
+    {
+        const double megabyte = 1024.0 * 1024.0;
+        const double gigabyte = megabyte * 1024.0;
+
+        double seconds = (double)anchor->inclusiveCycles / (double)timerFrequency;
+        double bytesPerSecond = (double)anchor->processedBytes / seconds;
+        printf("  %.3f MB at %.2f GB/s", (double)anchor->processedBytes / megabyte, bytesPerSecond / gigabyte);
+    }
+    printf("\n");
+}
+
+#if PROFILER
+// The registered tables, in registration order
+static ProfileThreadList ProfilerThreads()
+{
+    ProfileThreadList threads;
+    uint32_t count = globalProfiler.registeredThreads.load();
+    count = count < profilerThreadCount ? count : profilerThreadCount;
+    for (uint32_t index = 0; index < count; index++)
+    {
+        const ProfileThread *thread = globalProfiler.threads[index].load(std::memory_order_acquire);
+        if (thread)
+        {
+            threads.push_back(thread);
+        }
+    }
+    return threads;
+}
+
+// Every thread's anchors summed into one table
+static ProfileAnchorTable MergeProfileThreads(const ProfileThreadList &threads)
+{
+    ProfileAnchorTable merged(profilerAnchorCount);
+    for (const ProfileThread *thread : threads)
+    {
+        for (uint32_t anchorIndex = 0; anchorIndex < profilerAnchorCount; anchorIndex++)
+        {
+            const ProfileAnchor *source = thread->anchors + anchorIndex;
+            ProfileAnchor *target = merged.data() + anchorIndex;
+            target->exclusiveCycles += source->exclusiveCycles;
+            target->inclusiveCycles += source->inclusiveCycles;
+            target->hitCount += source->hitCount;
+            target->processedBytes += source->processedBytes;
+            target->migratedHits += source->migratedHits;
+            target->droppedHits += source->droppedHits;
+            target->label = target->label ? target->label : source->label;
+#if PROFILER && PROFILER_PERF_COUNTERS
+            for (int event = 0; event < perfEventCount; event++)
+            {
+                target->inclusiveEvents[event] += source->inclusiveEvents[event];
+            }
+#endif
+#if PROFILER && ALLOCATION_TRACKING
+            target->inclusiveAllocations += source->inclusiveAllocations;
+            target->inclusiveAllocatedBytes += source->inclusiveAllocatedBytes;
+            target->peakLiveBytes =
+                source->peakLiveBytes > target->peakLiveBytes ? source->peakLiveBytes : target->peakLiveBytes;
+#endif
+        }
+    }
+    return merged;
+}
+#endif
+
+#if PROFILER && PROFILER_PERF_COUNTERS
+// Inclusive counts per zone, summed over threads. IPC needs the cycles event; misses per KB need a TimeBandwidth byte
+// count. Every thread opens the same events, so the first thread's status stands for all of them.
+static void PrintPerfCounters(const ProfileThreadList &threads, const ProfileAnchorTable &merged)
+{
+    if (threads.empty())
+    {
+        return;
+    }
+    const PerfCounters &perf = threads[0]->perf;
+
+    printf("\nPerf counters:\n");
+    for (int event = 0; event < perfEventCount; event++)
+    {
+        printf("  %-14s %s\n", PerfEventName(event), perf.Status(event));
+    }
+
+    printf("\n%-30s %16s %8s %16s %14s %14s\n",
+           "Zone",
+           "Instructions",
+           "IPC",
+           "Cache miss/KB",
+           "Branch misses",
+           "Page faults");
+    for (uint32_t anchorIndex = 1; anchorIndex < profilerAnchorCount; anchorIndex++)
+    {
+        const ProfileAnchor *anchor = merged.data() + anchorIndex;
+        if (!anchor->inclusiveCycles)
+        {
+            continue;
+        }
+
+        const uint64_t *events = anchor->inclusiveEvents;
+        char instructions[32] = "-";
+        char ipc[32] = "-";
+        char missesPerKilobyte[32] = "-";
+        char branchMisses[32] = "-";
+        char pageFaults[32] = "-";
+        if (perf.Available(PerfEventInstructions))
+        {
+            snprintf(instructions, sizeof(instructions), "%llu", (unsigned long long)events[PerfEventInstructions]);
+        }
+        if (perf.Available(PerfEventInstructions) && perf.Available(PerfEventCycles) && events[PerfEventCycles])
+        {
+            snprintf(ipc, sizeof(ipc), "%.2f", (double)events[PerfEventInstructions] / events[PerfEventCycles]);
+        }
+        if (perf.Available(PerfEventCacheMisses) && anchor->processedBytes)
+        {
+            snprintf(missesPerKilobyte,
+                     sizeof(missesPerKilobyte),
+                     "%.3f",
+                     (double)events[PerfEventCacheMisses] / (anchor->processedBytes / 1024.0));
+        }
+        if (perf.Available(PerfEventBranchMisses))
+        {
+            snprintf(branchMisses, sizeof(branchMisses), "%llu", (unsigned long long)events[PerfEventBranchMisses]);
+        }
+        if (perf.Available(PerfEventPageFaults))
+        {
+            snprintf(pageFaults, sizeof(pageFaults), "%llu", (unsigned long long)events[PerfEventPageFaults]);
+        }
+
+        printf("%-30s %16s %8s %16s %14s %14s\n",
+               anchor->label,
+               instructions,
+               ipc,
+               missesPerKilobyte,
+               branchMisses,
+               pageFaults);
+    }
+}
+#endif
+
+#if PROFILER && ALLOCATION_TRACKING
+// Inclusive per zone and summed over threads, except the peak, which is the highest any one hit reached
+static void PrintAllocations(const ProfileAnchorTable &merged)
+{
+    printf("\n%-30s %14s %12s %14s %14s\n", "Zone", "Allocations", "Per hit", "Bytes", "Peak live");
+    for (uint32_t anchorIndex = 1; anchorIndex < profilerAnchorCount; anchorIndex++)
+    {
+        const ProfileAnchor *anchor = merged.data() + anchorIndex;
+        if (!anchor->hitCount)
+        {
+            continue;
+        }
+        printf("%-30s %14llu %12.2f %14s %14s\n",
+               anchor->label,
+               (unsigned long long)anchor->inclusiveAllocations,
+               (double)anchor->inclusiveAllocations / (double)anchor->hitCount,
+               FormatAllocationBytes((double)anchor->inclusiveAllocatedBytes).c_str(),
+               FormatAllocationBytes((double)anchor->peakLiveBytes).c_str());
+    }
+}
+#endif
+
+#if PROFILER && PROFILER_TRACE
+// Labels are string literals and function names; only quotes and backslashes need escaping
+static void WriteJsonString(FILE *file, const char *text)
+{
+    fputc('"', file);
+    for (const char *c = text ? text : "?"; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            fputc('\\', file);
+        }
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+// Chrome Trace Event format: one complete ("X") event per hit, with times in microseconds since BeginProfile, and a
+// thread_name metadata event per thread. Threads are numbered in registration order.
+static void WriteProfileTrace(const ProfileThreadList &threads, uint64_t timerFrequency)
+{
+    FILE *file = fopen(PROFILER_TRACE_FILE, "w");
+    if (!file)
+    {
+        printf("Could not write the trace to %s\n", PROFILER_TRACE_FILE);
+        return;
+    }
+
+    double microsecondsPerCycle = 1000000.0 / (double)timerFrequency;
+    uint64_t eventCount = 0;
+    uint64_t lostCount = 0;
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (const ProfileThread *thread : threads)
+    {
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", thread->index);
+        WriteJsonString(file, thread->name);
+        fprintf(file, "}},\n");
+        fprintf(file,
+                "{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"sort_index\":%u}},\n",
+                thread->index,
+                thread->index);
+
+        uint64_t kept = thread->tracedHits < profilerTraceEventCount ? thread->tracedHits : profilerTraceEventCount;
+        lostCount += thread->tracedHits - kept;
+        for (uint64_t hit = thread->tracedHits - kept; hit < thread->tracedHits; hit++)
+        {
+            const ProfileTraceEvent *event = thread->traceEvents + (hit & (profilerTraceEventCount - 1));
+            double start = (double)(int64_t)(event->startCycles - globalProfiler.startCycles) * microsecondsPerCycle;
+            double duration = (double)(int64_t)(event->endCycles - event->startCycles) * microsecondsPerCycle;
+            fprintf(file, "{\"name\":");
+            WriteJsonString(file, thread->anchors[event->anchorIndex].label);
+            fprintf(file,
+                    ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"cpu\":%d}},\n",
+                    thread->index,
+                    start,
+                    duration > 0 ? duration : 0.0,
+                    event->cpu == cpuTimerUnknownCpu ? -1 : (int)event->cpu);
+            eventCount++;
+        }
+    }
+
+    // A closing event with no trailing comma keeps the array valid JSON
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Haversine\"}}\n]}\n");
+    fclose(file);
+
+    printf("Trace: %llu events written to %s", (unsigned long long)eventCount, PROFILER_TRACE_FILE);
+    if (lostCount)
+    {
+        printf(", %llu older events overwritten (ring of %llu per thread)",
+               (unsigned long long)lostCount,
+               (unsigned long long)profilerTraceEventCount);
+    }
+    printf("\n");
+}
+#endif
+
+static void EndAndPrintProfile()
+{
+    globalProfiler.endCycles = ReadTimestampCounterEnd();
+    uint64_t timerFrequency = EstimateCpuTimerFreq();
+    uint64_t totalCycles = globalProfiler.endCycles - globalProfiler.startCycles;
+
+    printf("\n=== PROFILE ===\n\n");
+    if (timerFrequency)
+    {
+        printf("Total time: %.4f ms (CPU freq ~%llu MHz from %s)\n",
+               1000.0 * (double)totalCycles / (double)timerFrequency,
+               (unsigned long long)(timerFrequency / 1000000),
+               CpuTimerFreqSourceName(GetCpuTimerFreqSource()));
+    }
+    if (!timerFrequency || !totalCycles)
+    {
+        return;
+    }
+
+#if PROFILER
+    ProfileThreadList threads = ProfilerThreads();
+    ProfileAnchorTable merged = MergeProfileThreads(threads);
+    uint32_t registered = globalProfiler.registeredThreads.load();
+    printf("Threads: %zu", threads.size());
+    if (registered > threads.size())
+    {
+        printf(" (%u more not recorded)", registered - (uint32_t)threads.size());
+    }
+    printf(", TSC %s\n", globalProfiler.timerInvariant ? "invariant across cores" : "not invariant across cores");
+
+    printf("\n%-30s %12s %12s %8s %12s %8s\n", "Zone", "Hit Count", "Excl (ms)", "Percent", "Incl (ms)", "Percent");
+    uint64_t overheadCycles = 0;
+    uint64_t migratedHits = 0;
+    uint64_t droppedHits = 0;
+    for (uint32_t anchorIndex = 1; anchorIndex < profilerAnchorCount; anchorIndex++)
+    {
+        const ProfileAnchor *anchor = merged.data() + anchorIndex;
+        if (!anchor->hitCount)
+        {
+            continue;
+        }
+        PrintTimeElapsed(totalCycles, timerFrequency, anchor->label, anchor);
+        migratedHits += anchor->migratedHits;
+        droppedHits += anchor->droppedHits;
+
+        // One row per thread, only when the zone ran on several
+        int threadsInZone = 0;
+        for (const ProfileThread *thread : threads)
+        {
+            threadsInZone += thread->anchors[anchorIndex].hitCount != 0;
+        }
+        if (threadsInZone > 1)
+        {
+            for (const ProfileThread *thread : threads)
+            {
+                if (thread->anchors[anchorIndex].hitCount)
+                {
+                    char label[48];
+                    snprintf(label, sizeof(label), "  [%s]", thread->name);
+                    PrintTimeElapsed(totalCycles, timerFrequency, label, thread->anchors + anchorIndex);
+                }
+            }
+        }
+    }
+    for (const ProfileThread *thread : threads)
+    {
+        overheadCycles += thread->overheadCycles;
+    }
+    printf("%-30s %12s %12.3f %7.2f%%  (%llu cycles per zone)\n",
+           "[timer overhead]",
+           "",
+           1000.0 * (double)overheadCycles / (double)timerFrequency,
+           100.0 * (double)overheadCycles / (double)totalCycles,
+           (unsigned long long)globalProfiler.timerOverhead);
+    if (migratedHits)
+    {
+        printf("%llu zone hits moved to another core, %llu of them without a usable time\n",
+               (unsigned long long)migratedHits,
+               (unsigned long long)droppedHits);
+    }
+#    if PROFILER_PERF_COUNTERS
+    PrintPerfCounters(threads, merged);
+#    endif
+#    if ALLOCATION_TRACKING
+    PrintAllocations(merged);
+#    endif
+#    if PROFILER_TRACE
+    WriteProfileTrace(threads, timerFrequency);
+#    endif
+#endif
+    printf("\n");
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+// Whole-file readers. Each fills a caller-provided buffer that is exactly the size of the file and throws
+// std::runtime_error on failure, so the repetition tester can compare them on the same destination memory. ReadFile is
+// the one the tools use: it allocates the buffer and reads through ifstream.
+
+#include <cstdio>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+static size_t FileSize(const std::string &filePath)
+{
+    struct stat status;
+    if (stat(filePath.c_str(), &status) != 0)
+    {
+        throw std::runtime_error("Unable to open file: " + filePath);
+    }
+    return (size_t)status.st_size;
+}
+
+static void ReadWithIfstream(const std::string &filePath, std::span<char> buffer)
+{
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Unable to open file: " + filePath);
+    }
+    if (!file.read(buffer.data(), (std::streamsize)buffer.size()))
+    {
+        throw std::runtime_error("Failed to read file: " + filePath);
+    }
+}
+
+static inline void ReadWithFread(const std::string &filePath, std::span<char> buffer)
+{
+    FILE *file = fopen(filePath.c_str(), "rb");
+    if (!file)
+    {
+        throw std::runtime_error("Unable to open file: " + filePath);
+    }
+    size_t bytesRead = fread(buffer.data(), 1, buffer.size(), file);
+    fclose(file);
+    if (bytesRead != buffer.size())
+    {
+        throw std::runtime_error("Failed to read file: " + filePath);
+    }
+}
+
+// One libc call per byte; the stdio buffer still reads the file in large blocks underneath
+static inline void ReadWithFgetc(const std::string &filePath, std::span<char> buffer)
+{
+    FILE *file = fopen(filePath.c_str(), "rb");
+    if (!file)
+    {
+        throw std::runtime_error("Unable to open file: " + filePath);
+    }
+    size_t bytesRead = 0;
+    int c;
+    while (bytesRead < buffer.size() && (c = fgetc(file)) != EOF)
+    {
+        buffer[bytesRead++] = (char)c;
+    }
+    fclose(file);
+    if (bytesRead != buffer.size())
+    {
+        throw std::runtime_error("Failed to read file: " + filePath);
+    }
+}
+
+static std::vector<char> ReadFile(const std::string &filePath)
+{
+    std::vector<char> buffer(FileSize(filePath));
+    ReadWithIfstream(filePath, buffer);
+    return buffer;
+}
@@ -0,0 +1,352 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+#include "ChunkReader.h"
+#include "RepetitionTester.h"
+
+// Every strategy reads the whole file into memory the program can touch. The chunked ones reuse one chunk-sized
+// buffer, as a streaming parser would; the rest read into a buffer the size of the file. The mmap strategies fault
+// every page in but load only one byte per page, so they measure what it costs to get the file into the address
+// space, not a copy: a parser reading the mapping pays for its own loads either way.
+enum class ReadStrategy
+{
+    Fread,
+    ReadPreallocated,
+    ReadMalloc,
+    Mmap,
+    MmapPopulate,
+    Direct
+};
+
+struct ReadCase
+{
+    ReadStrategy strategy;
+    size_t chunkBytes; // 0: the whole file in one call
+};
+
+static const size_t directAlignment = 4096;
+static const size_t pageBytes = 4096;
+
+// Function prototypes
+static void CreateTestFile(const std::string &filePath, size_t size);
+static const char *StrategyName(ReadStrategy strategy);
+static bool ReadOnce(const std::string &filePath, const ReadCase &readCase, size_t fileSize, char *buffer);
+static void RunMatrix(const std::string &directory, size_t maxBytes, bool cold, uint32_t secondsToTry, FILE *csv);
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && (std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help"))
+    {
+        std::cout << "Usage: program [directory for test files] [largest file MB] [cold/warm] [seconds without a new "
+                     "minimum] [output.csv]\n";
+        std::cout << "Files from 4 KB up to the largest size, growing 4x, are created in the directory and removed "
+                     "afterwards. cold drops each file from the page cache before every repetition.\n";
+        return 0;
+    }
+
+    try
+    {
+        std::string directory = argc > 1 ? argv[1] : ".";
+        size_t maxBytes = (argc > 2 ? (size_t)std::atoll(argv[2]) : 1024) * 1024 * 1024;
+        bool cold = argc > 3 && std::string(argv[3]) == "cold";
+        uint32_t secondsToTry = argc > 4 ? (uint32_t)std::atoi(argv[4]) : 2;
+        std::string csvPath = argc > 5 ? argv[5] : "read_matrix.csv";
+
+        FILE *csv = fopen(csvPath.c_str(), "w");
+        if (!csv)
+        {
+            throw std::runtime_error("Unable to open file: " + csvPath);
+        }
+        fprintf(csv,
+                "file_bytes,strategy,chunk_bytes,cache,repetitions,min_seconds,min_gb_per_s,avg_gb_per_s,"
+                "max_seconds,avg_page_faults\n");
+        RunMatrix(directory, maxBytes, cold, secondsToTry, csv);
+        fclose(csv);
+        printf("\nWrote %s\n", csvPath.c_str());
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}
+
+static void RunMatrix(const std::string &directory, size_t maxBytes, bool cold, uint32_t secondsToTry, FILE *csv)
+{
+    static const ReadCase cases[] = {
+        {ReadStrategy::Fread, 0},
+        {ReadStrategy::ReadPreallocated, 0},
+        {ReadStrategy::ReadPreallocated, 64 * 1024},
+        {ReadStrategy::ReadPreallocated, 1024 * 1024},
+        {ReadStrategy::ReadPreallocated, 16 * 1024 * 1024},
+        {ReadStrategy::ReadMalloc, 0},
+        {ReadStrategy::Mmap, 0},
+        {ReadStrategy::MmapPopulate, 0},
+        {ReadStrategy::Direct, 64 * 1024},
+        {ReadStrategy::Direct, 1024 * 1024},
+        {ReadStrategy::Direct, 16 * 1024 * 1024},
+    };
+
+    const double gigabyte = 1024.0 * 1024.0 * 1024.0;
+    uint64_t cpuTimerFreq = EstimateCpuTimerFreq();
+
+    for (size_t fileSize = 4 * 1024; fileSize <= maxBytes; fileSize *= 4)
+    {
+        std::string filePath = directory + "/read_matrix_" + std::to_string(fileSize) + ".bin";
+        CreateTestFile(filePath, fileSize);
+
+        // One buffer for every strategy that reads the whole file into memory it did not allocate itself. Aligned
+        // for O_DIRECT and faulted in here, so no strategy pays for its first touch.
+        size_t bufferBytes = (fileSize + directAlignment - 1) & ~(directAlignment - 1);
+        char *buffer = (char *)aligned_alloc(directAlignment, bufferBytes);
+        if (!buffer)
+        {
+            std::remove(filePath.c_str());
+            throw std::runtime_error("Out of memory for a " + std::to_string(fileSize) + " byte buffer");
+        }
+        memset(buffer, 0, bufferBytes);
+
+        for (const ReadCase &readCase : cases)
+        {
+            // A chunk as large as the file is the same as the whole-file case
+            if (readCase.chunkBytes && readCase.chunkBytes >= fileSize && readCase.strategy != ReadStrategy::Direct)
+            {
+                continue;
+            }
+            if (readCase.strategy == ReadStrategy::Direct && readCase.chunkBytes > fileSize)
+            {
+                continue;
+            }
+
+            std::string name = std::string(StrategyName(readCase.strategy)) + " " + std::to_string(fileSize / 1024) +
+                               " KB";
+            if (readCase.chunkBytes)
+            {
+                name += ", " + std::to_string(readCase.chunkBytes / 1024) + " KB chunks";
+            }
+
+            RepetitionTester tester;
+            tester.NewTestWave(name, fileSize, secondsToTry);
+            while (tester.IsTesting())
+            {
+                if (cold)
+                {
+                    EvictFromPageCache(filePath);
+                }
+
+                tester.BeginTime();
+                bool ok = ReadOnce(filePath, readCase, fileSize, buffer);
+                tester.EndTime();
+                if (!ok)
+                {
+                    tester.Error(std::string("Read failed: ") + strerror(errno));
+                    break;
+                }
+                tester.CountBytes(fileSize);
+            }
+
+            const RepetitionResults &results = tester.Results();
+            uint64_t repetitions = results.total.e[RepetitionValueTestCount];
+            if (tester.Failed() || !repetitions)
+            {
+                continue;
+            }
+
+            double minSeconds = (double)results.min.e[RepetitionValueCycles] / cpuTimerFreq;
+            double maxSeconds = (double)results.max.e[RepetitionValueCycles] / cpuTimerFreq;
+            double avgSeconds = (double)results.total.e[RepetitionValueCycles] / cpuTimerFreq / repetitions;
+            fprintf(csv,
+                    "%zu,%s,%zu,%s,%llu,%.9f,%.3f,%.3f,%.9f,%.2f\n",
+                    fileSize,
+                    StrategyName(readCase.strategy),
+                    readCase.chunkBytes ? readCase.chunkBytes : fileSize,
+                    cold ? "cold" : "warm",
+                    (unsigned long long)repetitions,
+                    minSeconds,
+                    fileSize / gigabyte / minSeconds,
+                    fileSize / gigabyte / avgSeconds,
+                    maxSeconds,
+                    (double)results.total.e[RepetitionValuePageFaults] / repetitions);
+            fflush(csv);
+        }
+
+        free(buffer);
+        std::remove(filePath.c_str());
+    }
+}
+
+static const char *StrategyName(ReadStrategy strategy)
+{
+    switch (strategy)
+    {
+        case ReadStrategy::Fread:
+            return "fread";
+        case ReadStrategy::ReadPreallocated:
+            return "read";
+        case ReadStrategy::ReadMalloc:
+            return "read+malloc";
+        case ReadStrategy::Mmap:
+            return "mmap+touch";
+        case ReadStrategy::MmapPopulate:
+            return "mmap_populate+touch";
+        case ReadStrategy::Direct:
+            return "o_direct";
+    }
+    return "unknown";
+}
+
+// Reads until count bytes have arrived or the file ends
+static bool ReadFully(int fd, char *destination, size_t count)
+{
+    while (count)
+    {
+        ssize_t bytesRead = read(fd, destination, count);
+        if (bytesRead < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (bytesRead <= 0)
+        {
+            return false;
+        }
+        destination += bytesRead;
+        count -= (size_t)bytesRead;
+    }
+    return true;
+}
+
+// Sums one byte per page, so every page of the mapping is faulted in and the compiler cannot skip the loads
+static void TouchPages(const char *data, size_t size)
+{
+    unsigned char sum = 0;
+    for (size_t offset = 0; offset < size; offset += pageBytes)
+    {
+        sum += (unsigned char)data[offset];
+    }
+    volatile unsigned char sink = sum;
+    (void)sink;
+}
+
+static bool ReadOnce(const std::string &filePath, const ReadCase &readCase, size_t fileSize, char *buffer)
+{
+    switch (readCase.strategy)
+    {
+        case ReadStrategy::Fread:
+        {
+            FILE *file = fopen(filePath.c_str(), "rb");
+            if (!file)
+            {
+                return false;
+            }
+            bool ok = fread(buffer, 1, fileSize, file) == fileSize;
+            fclose(file);
+            return ok;
+        }
+
+        case ReadStrategy::ReadPreallocated:
+        case ReadStrategy::ReadMalloc:
+        case ReadStrategy::Direct:
+        {
+            bool direct = readCase.strategy == ReadStrategy::Direct;
+            int fd = open(filePath.c_str(), O_RDONLY | (direct ? O_DIRECT : 0));
+            if (fd < 0)
+            {
+                return false;
+            }
+
+            char *destination = buffer;
+            if (readCase.strategy == ReadStrategy::ReadMalloc)
+            {
+                destination = (char *)malloc(fileSize);
+                if (!destination)
+                {
+                    close(fd);
+                    return false;
+                }
+            }
+
+            // Chunked reads land in the front of the buffer over and over, like a streaming reader's ring slot
+            bool ok = true;
+            if (readCase.chunkBytes)
+            {
+                for (size_t offset = 0; ok && offset < fileSize; offset += readCase.chunkBytes)
+                {
+                    size_t count = fileSize - offset < readCase.chunkBytes ? fileSize - offset : readCase.chunkBytes;
+                    ok = ReadFully(fd, destination, count);
+                }
+            }
+            else
+            {
+                ok = ReadFully(fd, destination, fileSize);
+            }
+
+            if (destination != buffer)
+            {
+                free(destination);
+            }
+            close(fd);
+            return ok;
+        }
+
+        case ReadStrategy::Mmap:
+        case ReadStrategy::MmapPopulate:
+        {
+            int fd = open(filePath.c_str(), O_RDONLY);
+            if (fd < 0)
+            {
+                return false;
+            }
+            int flags = MAP_PRIVATE | (readCase.strategy == ReadStrategy::MmapPopulate ? MAP_POPULATE : 0);
+            void *mapping = mmap(nullptr, fileSize, PROT_READ, flags, fd, 0);
+            close(fd);
+            if (mapping == MAP_FAILED)
+            {
+                return false;
+            }
+            TouchPages((const char *)mapping, fileSize);
+            munmap(mapping, fileSize);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Written in 1 MB blocks of a repeating pattern and synced, so the pages are clean and can be evicted for cold runs
+static void CreateTestFile(const std::string &filePath, size_t size)
+{
+    int fd = open(filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Unable to create file: " + filePath);
+    }
+
+    std::vector<char> block(1024 * 1024);
+    for (size_t i = 0; i < block.size(); i++)
+    {
+        block[i] = (char)(i * 31 + 7);
+    }
+
+    for (size_t written = 0; written < size;)
+    {
+        size_t count = size - written < block.size() ? size - written : block.size();
+        ssize_t result = write(fd, block.data(), count);
+        if (result <= 0)
+        {
+            close(fd);
+            throw std::runtime_error("Failed to write file: " + filePath);
+        }
+        written += (size_t)result;
+    }
+    fsync(fd);
+    close(fd);
+}
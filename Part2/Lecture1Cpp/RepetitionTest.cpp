@@ -0,0 +1,184 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "HaversineBinary.h"
+#include "HaversineJson.h"
+#include "PairTable.h"
+#include "ReadFile.h"
+#include "RepetitionTester.h"
+
+typedef void ReadFunction(const std::string &filePath, std::span<char> buffer);
+
+struct ReadTest
+{
+    const char *name;
+    ReadFunction *function;
+};
+
+enum class BufferMode
+{
+    Reused,
+    Fresh
+};
+
+// Function prototypes
+static void TestReaders(const std::string &filePath, uint32_t secondsToTry);
+static void TestWriters(size_t pairCount, uint32_t secondsToTry);
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && (std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help"))
+    {
+        std::cout << "Usage: program [haversine_input.json] [seconds without a new minimum] [pairs to write]\n";
+        std::cout << "Repeats each file reader and the Haversine writers until their best time stops improving.\n";
+        return 0;
+    }
+
+    try
+    {
+        std::string filePath = argc > 1 ? argv[1] : "haversine_input.json";
+        uint32_t secondsToTry = argc > 2 ? (uint32_t)std::atoi(argv[2]) : 10;
+        size_t pairCount = argc > 3 ? (size_t)std::atoll(argv[3]) : 100000;
+
+        TestReaders(filePath, secondsToTry);
+        TestWriters(pairCount, secondsToTry);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}
+
+// Every reader runs into one buffer that stays mapped across repetitions, and into a buffer allocated and freed inside
+// the timed region, which adds the page faults of fresh memory to every run.
+static void TestReaders(const std::string &filePath, uint32_t secondsToTry)
+{
+    static const ReadTest tests[] = {
+        {"ifstream", ReadWithIfstream},
+        {"fread", ReadWithFread},
+        {"fgetc", ReadWithFgetc},
+    };
+
+    size_t fileSize = FileSize(filePath);
+    std::vector<char> reusedBuffer(fileSize);
+    printf("File: %s, %.1f MB\n", filePath.c_str(), fileSize / (1024.0 * 1024.0));
+
+    for (BufferMode mode : {BufferMode::Reused, BufferMode::Fresh})
+    {
+        for (const ReadTest &test : tests)
+        {
+            std::string name = std::string(test.name) + (mode == BufferMode::Reused ? "" : " + malloc");
+            RepetitionTester tester;
+            tester.NewTestWave(name, fileSize, secondsToTry);
+            while (tester.IsTesting())
+            {
+                tester.BeginTime();
+                if (mode == BufferMode::Reused)
+                {
+                    test.function(filePath, reusedBuffer);
+                }
+                else
+                {
+                    char *buffer = (char *)malloc(fileSize);
+                    if (!buffer)
+                    {
+                        tester.EndTime();
+                        tester.Error("Out of memory");
+                        break;
+                    }
+                    test.function(filePath, std::span<char>(buffer, fileSize));
+                    free(buffer);
+                }
+                tester.EndTime();
+                tester.CountBytes(fileSize);
+            }
+        }
+    }
+
+    RepetitionTester tester;
+    tester.NewTestWave("ReadFile (std::vector)", fileSize, secondsToTry);
+    while (tester.IsTesting())
+    {
+        tester.BeginTime();
+        std::vector<char> content = ReadFile(filePath);
+        tester.EndTime();
+        tester.CountBytes(content.size());
+    }
+}
+
+// The generator's writers on a fixed set of random pairs: JSON formatting alone into memory, the JSON file, and the
+// binary pair file. Output files are written next to the working directory and removed afterwards.
+static void TestWriters(size_t pairCount, uint32_t secondsToTry)
+{
+    std::mt19937_64 random(1000);
+    std::uniform_real_distribution<double> randomX(-180.0, 180.0);
+    std::uniform_real_distribution<double> randomY(-90.0, 90.0);
+    PairTable pairs(pairCount);
+    for (size_t i = 0; i < pairCount; i++)
+    {
+        pairs.Append({randomX(random), randomY(random), randomX(random), randomY(random)});
+    }
+
+    std::ostringstream probe;
+    WritePairsJson(probe, pairs);
+    size_t jsonBytes = probe.str().size();
+    printf("\nWriters: %zu pairs, %.1f MB of JSON\n", pairCount, jsonBytes / (1024.0 * 1024.0));
+
+    RepetitionTester tester;
+    tester.NewTestWave("WritePairsJson (memory)", jsonBytes, secondsToTry);
+    while (tester.IsTesting())
+    {
+        std::ostringstream out;
+        tester.BeginTime();
+        WritePairsJson(out, pairs);
+        tester.EndTime();
+        tester.CountBytes((uint64_t)out.tellp());
+    }
+
+    const std::string jsonPath = "repetition_test.json";
+    tester.NewTestWave("WritePairsJson (file)", jsonBytes, secondsToTry);
+    while (tester.IsTesting())
+    {
+        tester.BeginTime();
+        std::ofstream file(jsonPath);
+        WritePairsJson(file, pairs);
+        file.close();
+        tester.EndTime();
+        if (!file)
+        {
+            tester.Error("Failed to write " + jsonPath);
+            break;
+        }
+        tester.CountBytes(FileSize(jsonPath));
+    }
+    std::remove(jsonPath.c_str());
+
+    const std::string binaryPath = "repetition_test.hvp";
+    uint64_t binaryBytes = sizeof(PairFileHeader) + 4 * PairFileColumnStride(pairCount);
+    tester.NewTestWave("WritePairFile", binaryBytes, secondsToTry);
+    while (tester.IsTesting())
+    {
+        tester.BeginTime();
+        WritePairFile(binaryPath,
+                      pairs.X0().data(),
+                      pairs.Y0().data(),
+                      pairs.X1().data(),
+                      pairs.Y1().data(),
+                      pairs.Size(),
+                      1000,
+                      pairFileDistributionUnknown);
+        tester.EndTime();
+        tester.CountBytes(FileSize(binaryPath));
+    }
+    std::remove(binaryPath.c_str());
+}
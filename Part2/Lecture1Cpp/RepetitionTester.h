@@ -0,0 +1,426 @@
+#pragma once
+
+// Repetition tester: runs one routine over and over and keeps its best time, which is the closest a measurement gets
+// to what the code costs once caches, TLBs and branch predictors are warm and nothing else interrupts it.
+//
+//   RepetitionTester tester;
+//   tester.NewTestWave("fread", fileBytes);
+//   while (tester.IsTesting())
+//   {
+//       tester.BeginTime();
+//       fread(...);
+//       tester.EndTime();
+//       tester.CountBytes(fileBytes);
+//   }
+//
+// A wave keeps going until the minimum has not improved for secondsToTry seconds, so a routine that is still speeding
+// up keeps being retried; the results are printed when it ends. Time and page faults (minor + major, process-wide) are
+// only counted between BeginTime and EndTime, which may be called several times per repetition to leave setup out.
+// Every repetition's time is kept, and a completed wave is appended to the result store in BenchmarkResults.h as
+// "<program>/<wave name>", so runs of different revisions can be compared with bench_compare.
+//
+// The environment checks in BenchmarkEnvironment.h run around every wave: the thread is pinned first when
+// BENCHMARK_CPU is set, the core clock is compared with the TSC before and after (with a warning when it moved), and
+// each repetition counts the interrupts and context switches that landed between BeginTime and EndTime. A repetition
+// that was switched out involuntarily, moved to another CPU or took more interrupts than the noise threshold is marked
+// noisy in the report and in the result store.
+//
+// BeginTime takes the noise snapshot before reading page faults and the timestamp, and EndTime after, so the
+// snapshot's syscalls and /proc read are neither timed nor counted as faults. A caller that reads counters of its own
+// around the region (perf events) uses the halves instead, and reads them in between:
+//
+//   tester.BeginNoise();
+//   perf.Read(&before);
+//   tester.BeginTimer();
+//   ...
+//   tester.EndTimer();
+//   perf.Read(&after);
+//   tester.EndNoise();
+
+#include <cstdint>
+#include <cstdio>
+#include <errno.h>
+#include <sched.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Arena.h"
+#include "BenchmarkEnvironment.h"
+#include "BenchmarkResults.h"
+#include "../Lecture1/Haversine.CpuTimer/rdtsc.h"
+
+enum RepetitionValue
+{
+    RepetitionValueTestCount,
+    RepetitionValueCycles,
+    RepetitionValueBytes,
+    RepetitionValuePageFaults,
+
+    repetitionValueCount
+};
+
+struct RepetitionValues
+{
+    uint64_t e[repetitionValueCount];
+};
+
+struct RepetitionResults
+{
+    RepetitionValues total;
+    RepetitionValues min;
+    RepetitionValues max;
+};
+
+class RepetitionTester
+{
+private:
+    enum class State
+    {
+        Uninitialized,
+        Testing,
+        Completed,
+        Error
+    };
+
+    State state = State::Uninitialized;
+    std::string name;
+    uint64_t targetBytes = 0;
+    uint64_t cpuTimerFreq = 0;
+    uint64_t tryForTicks = 0;
+    uint64_t testsStartedAt = 0;
+
+    uint32_t openBlockCount = 0;
+    uint32_t closeBlockCount = 0;
+    RepetitionValues accumulatedOnThisTest = {};
+    RepetitionResults results = {};
+    std::vector<uint64_t> samples; // cycles of every repetition, in order
+    std::vector<uint8_t> noisy;    // parallel to samples
+    size_t minSample = 0;
+    size_t maxSample = 0;
+
+    int pinnedCpu = -1;
+    double noiseThreshold = 1.0; // interrupts per millisecond
+    ClockRatio clockBefore;
+    ClockRatio clockAfter;
+    NoiseCount noiseOnThisTest;
+    NoiseCount noiseTotal;
+    int noiseCpu = -1;                // CPU the open block's noise snapshot was taken on
+    uint64_t noiseStartInterrupts = 0; // that CPU's interrupt count at the snapshot
+    bool migratedOnThisTest = false;
+    uint64_t preemptedCount = 0;
+    uint64_t migratedCount = 0;
+    uint64_t interruptedCount = 0;
+
+    // Interrupts are only counted on the CPU the repetition ran on: every CPU's would include what other cores took,
+    // which on a large machine is many times the per-CPU threshold
+    int CurrentCpu() const
+    {
+        return pinnedCpu >= 0 ? pinnedCpu : sched_getcpu();
+    }
+
+    static uint64_t TotalPageFaults()
+    {
+        PageFaultCount faults = ReadPageFaults();
+        return (uint64_t)(faults.minor + faults.major);
+    }
+
+    double Seconds(double cycles) const
+    {
+        return cycles / (double)cpuTimerFreq;
+    }
+
+    void PrintEnvironment() const
+    {
+        uint64_t testCount = results.total.e[RepetitionValueTestCount];
+        uint64_t noisyCount = 0;
+        for (uint8_t mark : noisy)
+        {
+            noisyCount += mark;
+        }
+        printf("Noise: %llu of %llu repetitions noisy (%llu switched out, %llu moved to another CPU, %llu over %.2f "
+               "interrupts/ms); %llu interrupts, %llu involuntary and %llu voluntary context switches\n",
+               (unsigned long long)noisyCount,
+               (unsigned long long)testCount,
+               (unsigned long long)preemptedCount,
+               (unsigned long long)migratedCount,
+               (unsigned long long)interruptedCount,
+               noiseThreshold,
+               (unsigned long long)noiseTotal.interrupts,
+               (unsigned long long)noiseTotal.involuntarySwitches,
+               (unsigned long long)noiseTotal.voluntarySwitches);
+
+        char cpu[32] = "not pinned";
+        if (pinnedCpu >= 0)
+        {
+            snprintf(cpu, sizeof(cpu), "pinned to CPU %d", pinnedCpu);
+        }
+        if (!clockBefore.coreToTsc || !clockAfter.coreToTsc)
+        {
+            printf("Core clock: not measured, %s\n", cpu);
+            return;
+        }
+        printf("Core clock: %.3fx TSC before, %.3fx after (%s), %s\n",
+               clockBefore.coreToTsc,
+               clockAfter.coreToTsc,
+               clockBefore.fromPerf && clockAfter.fromPerf ? "cycles/ref-cycles" : "add chain",
+               cpu);
+        double drift = clockAfter.coreToTsc / clockBefore.coreToTsc - 1.0;
+        if (drift > benchmarkClockDriftWarning || drift < -benchmarkClockDriftWarning)
+        {
+            printf("WARNING: the core clock changed by %+.1f%% during the test; frequency scaling moved mid-run, so "
+                   "repetitions from before and after are not comparable\n",
+                   100.0 * drift);
+        }
+    }
+
+    void PrintValue(const char *label, const RepetitionValues &values, uint64_t testCount) const
+    {
+        double divisor = testCount ? (double)testCount : 1.0;
+        double cycles = (double)values.e[RepetitionValueCycles] / divisor;
+        double bytes = (double)values.e[RepetitionValueBytes] / divisor;
+        double pageFaults = (double)values.e[RepetitionValuePageFaults] / divisor;
+
+        printf("%s: %.0f cycles (%.6f ms)", label, cycles, 1000.0 * Seconds(cycles));
+        if (bytes > 0)
+        {
+            const double gigabyte = 1024.0 * 1024.0 * 1024.0;
+            double seconds = Seconds(cycles);
+            printf(", %.3f bytes/cycle, %.3f GB/s", cycles > 0 ? bytes / cycles : 0.0, bytes / gigabyte / seconds);
+        }
+        if (pageFaults > 0)
+        {
+            printf(", %.2f page faults (%.1f KB/fault)", pageFaults, bytes / pageFaults / 1024.0);
+        }
+    }
+
+public:
+    // Starts a wave. Calling it again with the same name keeps the previous results, so a test can be given more time
+    // by running another wave.
+    void NewTestWave(const std::string &testName, uint64_t expectedBytes, uint32_t secondsToTry = 10)
+    {
+        cpuTimerFreq = EstimateCpuTimerFreq();
+        if (!cpuTimerFreq)
+        {
+            throw std::runtime_error("Could not determine the CPU timer frequency");
+        }
+
+        bool sameTest = state != State::Uninitialized && testName == name;
+        if (sameTest && expectedBytes != targetBytes)
+        {
+            Error("Target bytes changed between waves of the same test");
+            return;
+        }
+        if (!sameTest)
+        {
+            results = {};
+            results.min.e[RepetitionValueCycles] = UINT64_MAX;
+            samples.clear();
+            noisy.clear();
+            noiseTotal = {};
+            preemptedCount = 0;
+            migratedCount = 0;
+            interruptedCount = 0;
+        }
+
+        pinnedCpu = BenchmarkPinnedCpu();
+        if (pinnedCpu >= 0)
+        {
+            PinThreadToCpu(pinnedCpu);
+        }
+        noiseThreshold = BenchmarkNoiseThreshold();
+
+        state = State::Testing;
+        name = testName;
+        targetBytes = expectedBytes;
+        tryForTicks = secondsToTry * cpuTimerFreq;
+        printf("\n--- %s ---\n", name.c_str());
+        clockBefore = MeasureClockRatio();
+        testsStartedAt = ReadTimestampCounterBegin();
+    }
+
+    void BeginTime()
+    {
+        BeginNoise();
+        BeginTimer();
+    }
+
+    void EndTime()
+    {
+        EndTimer();
+        EndNoise();
+    }
+
+    void BeginNoise()
+    {
+        noiseCpu = CurrentCpu();
+        NoiseCount noise = ReadNoise(noiseCpu);
+        noiseOnThisTest.voluntarySwitches -= noise.voluntarySwitches;
+        noiseOnThisTest.involuntarySwitches -= noise.involuntarySwitches;
+        noiseStartInterrupts = noise.interrupts;
+    }
+
+    void BeginTimer()
+    {
+        openBlockCount++;
+        accumulatedOnThisTest.e[RepetitionValuePageFaults] -= TotalPageFaults();
+        accumulatedOnThisTest.e[RepetitionValueCycles] -= ReadTimestampCounterBegin();
+    }
+
+    void EndTimer()
+    {
+        accumulatedOnThisTest.e[RepetitionValueCycles] += ReadTimestampCounterEnd();
+        accumulatedOnThisTest.e[RepetitionValuePageFaults] += TotalPageFaults();
+        closeBlockCount++;
+    }
+
+    // A block that ended on another CPU has its interrupts in two different columns, so they cannot be counted
+    void EndNoise()
+    {
+        int cpu = CurrentCpu();
+        NoiseCount noise = ReadNoise(cpu);
+        noiseOnThisTest.voluntarySwitches += noise.voluntarySwitches;
+        noiseOnThisTest.involuntarySwitches += noise.involuntarySwitches;
+        if (cpu == noiseCpu)
+        {
+            noiseOnThisTest.interrupts += noise.interrupts - noiseStartInterrupts;
+        }
+        else
+        {
+            migratedOnThisTest = true;
+        }
+    }
+
+    void CountBytes(uint64_t byteCount)
+    {
+        accumulatedOnThisTest.e[RepetitionValueBytes] += byteCount;
+    }
+
+    // Stops the wave; the message is printed and the wave is not retried
+    void Error(const std::string &message)
+    {
+        state = State::Error;
+        printf("ERROR: %s\n", message.c_str());
+    }
+
+    bool Failed() const
+    {
+        return state == State::Error;
+    }
+
+    // Closes the previous repetition, if any, and says whether to run another one
+    bool IsTesting()
+    {
+        if (state != State::Testing)
+        {
+            return false;
+        }
+
+        uint64_t now = ReadTimestampCounterEnd();
+        if (openBlockCount)
+        {
+            if (openBlockCount != closeBlockCount)
+            {
+                Error("Unbalanced BeginTime/EndTime");
+            }
+            if (accumulatedOnThisTest.e[RepetitionValueBytes] != targetBytes)
+            {
+                Error("Processed byte count mismatch: expected " + std::to_string(targetBytes) + ", got " +
+                      std::to_string(accumulatedOnThisTest.e[RepetitionValueBytes]));
+            }
+
+            if (state == State::Testing)
+            {
+                RepetitionValues value = accumulatedOnThisTest;
+                value.e[RepetitionValueTestCount] = 1;
+
+                double milliseconds = 1000.0 * Seconds((double)value.e[RepetitionValueCycles]);
+                bool preempted = noiseOnThisTest.involuntarySwitches > 0;
+                bool migrated = migratedOnThisTest;
+                bool interrupted = (double)noiseOnThisTest.interrupts > noiseThreshold * milliseconds;
+                preemptedCount += preempted;
+                migratedCount += migrated;
+                interruptedCount += interrupted;
+                noiseTotal.voluntarySwitches += noiseOnThisTest.voluntarySwitches;
+                noiseTotal.involuntarySwitches += noiseOnThisTest.involuntarySwitches;
+                noiseTotal.interrupts += noiseOnThisTest.interrupts;
+                samples.push_back(value.e[RepetitionValueCycles]);
+                noisy.push_back(preempted || migrated || interrupted);
+                for (int i = 0; i < repetitionValueCount; i++)
+                {
+                    results.total.e[i] += value.e[i];
+                }
+
+                if (value.e[RepetitionValueCycles] > results.max.e[RepetitionValueCycles])
+                {
+                    results.max = value;
+                    maxSample = samples.size() - 1;
+                }
+                if (value.e[RepetitionValueCycles] < results.min.e[RepetitionValueCycles])
+                {
+                    results.min = value;
+                    minSample = samples.size() - 1;
+
+                    // Any new minimum restarts the clock for the full trial time
+                    testsStartedAt = now;
+                    PrintValue("Min", results.min, 1);
+                    printf("                    \r");
+                    fflush(stdout);
+                }
+            }
+
+            openBlockCount = 0;
+            closeBlockCount = 0;
+            accumulatedOnThisTest = {};
+            noiseOnThisTest = {};
+            migratedOnThisTest = false;
+        }
+
+        if (state == State::Testing && now - testsStartedAt > tryForTicks)
+        {
+            state = State::Completed;
+            clockAfter = MeasureClockRatio();
+            PrintResults();
+            AppendBenchmarkResult(std::string(program_invocation_short_name) + "/" + name,
+                                  samples,
+                                  noisy,
+                                  cpuTimerFreq);
+        }
+
+        return state == State::Testing;
+    }
+
+    const RepetitionResults &Results() const
+    {
+        return results;
+    }
+
+    const std::vector<uint64_t> &Samples() const
+    {
+        return samples;
+    }
+
+    // 1 for each repetition in Samples() that was switched out or took more interrupts than the threshold
+    const std::vector<uint8_t> &Noisy() const
+    {
+        return noisy;
+    }
+
+    void PrintResults() const
+    {
+        uint64_t testCount = results.total.e[RepetitionValueTestCount];
+        if (!testCount)
+        {
+            return;
+        }
+
+        printf("                                                                                          \r");
+        PrintValue("Min", results.min, 1);
+        printf("%s\n", noisy[minSample] ? " [noisy]" : "");
+        PrintValue("Max", results.max, 1);
+        printf("%s\n", noisy[maxSample] ? " [noisy]" : "");
+        PrintValue("Avg", results.total, testCount);
+        printf("\n");
+        printf("Repetitions: %llu\n", (unsigned long long)testCount);
+        PrintEnvironment();
+    }
+};
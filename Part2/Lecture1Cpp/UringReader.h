@@ -0,0 +1,339 @@
+#pragma once
+
+// io_uring chunked file reader with the same Acquire/Release interface as ChunkReader.
+//
+// The chunk buffers are registered with the kernel once (IORING_REGISTER_BUFFERS) and every chunk is read with
+// IORING_OP_READ_FIXED, so the kernel skips pinning and mapping the destination on each read. Up to queueDepth reads
+// are in flight at once; chunks are still handed out in file order. When io_uring is unavailable (old kernel, seccomp
+// in a container, buffer registration over the memlock limit) the same interface falls back to one pread per chunk.
+//
+// The rings are driven through raw syscalls so there is no liburing dependency.
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+#include "ChunkReader.h"
+
+class UringReader
+{
+private:
+    struct Slot
+    {
+        char *base;
+        uint64_t offset;
+        size_t requested;
+        ssize_t result;
+        bool inFlight;
+    };
+
+    int fd = -1;
+    int ringFd = -1;
+    size_t chunkBytes;
+    size_t prefixBytes;
+    uint64_t fileSize = 0;
+    uint64_t nextSubmitOffset = 0;
+    uint64_t nextAcquireOffset = 0;
+    std::vector<char> storage;
+    std::vector<Slot> slots;
+
+    io_uring_params params = {};
+    void *sqRing = MAP_FAILED;
+    void *cqRing = MAP_FAILED;
+    size_t sqRingBytes = 0;
+    size_t cqRingBytes = 0;
+    io_uring_sqe *sqes = (io_uring_sqe *)MAP_FAILED;
+    unsigned *sqTail = nullptr;
+    unsigned *sqMask = nullptr;
+    unsigned *sqArray = nullptr;
+    unsigned *cqHead = nullptr;
+    unsigned *cqTail = nullptr;
+    unsigned *cqMask = nullptr;
+    io_uring_cqe *cqes = nullptr;
+
+    bool SetupRing(unsigned queueDepth)
+    {
+        ringFd = (int)syscall(__NR_io_uring_setup, queueDepth, &params);
+        if (ringFd < 0)
+        {
+            return false;
+        }
+
+        sqRingBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMap)
+        {
+            sqRingBytes = cqRingBytes = (sqRingBytes > cqRingBytes ? sqRingBytes : cqRingBytes);
+        }
+
+        sqRing = mmap(nullptr, sqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED)
+        {
+            return false;
+        }
+        cqRing = singleMap ? sqRing
+                           : mmap(nullptr,
+                                  cqRingBytes,
+                                  PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_POPULATE,
+                                  ringFd,
+                                  IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED)
+        {
+            return false;
+        }
+        sqes = (io_uring_sqe *)mmap(nullptr,
+                                    params.sq_entries * sizeof(io_uring_sqe),
+                                    PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_POPULATE,
+                                    ringFd,
+                                    IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+        {
+            return false;
+        }
+
+        char *sq = (char *)sqRing;
+        char *cq = (char *)cqRing;
+        sqTail = (unsigned *)(sq + params.sq_off.tail);
+        sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+        sqArray = (unsigned *)(sq + params.sq_off.array);
+        cqHead = (unsigned *)(cq + params.cq_off.head);
+        cqTail = (unsigned *)(cq + params.cq_off.tail);
+        cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+        cqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+
+        std::vector<iovec> iovecs(slots.size());
+        for (size_t i = 0; i < slots.size(); i++)
+        {
+            iovecs[i].iov_base = slots[i].base;
+            iovecs[i].iov_len = prefixBytes + chunkBytes;
+        }
+        return syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS, iovecs.data(), (unsigned)iovecs.size())
+               == 0;
+    }
+
+    void TearDownRing()
+    {
+        if (sqes != MAP_FAILED)
+        {
+            munmap(sqes, params.sq_entries * sizeof(io_uring_sqe));
+        }
+        if (cqRing != MAP_FAILED && cqRing != sqRing)
+        {
+            munmap(cqRing, cqRingBytes);
+        }
+        if (sqRing != MAP_FAILED)
+        {
+            munmap(sqRing, sqRingBytes);
+        }
+        if (ringFd >= 0)
+        {
+            close(ringFd);
+        }
+        sqes = (io_uring_sqe *)MAP_FAILED;
+        sqRing = cqRing = MAP_FAILED;
+        ringFd = -1;
+    }
+
+    void SubmitRead(int slotIndex)
+    {
+        Slot &slot = slots[slotIndex];
+        slot.offset = nextSubmitOffset;
+        slot.requested = fileSize - nextSubmitOffset < chunkBytes ? fileSize - nextSubmitOffset : chunkBytes;
+        slot.inFlight = true;
+        nextSubmitOffset += slot.requested;
+
+        unsigned tail = *sqTail;
+        unsigned index = tail & *sqMask;
+        io_uring_sqe *sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t)(uintptr_t)(slot.base + prefixBytes);
+        sqe->len = (uint32_t)slot.requested;
+        sqe->off = slot.offset;
+        sqe->buf_index = (uint16_t)slotIndex;
+        sqe->user_data = (uint64_t)slotIndex;
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+        if (syscall(__NR_io_uring_enter, ringFd, 1, 0, 0, nullptr, 0) < 0)
+        {
+            throw std::runtime_error("io_uring_enter failed to submit a read");
+        }
+    }
+
+    void WaitForCompletion()
+    {
+        unsigned head = *cqHead;
+        while (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+        {
+            if (syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR)
+            {
+                throw std::runtime_error("io_uring_enter failed to wait for a read");
+            }
+        }
+
+        io_uring_cqe *cqe = &cqes[head & *cqMask];
+        Slot &slot = slots[cqe->user_data];
+        slot.result = cqe->res;
+        slot.inFlight = false;
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+    }
+
+    // Plain pread for the rest of a chunk: the whole chunk without io_uring, or the tail of a short read with it
+    ssize_t ReadRemaining(Slot &slot, size_t alreadyRead)
+    {
+        size_t total = alreadyRead;
+        while (total < slot.requested)
+        {
+            ssize_t bytesRead = pread(fd, slot.base + prefixBytes + total, slot.requested - total, slot.offset + total);
+            if (bytesRead <= 0)
+            {
+                return bytesRead < 0 ? -1 : (ssize_t)total;
+            }
+            total += bytesRead;
+        }
+        return (ssize_t)total;
+    }
+
+public:
+    bool usingUring = false;
+    // Time spent in pread. io_uring reads run in the kernel and are only visible here as waiting.
+    double ioSeconds = 0.0;
+    // Time spent in Acquire waiting for a chunk's read to finish
+    double waitSeconds = 0.0;
+    size_t bytesRead = 0;
+
+    // Pass allowUring = false to measure the pread fallback on a machine that has io_uring
+    UringReader(const std::string &filePath, size_t chunkBytes, int queueDepth, size_t prefixBytes, bool allowUring)
+        : chunkBytes(chunkBytes), prefixBytes(prefixBytes)
+    {
+        fd = open(filePath.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Unable to open file: " + filePath);
+        }
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) != 0)
+        {
+            close(fd);
+            throw std::runtime_error("Unable to stat file: " + filePath);
+        }
+        fileSize = (uint64_t)fileStat.st_size;
+
+        if (queueDepth < 1)
+        {
+            queueDepth = 1;
+        }
+        storage.resize((size_t)queueDepth * (prefixBytes + chunkBytes));
+        slots.resize(queueDepth);
+        for (int i = 0; i < queueDepth; i++)
+        {
+            slots[i] = {storage.data() + (size_t)i * (prefixBytes + chunkBytes), 0, 0, 0, false};
+        }
+
+        usingUring = allowUring && SetupRing((unsigned)queueDepth);
+        if (!usingUring)
+        {
+            TearDownRing();
+            return;
+        }
+
+        for (int i = 0; i < queueDepth && nextSubmitOffset < fileSize; i++)
+        {
+            SubmitRead(i);
+        }
+    }
+
+    ~UringReader()
+    {
+        // The kernel may still be writing into the buffers, so drain before they are freed
+        if (usingUring)
+        {
+            for (Slot &slot : slots)
+            {
+                while (slot.inFlight)
+                {
+                    WaitForCompletion();
+                }
+            }
+        }
+        TearDownRing();
+        close(fd);
+    }
+
+    UringReader(const UringReader &) = delete;
+    UringReader &operator=(const UringReader &) = delete;
+
+    // Returns the next chunk in file order, waiting for its read if needed. Valid until passed to Release.
+    Chunk Acquire()
+    {
+        Chunk chunk;
+        if (nextAcquireOffset >= fileSize)
+        {
+            return chunk;
+        }
+
+        // Chunks are submitted round-robin, so the next one in file order always sits in the same slot
+        int slotIndex = (int)((nextAcquireOffset / chunkBytes) % slots.size());
+        Slot &slot = slots[slotIndex];
+
+        auto waitStart = std::chrono::steady_clock::now();
+        ssize_t result;
+        if (usingUring)
+        {
+            while (slot.inFlight)
+            {
+                WaitForCompletion();
+            }
+            waitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+            result = slot.result < 0 ? slot.result : ReadRemaining(slot, (size_t)slot.result);
+        }
+        else
+        {
+            slot.offset = nextAcquireOffset;
+            slot.requested = fileSize - nextAcquireOffset < chunkBytes ? fileSize - nextAcquireOffset : chunkBytes;
+            result = ReadRemaining(slot, 0);
+            double readSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+            ioSeconds += readSeconds;
+            waitSeconds += readSeconds;
+        }
+
+        if (result < 0)
+        {
+            throw std::runtime_error("Failed to read file");
+        }
+
+        chunk.buffer = slotIndex;
+        chunk.data = slot.base + prefixBytes;
+        chunk.size = (size_t)result;
+        nextAcquireOffset += slot.requested;
+        bytesRead += chunk.size;
+        return chunk;
+    }
+
+    void Release(const Chunk &chunk)
+    {
+        if (usingUring && nextSubmitOffset < fileSize)
+        {
+            SubmitRead(chunk.buffer);
+        }
+    }
+
+    // Reads are only timed on the consumer's thread, so there is nothing to wait for
+    void Finish()
+    {
+    }
+};
@@ -0,0 +1,34 @@
+#!/usr/bin/env bash
+# Builds the C++ Haversine tools for Linux (x86-64) into ./build.
+# rdtsc.c is compiled as C and linked in directly, so the tools do not need librdtsc.so at runtime.
+set -euo pipefail
+
+cd "$(dirname "$0")"
+mkdir -p build
+
+# Results are stored under the revision the tools were built from, not whatever is checked out when they run
+revision="$(git rev-parse --short=12 HEAD 2>/dev/null || echo unknown)"
+if [ "$revision" != unknown ] && [ -n "$(git status --porcelain --untracked-files=no 2>/dev/null | head -n 1)" ]; then
+    revision="$revision+dirty"
+fi
+revisionFlag="-DBENCHMARK_REVISION=\"$revision\""
+
+gcc -O2 -c ../Lecture1/Haversine.CpuTimer/rdtsc.c -o build/rdtsc.o
+g++ -O2 -std=c++20 -pthread "$revisionFlag" HaversineInput.cpp build/rdtsc.o -o build/haversine_input
+g++ -O2 -std=c++20 -pthread "$revisionFlag" HaversineProcessor.cpp build/rdtsc.o -o build/haversine_processor
+g++ -O2 -std=c++20 -pthread "$revisionFlag" RepetitionTest.cpp build/rdtsc.o -o build/repetition_test
+g++ -O2 -std=c++20 -pthread "$revisionFlag" ReadMatrix.cpp build/rdtsc.o -o build/read_matrix
+g++ -O2 -std=c++20 -pthread "$revisionFlag" BandwidthProbe.cpp build/rdtsc.o -o build/bandwidth_probe
+gcc -c AsmKernels.S -o build/asm_kernels.o
+g++ -O2 -std=c++20 -pthread "$revisionFlag" AsmBench.cpp build/asm_kernels.o build/rdtsc.o -o build/asm_bench
+g++ -O2 -std=c++20 -pthread "$revisionFlag" BenchCompare.cpp build/rdtsc.o -o build/bench_compare
+
+# Round trip a small generated file through the pair file format; a mismatch fails the build
+checkDir="$(mktemp -d)"
+trap 'rm -rf "$checkDir"' EXIT
+buildDir="$PWD/build"
+(cd "$checkDir" && "$buildDir/haversine_input" uniform 1 1000 1 json > /dev/null \
+    && "$buildDir/haversine_processor" roundtrip haversine_input.json)
+
+echo "Built build/haversine_input build/haversine_processor build/repetition_test build/read_matrix build/bandwidth_probe" \
+    "build/asm_bench build/bench_compare"